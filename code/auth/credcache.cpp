@@ -0,0 +1,162 @@
+#include "credcache.h"
+
+#include <string.h>
+#include <sys/random.h>
+
+#include <functional>
+
+/**
+ * @description: 懒汉单例模式，局部静态变量
+ */
+CredCache *CredCache::instance() {
+    static CredCache cache;
+    return &cache;
+}
+
+/**
+ * @description: 初始化缓存容量与过期时间，生成随机盐，capacity为0时缓存关闭
+ * @param {size_t} capacity 最多缓存的用户数，平均分到各分片
+ * @param {int} ttlSec 存在的用户的过期秒数
+ * @param {int} negTtlSec 不存在的用户的过期秒数，通常更短
+ */
+void CredCache::init(size_t capacity, int ttlSec, int negTtlSec) {
+    shardCap_ = (capacity + SHARD_COUNT - 1) / SHARD_COUNT;
+    ttl_      = std::chrono::seconds(ttlSec);
+    negTtl_   = std::chrono::seconds(negTtlSec);
+    if (getrandom(salt_.data(), salt_.size(), 0) != static_cast<ssize_t>(salt_.size())) {
+        /*没有足够的随机数时退化为时间与地址，盐只用于防止内存中的散列被直接比对*/
+        uint64_t seed = Clock::now().time_since_epoch().count() ^ reinterpret_cast<uintptr_t>(this);
+        memcpy(salt_.data(), &seed, sizeof(seed));
+    }
+}
+
+bool CredCache::isOpen() const { return shardCap_ > 0; }
+
+CredCache::Shard &CredCache::shard_(const std::string &name) {
+    return shards_[std::hash<std::string>()(name) & (SHARD_COUNT - 1)];
+}
+
+/**
+ * @description: 计算加盐的口令散列，用户名也参与计算，相同口令的不同用户散列不同
+ */
+Sha256::Digest CredCache::hash_(const std::string &name, const std::string &pwd) const {
+    Sha256 sha;
+    sha.update(salt_.data(), salt_.size());
+    sha.update(name.data(), name.size() + 1);  // 带上结尾的'\0'作为分隔
+    sha.update(pwd.data(), pwd.size());
+    return sha.final();
+}
+
+/**
+ * @description: 查询缓存，过期的条目当作未缓存并删除
+ * @param {string} &name
+ * @param {string} &pwd 待验证的口令，只在命中存在的用户时计算散列比较
+ */
+CredCache::Lookup CredCache::lookup(const std::string &name, const std::string &pwd) {
+    if (!isOpen()) {
+        return MISS;
+    }
+    Shard         &shard = shard_(name);
+    Sha256::Digest hash;
+    {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        auto                        it = shard.map.find(name);
+        if (it == shard.map.end()) {
+            misses_++;
+            return MISS;
+        }
+        if (it->second.expire <= Clock::now()) {
+            shard.lru.erase(it->second.lru);
+            shard.map.erase(it);
+            misses_++;
+            return MISS;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+        if (!it->second.exists) {
+            negHits_++;
+            return ABSENT;
+        }
+        hash = it->second.hash;
+    }
+    hits_++;
+    /*散列计算放在锁外*/
+    return hash == hash_(name, pwd) ? MATCH : MISMATCH;
+}
+
+/**
+ * @description: 放入或更新一个条目，分片满时淘汰最久未使用的条目
+ */
+void CredCache::put_(const std::string &name, bool exists, const Sha256::Digest &hash) {
+    Shard                      &shard  = shard_(name);
+    Clock::time_point           expire = Clock::now() + (exists ? ttl_ : negTtl_);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto                        it = shard.map.find(name);
+    if (it != shard.map.end()) {
+        it->second.exists = exists;
+        it->second.hash   = hash;
+        it->second.expire = expire;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+        return;
+    }
+    if (shard.map.size() >= shardCap_) {
+        shard.map.erase(shard.lru.back());
+        shard.lru.pop_back();
+        evictions_++;
+    }
+    shard.lru.push_front(name);
+    shard.map.emplace(name, Entry{exists, hash, expire, shard.lru.begin()});
+}
+
+/**
+ * @description: 缓存数据库中查到的用户，pwd为数据库中的口令，只保存它的散列
+ */
+void CredCache::putUser(const std::string &name, const std::string &pwd) {
+    if (isOpen()) {
+        put_(name, true, hash_(name, pwd));
+    }
+}
+
+/**
+ * @description: 缓存“用户不存在”，同一个不存在的用户名反复登录或注册时不必查询数据库
+ */
+void CredCache::putAbsent(const std::string &name) {
+    if (isOpen()) {
+        put_(name, false, {});
+    }
+}
+
+/**
+ * @description: 删除一个条目，注册成功后调用，避免“用户不存在”的条目继续生效
+ */
+void CredCache::invalidate(const std::string &name) {
+    if (!isOpen()) {
+        return;
+    }
+    Shard                      &shard = shard_(name);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto                        it = shard.map.find(name);
+    if (it != shard.map.end()) {
+        shard.lru.erase(it->second.lru);
+        shard.map.erase(it);
+    }
+}
+
+uint64_t CredCache::hits() const { return hits_; }
+
+uint64_t CredCache::negHits() const { return negHits_; }
+
+uint64_t CredCache::misses() const { return misses_; }
+
+uint64_t CredCache::evictions() const { return evictions_; }
+
+/**
+ * @description: 当前缓存的条目数，包括尚未清理的过期条目
+ */
+size_t CredCache::size() {
+    size_t n = 0;
+    for (auto &shard : shards_) {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        n += shard.map.size();
+    }
+    return n;
+}
@@ -0,0 +1,83 @@
+/*
+ * @Description  : 用户凭据缓存，分片加锁、有容量上限与过期时间，只保存加盐的口令散列，也缓存“用户不存在”，单例模式
+ * @Date         : 2026-10-19 00:31:52
+ * @LastEditTime : 2026-10-19 00:31:52
+ */
+#ifndef CREDCACHE_H
+#define CREDCACHE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "sha256.h"
+
+class CredCache {
+public:
+    /* 查询结果：未缓存、口令一致、口令不一致、缓存了用户不存在 */
+    enum Lookup { MISS, MATCH, MISMATCH, ABSENT };
+
+    static const int SHARD_COUNT = 16;  // 分片数，必须是2的幂
+
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Entry {
+        bool              exists;  // 为false表示用户不存在
+        Sha256::Digest    hash;    // 加盐的口令散列
+        Clock::time_point expire;
+
+        std::list<std::string>::iterator lru;  // 在所属分片LRU链表中的位置
+    };
+
+    /* 每个分片一把锁，按LRU淘汰，避开相邻分片的伪共享 */
+    struct alignas(64) Shard {
+        std::mutex                             mtx;
+        std::unordered_map<std::string, Entry> map;
+        std::list<std::string>                 lru;  // 表头最近使用
+    };
+
+    Shard shards_[SHARD_COUNT];
+
+    size_t               shardCap_{0};  // 每个分片的容量，0表示缓存关闭
+    Clock::duration      ttl_{};        // 存在的用户的过期时间
+    Clock::duration      negTtl_{};     // 不存在的用户的过期时间
+    std::array<char, 16> salt_{};       // 进程启动时随机生成的盐
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> negHits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+
+private:
+    CredCache()  = default;
+    ~CredCache() = default;
+
+    Shard         &shard_(const std::string &name);
+    Sha256::Digest hash_(const std::string &name, const std::string &pwd) const;
+    void           put_(const std::string &name, bool exists, const Sha256::Digest &hash);
+
+public:
+    static CredCache *instance();
+
+    void init(size_t capacity, int ttlSec, int negTtlSec);
+    bool isOpen() const;
+
+    Lookup lookup(const std::string &name, const std::string &pwd);
+
+    void putUser(const std::string &name, const std::string &pwd);
+    void putAbsent(const std::string &name);
+    void invalidate(const std::string &name);
+
+    uint64_t hits() const;
+    uint64_t negHits() const;
+    uint64_t misses() const;
+    uint64_t evictions() const;
+    size_t   size();
+};
+
+#endif  //CREDCACHE_H
@@ -0,0 +1,478 @@
+#include "memuserstore.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <functional>
+#include <random>
+
+#include "../logsys/log.h"
+
+namespace {
+
+const char     MAGIC[8]          = {'W', 'S', 'U', 'S', 'E', 'R', 'S', '1'};
+const size_t   HEADER_LEN        = 16;                // 魔数8字节、版本4字节、保留4字节
+const uint32_t VERSION           = 1;
+const size_t   INITIAL_LEN       = 1 << 20;          // 新文件的初始长度，之后按倍增长
+const size_t   RECORD_HEAD       = 56;                // 校验4、操作1、名字长度1、保留2、盐16、散列32
+const uint64_t COMPACT_MIN_BYTES = 64 * 1024;        // 可回收的字节数少于此值时不压缩
+const uint8_t  OP_PUT            = 1;
+const uint8_t  OP_DEL            = 2;
+
+/**
+ * @description: FNV-1a校验值，0保留表示文件中没有记录
+ */
+uint32_t checksum(const char *data, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return h ? h : 1;
+}
+
+inline uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+Sha256::Digest digestOf(const std::array<uint8_t, 16> &salt, const std::string &pwd) {
+    Sha256 sha;
+    sha.update(salt.data(), salt.size());
+    sha.update(pwd.data(), pwd.size());
+    return sha.final();
+}
+
+}  // namespace
+
+MemUserStore::MemUserStore() {
+    for (auto &shard : shards_) {
+        shard.slots.assign(16, Slot{0, EMPTY});
+    }
+}
+
+MemUserStore::~MemUserStore() { close(); }
+
+uint64_t MemUserStore::hash_(const std::string &name) { return mix(std::hash<std::string>()(name)); }
+
+/**
+ * @description: 一条记录占用的字节数，按8字节对齐
+ */
+size_t MemUserStore::recordLen_(size_t nameLen) { return (RECORD_HEAD + nameLen + 7) & ~(size_t)7; }
+
+/**
+ * @description: 把一条记录写到dst，校验值最后写入，写了一半的记录在重放时会因校验不符被丢弃
+ * @return {size_t} 记录长度
+ */
+size_t MemUserStore::writeRecord_(char *dst, uint8_t op, const User &user) {
+    dst[4] = (char)op;
+    dst[5] = (char)user.name.size();
+    dst[6] = dst[7] = 0;
+    memcpy(dst + 8, user.salt.data(), user.salt.size());
+    memcpy(dst + 24, user.digest.data(), user.digest.size());
+    memcpy(dst + RECORD_HEAD, user.name.data(), user.name.size());
+    uint32_t check = checksum(dst + 4, RECORD_HEAD - 4 + user.name.size());
+    memcpy(dst, &check, sizeof(check));
+    return recordLen_(user.name.size());
+}
+
+MemUserStore::Shard &MemUserStore::shard_(uint64_t h) { return shards_[h & (SHARD_COUNT - 1)]; }
+
+/**
+ * @description: 线性探测查找用户名所在的槽，找不到返回SIZE_MAX，调用者需持有分片的锁
+ */
+size_t MemUserStore::find_(const Shard &shard, uint64_t h, const std::string &name) const {
+    uint32_t tag  = (uint32_t)(h >> 32);
+    size_t   mask = shard.slots.size() - 1;
+    for (size_t i = (h >> 6) & mask;; i = (i + 1) & mask) {
+        const Slot &slot = shard.slots[i];
+        if (slot.idx == EMPTY) {
+            return SIZE_MAX;
+        }
+        if (slot.idx != TOMB && slot.tag == tag && shard.users[slot.idx].name == name) {
+            return i;
+        }
+    }
+}
+
+/**
+ * @description: 插入一个不存在的用户，调用者需持有分片的写锁
+ */
+void MemUserStore::insert_(Shard &shard, uint64_t h, User &&user) {
+    if ((shard.live + shard.tombs + 1) * 4 > shard.slots.size() * 3) {
+        /*墓碑多时原大小重建即可，否则扩容一倍*/
+        rehash_(shard, (shard.live + 1) * 2 > shard.slots.size() ? shard.slots.size() * 2 : shard.slots.size());
+    }
+    uint32_t idx;
+    if (!shard.freeIdx.empty()) {
+        idx = shard.freeIdx.back();
+        shard.freeIdx.pop_back();
+        shard.users[idx] = std::move(user);
+    } else {
+        idx = (uint32_t)shard.users.size();
+        shard.users.push_back(std::move(user));
+    }
+    size_t mask = shard.slots.size() - 1;
+    size_t i    = (h >> 6) & mask;
+    while (shard.slots[i].idx != EMPTY && shard.slots[i].idx != TOMB) {
+        i = (i + 1) & mask;
+    }
+    if (shard.slots[i].idx == TOMB) {
+        shard.tombs--;
+    }
+    shard.slots[i] = {(uint32_t)(h >> 32), idx};
+    shard.live++;
+    users_++;
+}
+
+/**
+ * @description: 删除一个槽中的用户，留下墓碑，调用者需持有分片的写锁
+ */
+void MemUserStore::erase_(Shard &shard, size_t slot) {
+    uint32_t idx = shard.slots[slot].idx;
+    shard.users[idx].name.clear();
+    shard.users[idx].name.shrink_to_fit();
+    shard.freeIdx.push_back(idx);
+    shard.slots[slot].idx = TOMB;
+    shard.live--;
+    shard.tombs++;
+    users_--;
+}
+
+/**
+ * @description: 按新容量重建槽数组，清除墓碑
+ */
+void MemUserStore::rehash_(Shard &shard, size_t capacity) {
+    std::vector<Slot> slots(capacity, Slot{0, EMPTY});
+    size_t            mask = capacity - 1;
+    for (const Slot &old : shard.slots) {
+        if (old.idx == EMPTY || old.idx == TOMB) {
+            continue;
+        }
+        uint64_t h = hash_(shard.users[old.idx].name);
+        size_t   i = (h >> 6) & mask;
+        while (slots[i].idx != EMPTY) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = old;
+    }
+    shard.slots.swap(slots);
+    shard.tombs = 0;
+}
+
+/**
+ * @description: 打开或创建用户文件，重放其中的记录建立哈希表，启动后台压缩线程
+ * @param {string} &path 用户文件路径
+ * @param {int} compactSec 压缩检查间隔秒数，0表示不压缩
+ * @param {string} &errMsg 失败原因
+ */
+bool MemUserStore::open(const std::string &path, int compactSec, std::string &errMsg) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        errMsg = "open " + path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    bool created = (size_t)st.st_size < HEADER_LEN;
+    if (created && ftruncate(fd, INITIAL_LEN) < 0) {
+        errMsg = "ftruncate " + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (!mapFile_(fd, created ? INITIAL_LEN : (size_t)st.st_size)) {
+        errMsg = "mmap " + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (created) {
+        memcpy(map_, MAGIC, sizeof(MAGIC));
+        memcpy(map_ + sizeof(MAGIC), &VERSION, sizeof(VERSION));
+    } else if (memcmp(map_, MAGIC, sizeof(MAGIC)) != 0) {
+        errMsg = path + " is not a user file";
+        close();
+        return false;
+    }
+    path_ = path;
+    replay_();
+
+    compactSec_ = compactSec;
+    isClose_    = false;
+    if (compactSec_ > 0) {
+        compactor_ = std::thread(&MemUserStore::compactLoop_, this);
+    }
+    return true;
+}
+
+/**
+ * @description: 映射整个文件，替换当前的映射
+ */
+bool MemUserStore::mapFile_(int fd, size_t len) {
+    void *map = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    if (map_) {
+        munmap(map_, mapLen_);
+        ::close(fd_);
+    }
+    fd_     = fd;
+    map_    = static_cast<char *>(map);
+    mapLen_ = len;
+    return true;
+}
+
+/**
+ * @description: 从头重放文件中的记录，遇到校验不符的记录即认为是文件末尾，清零其后的内容以便继续追加
+ */
+void MemUserStore::replay_() {
+    size_t pos  = HEADER_LEN;
+    bool   torn = false;
+    while (pos + RECORD_HEAD <= mapLen_) {
+        const char *rec = map_ + pos;
+        uint32_t    check;
+        memcpy(&check, rec, sizeof(check));
+        if (check == 0) {
+            break;
+        }
+        size_t nameLen = (uint8_t)rec[5];
+        if (pos + recordLen_(nameLen) > mapLen_ || checksum(rec + 4, RECORD_HEAD - 4 + nameLen) != check) {
+            torn = true;
+            break;
+        }
+        User user;
+        user.name.assign(rec + RECORD_HEAD, nameLen);
+        memcpy(user.salt.data(), rec + 8, user.salt.size());
+        memcpy(user.digest.data(), rec + 24, user.digest.size());
+        apply_((uint8_t)rec[4], std::move(user));
+        pos += recordLen_(nameLen);
+    }
+    tail_ = pos;
+    if (torn) {
+        memset(map_ + tail_, 0, mapLen_ - tail_);
+    }
+}
+
+/**
+ * @description: 重放一条记录，PUT覆盖同名用户，DEL删除用户
+ */
+void MemUserStore::apply_(uint8_t op, User &&user) {
+    uint64_t h     = hash_(user.name);
+    Shard   &shard = shard_(h);
+    size_t   slot  = find_(shard, h, user.name);
+    if (slot != SIZE_MAX) {
+        liveBytes_ -= recordLen_(user.name.size());
+        erase_(shard, slot);
+    }
+    if (op == OP_PUT) {
+        liveBytes_ += recordLen_(user.name.size());
+        insert_(shard, h, std::move(user));
+    }
+}
+
+/**
+ * @description: 在文件末尾追加一条记录，空间不够时文件长度倍增并重新映射
+ */
+bool MemUserStore::append_(uint8_t op, const User &user) {
+    std::lock_guard<std::mutex> locker(logMtx_);
+    size_t                      len = recordLen_(user.name.size());
+    if (tail_ + len > mapLen_) {
+        size_t newLen = mapLen_ * 2;
+        void  *map    = MAP_FAILED;
+        if (ftruncate(fd_, newLen) == 0) {
+            map = mremap(map_, mapLen_, newLen, MREMAP_MAYMOVE);
+        }
+        if (map == MAP_FAILED) {
+            LOG_ERROR("MemUserStore grow %s error: %s", path_.c_str(), strerror(errno));
+            return false;
+        }
+        map_    = static_cast<char *>(map);
+        mapLen_ = newLen;
+    }
+    tail_ += writeRecord_(map_ + tail_, op, user);
+    return true;
+}
+
+/**
+ * @description: 验证用户；登录只持有分片的读锁拷贝盐与散列，散列计算在锁外
+ * @param {string} &name
+ * @param {string} &pwd
+ * @param {bool} isLogin
+ */
+MemUserStore::Result MemUserStore::verify(const std::string &name, const std::string &pwd, bool isLogin) {
+    uint64_t h     = hash_(name);
+    Shard   &shard = shard_(h);
+    if (isLogin) {
+        Salt           salt;
+        Sha256::Digest digest;
+        {
+            std::shared_lock<std::shared_mutex> locker(shard.mtx);
+            size_t                              slot = find_(shard, h, name);
+            if (slot == SIZE_MAX) {
+                return FAIL;
+            }
+            const User &user = shard.users[shard.slots[slot].idx];
+            salt             = user.salt;
+            digest           = user.digest;
+        }
+        return digestOf(salt, pwd) == digest ? OK : FAIL;
+    }
+
+    /*用户名长度记在一个字节中*/
+    if (name.size() > UINT8_MAX) {
+        return FAIL;
+    }
+    User user;
+    user.name = name;
+    if (getrandom(user.salt.data(), user.salt.size(), 0) != (ssize_t)user.salt.size()) {
+        std::random_device rd;
+        for (auto &b : user.salt) {
+            b = (uint8_t)rd();
+        }
+    }
+    user.digest = digestOf(user.salt, pwd);
+
+    std::unique_lock<std::shared_mutex> locker(shard.mtx);
+    if (find_(shard, h, name) != SIZE_MAX) {
+        return FAIL;
+    }
+    /*先写文件再放入哈希表，写文件失败时注册失败*/
+    if (!append_(OP_PUT, user)) {
+        return ERROR;
+    }
+    liveBytes_ += recordLen_(name.size());
+    insert_(shard, h, std::move(user));
+    return OK;
+}
+
+/**
+ * @description: 删除用户，追加一条DEL记录，原来的PUT记录在压缩时回收
+ */
+bool MemUserStore::remove(const std::string &name) {
+    uint64_t                            h     = hash_(name);
+    Shard                              &shard = shard_(h);
+    std::unique_lock<std::shared_mutex> locker(shard.mtx);
+    size_t                              slot = find_(shard, h, name);
+    if (slot == SIZE_MAX) {
+        return false;
+    }
+    if (!append_(OP_DEL, shard.users[shard.slots[slot].idx])) {
+        return false;
+    }
+    liveBytes_ -= recordLen_(name.size());
+    erase_(shard, slot);
+    return true;
+}
+
+/**
+ * @description: 把仍有效的用户写到新文件，fsync后rename替换旧文件；
+ *              压缩期间持有所有分片的读锁，登录照常进行，注册与删除等待
+ */
+bool MemUserStore::compact_() {
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    for (auto &shard : shards_) {
+        locks.emplace_back(shard.mtx);
+    }
+    std::lock_guard<std::mutex> locker(logMtx_);
+
+    std::string tmp = path_ + ".tmp";
+    int         fd  = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    size_t      len = INITIAL_LEN;
+    while (len < (HEADER_LEN + liveBytes_) * 2) {
+        len *= 2;
+    }
+    char *map = fd < 0 || ftruncate(fd, len) < 0
+                    ? (char *)MAP_FAILED
+                    : (char *)mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        LOG_ERROR("MemUserStore compact %s error: %s", tmp.c_str(), strerror(errno));
+        if (fd >= 0) {
+            ::close(fd);
+            unlink(tmp.c_str());
+        }
+        return false;
+    }
+    memcpy(map, map_, HEADER_LEN);
+    size_t pos = HEADER_LEN;
+    for (auto &shard : shards_) {
+        for (const Slot &slot : shard.slots) {
+            if (slot.idx != EMPTY && slot.idx != TOMB) {
+                pos += writeRecord_(map + pos, OP_PUT, shard.users[slot.idx]);
+            }
+        }
+    }
+    munmap(map, len);
+    /*新文件落盘后再替换，中途崩溃时旧文件仍然完整*/
+    if (fsync(fd) < 0 || rename(tmp.c_str(), path_.c_str()) < 0 || !mapFile_(fd, len)) {
+        LOG_ERROR("MemUserStore compact %s error: %s", path_.c_str(), strerror(errno));
+        ::close(fd);
+        unlink(tmp.c_str());
+        return false;
+    }
+    size_t slash = path_.rfind('/');
+    int    dirFd = ::open(slash == std::string::npos ? "." : path_.substr(0, slash + 1).c_str(), O_RDONLY);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        ::close(dirFd);
+    }
+    LOG_INFO("MemUserStore compacted %s: %zu -> %zu bytes", path_.c_str(), tail_, pos);
+    tail_ = pos;
+    compactions_++;
+    return true;
+}
+
+/**
+ * @description: 后台线程，定期检查可回收的字节数，超过有效记录的字节数时压缩
+ */
+void MemUserStore::compactLoop_() {
+    std::unique_lock<std::mutex> locker(mtx_);
+    while (!cond_.wait_for(locker, std::chrono::seconds(compactSec_), [this] { return isClose_; })) {
+        size_t tail;
+        {
+            std::lock_guard<std::mutex> logLocker(logMtx_);
+            tail = tail_;
+        }
+        uint64_t dead = tail - HEADER_LEN - liveBytes_;
+        if (dead >= COMPACT_MIN_BYTES && dead > liveBytes_) {
+            compact_();
+        }
+    }
+}
+
+/**
+ * @description: 停止压缩线程，把映射写回文件后解除映射
+ */
+void MemUserStore::close() {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        isClose_ = true;
+    }
+    cond_.notify_all();
+    if (compactor_.joinable()) {
+        compactor_.join();
+    }
+    if (map_) {
+        msync(map_, mapLen_, MS_SYNC);
+        munmap(map_, mapLen_);
+        ::close(fd_);
+        map_ = nullptr;
+        fd_  = -1;
+    }
+}
+
+void MemUserStore::logStats() {
+    size_t tail;
+    {
+        std::lock_guard<std::mutex> locker(logMtx_);
+        tail = tail_;
+    }
+    LOG_INFO("MemUserStore users %llu, file %llu bytes (live %llu), compactions %llu", (unsigned long long)users_,
+             (unsigned long long)tail, (unsigned long long)liveBytes_, (unsigned long long)compactions_);
+}
@@ -0,0 +1,109 @@
+/*
+ * @Description  : 进程内用户存储后端，分片的开放寻址哈希表，持久化到内存映射的追加写文件，后台线程定期压缩
+ * @Date         : 2026-10-19 02:21:40
+ * @LastEditTime : 2026-10-19 02:21:40
+ */
+#ifndef MEMUSERSTORE_H
+#define MEMUSERSTORE_H
+
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sha256.h"
+#include "userbackend.h"
+
+class MemUserStore : public UserBackend {
+public:
+    static const int SHARD_COUNT = 64;  // 分片数，必须是2的幂
+
+private:
+    using Salt = std::array<uint8_t, 16>;
+
+    /* 一个用户，只保存每个用户随机盐的口令散列 */
+    struct User {
+        std::string    name;
+        Salt           salt;
+        Sha256::Digest digest;
+    };
+
+    /* 哈希表的槽，tag为哈希值的高32位，先比较tag再比较用户名 */
+    struct Slot {
+        uint32_t tag;
+        uint32_t idx;  // users中的下标，或EMPTY、TOMB
+    };
+
+    static const uint32_t EMPTY = UINT32_MAX;      // 空槽，探测到这里结束
+    static const uint32_t TOMB  = UINT32_MAX - 1;  // 删除留下的墓碑，探测继续
+
+    /* 每个分片一把读写锁，线性探测，空槽与墓碑合计超过3/4时重建 */
+    struct alignas(64) Shard {
+        std::shared_mutex     mtx;
+        std::vector<Slot>     slots;  // 容量为2的幂
+        std::vector<User>     users;
+        std::vector<uint32_t> freeIdx;  // users中被删除的位置，注册时复用
+        size_t                live{0};
+        size_t                tombs{0};
+    };
+
+    Shard shards_[SHARD_COUNT];
+
+    /* 追加写文件：16字节文件头之后是一条条PUT/DEL记录，每条记录带校验值，校验不符处即为文件的有效末尾 */
+    std::string path_;
+    int         fd_{-1};
+    char       *map_{nullptr};
+    size_t      mapLen_{0};
+    size_t      tail_{0};  // 有效内容的末尾
+    std::mutex  logMtx_;   // 保护追加写与压缩，加锁顺序总是先分片再logMtx_
+
+    std::atomic<uint64_t> users_{0};      // 用户数
+    std::atomic<uint64_t> liveBytes_{0};  // 仍有效的PUT记录占用的字节数，其余为可压缩的
+    std::atomic<uint64_t> compactions_{0};
+
+    int                     compactSec_{0};  // 压缩检查间隔，0表示不压缩
+    std::mutex              mtx_;
+    std::condition_variable cond_;
+    bool                    isClose_{true};
+    std::thread             compactor_;
+
+private:
+    static uint64_t hash_(const std::string &name);
+    static size_t   recordLen_(size_t nameLen);
+    static size_t   writeRecord_(char *dst, uint8_t op, const User &user);
+
+    Shard &shard_(uint64_t h);
+    size_t find_(const Shard &shard, uint64_t h, const std::string &name) const;
+    void   insert_(Shard &shard, uint64_t h, User &&user);
+    void   erase_(Shard &shard, size_t slot);
+    void   rehash_(Shard &shard, size_t capacity);
+
+    bool append_(uint8_t op, const User &user);
+    bool mapFile_(int fd, size_t len);
+    void replay_();
+    void apply_(uint8_t op, User &&user);
+    bool compact_();
+    void compactLoop_();
+
+public:
+    MemUserStore();
+    ~MemUserStore() override;
+
+    bool open(const std::string &path, int compactSec, std::string &errMsg);
+    void close() override;
+
+    Result verify(const std::string &name, const std::string &pwd, bool isLogin) override;
+    bool   remove(const std::string &name);
+
+    bool        blocking() const override { return false; }
+    const char *name() const override { return "memory"; }
+    void        logStats() override;
+};
+
+#endif  //MEMUSERSTORE_H
@@ -0,0 +1,366 @@
+#include "mysqlbackend.h"
+
+#include <mysql/mysqld_error.h>
+
+#include <future>
+
+#include "credcache.h"
+#include "regbatcher.h"
+#include "userbloom.h"
+
+/**
+ * @description: 转义字符串中的特殊字符，用于拼接SQL语句
+ */
+std::string MysqlBackend::escape_(MYSQL *sql, const std::string &str) {
+    std::string ret(str.size() * 2 + 1, '\0');
+    ret.resize(mysql_real_escape_string(sql, &ret[0], str.c_str(), str.size()));
+    return ret;
+}
+
+/**
+ * @description: 查询用户及密码的语句，参数需已转义
+ */
+std::string MysqlBackend::selectSql_(const std::string &name) {
+    return "SELECT username, password FROM user WHERE username='" + name + "' LIMIT 1";
+}
+
+/**
+ * @description: 注册用户的语句，参数需已转义
+ */
+std::string MysqlBackend::insertSql_(const std::string &name, const std::string &pwd) {
+    return "INSERT INTO user(username, password) VALUES('" + name + "','" + pwd + "')";
+}
+
+/**
+ * @description: 先查凭据缓存，能直接得出结果时不访问数据库
+ *              登录：口令一致为通过，口令不一致或用户不存在为失败；注册：用户存在为失败，用户不存在仍需插入
+ * @return {bool} 能直接得出结果时返回true并写入result
+ */
+bool MysqlBackend::fromCache_(const std::string &name, const std::string &pwd, bool isLogin, Result *result) {
+    CredCache::Lookup hit = CredCache::instance()->lookup(name, pwd);
+    if (hit == CredCache::MISS || (!isLogin && hit == CredCache::ABSENT)) {
+        return false;
+    }
+    *result = isLogin && hit == CredCache::MATCH ? OK : FAIL;
+    return true;
+}
+
+/**
+ * @description: 查询到结果后填充凭据缓存，dbPwd为空指针表示用户不存在；
+ *              查询前都经过了布隆过滤器，用户不存在说明过滤器误判了一次；
+ *              刚注册的用户名查不到是副本上注册前开始的读取，结果已过时，不缓存
+ */
+void MysqlBackend::onSelected_(const std::string &name, const char *dbPwd) {
+    if (dbPwd) {
+        CredCache::instance()->putUser(name, dbPwd);
+    } else if (!SqlRouter::instance()->sticky(name)) {
+        CredCache::instance()->putAbsent(name);
+        UserBloom::instance()->markFalsePositive();
+    }
+}
+
+/**
+ * @description: 注册成功后调用，删除凭据缓存中的条目，把用户名加入布隆过滤器，之后一段时间内读这个用户名走主库
+ */
+void MysqlBackend::inserted(const std::string &name) {
+    SqlRouter::instance()->written(name);
+    CredCache::instance()->invalidate(name);
+    UserBloom::instance()->add(name);
+}
+
+/**
+ * @description: 选择同步验证使用预处理语句还是文本查询，默认使用预处理语句，文本查询保留用于对比
+ */
+void MysqlBackend::setPrepared(bool prepared) { prepared_ = prepared; }
+
+/**
+ * @description: 输出合并到其他请求查询上的验证次数
+ */
+void MysqlBackend::logStats() { LOG_INFO("UserAuth lookups coalesced %llu", (unsigned long long)lookups_.coalesced()); }
+
+/**
+ * @description: 根据查询结果得出验证结果，注册且用户名未被使用时返回false，需要继续插入
+ */
+bool MysqlBackend::fromRow_(const UserRow &row, const std::string &pwd, bool isLogin, Result *result) {
+    if (!row.ok) {
+        *result = row.timeout ? TIMEOUT : ERROR;
+        return true;
+    }
+    if (isLogin) {
+        /*登录验证*/
+        bool match = row.found && pwd == row.pwd;
+        if (!match) {
+            LOG_DEBUG("pwd error!");
+        }
+        *result = match ? OK : FAIL;
+        return true;
+    }
+    if (row.found) {
+        LOG_DEBUG("user used!");
+        *result = FAIL;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @description: 读取查询用户的结果集，填充凭据缓存
+ */
+MysqlBackend::UserRow MysqlBackend::readRow_(const std::string &name, MYSQL_RES *res) {
+    UserRow ret;
+    ret.ok = true;
+    /*从结果集中获取下一行*/
+    while (res) {
+        MYSQL_ROW row = mysql_fetch_row(res);
+        if (!row) {
+            break;
+        }
+        ret.found = true;
+        ret.pwd   = row[1] ? row[1] : "";
+    }
+    onSelected_(name, ret.found ? ret.pwd.c_str() : nullptr);
+    return ret;
+}
+
+/**
+ * @description: 根据注册或登录同步验证用户，从连接池取连接，会阻塞调用线程
+ *              同一用户名并发的查询合并为一次，其余请求等待第一个请求的查询结果
+ *              访问数据库受当前线程的期限约束，期限已过或查询被看门狗取消时返回TIMEOUT
+ * @param {string} &name
+ * @param {string} &pwd
+ * @param {bool} isLogin
+ */
+MysqlBackend::Result MysqlBackend::verify(const std::string &name, const std::string &pwd, bool isLogin) {
+    LOG_DEBUG("Verify name:%s", name.c_str());
+    Result result;
+    if (fromCache_(name, pwd, isLogin, &result)) {
+        return result;
+    }
+    /*布隆过滤器确定用户名不存在时，登录直接失败，注册跳过存在性查询；
+      其他进程也向这个库注册用户时，过滤器可能还没有它们注册的用户名，登录仍查询数据库*/
+    bool fresh = !UserBloom::instance()->mayContain(name);
+    if (fresh && isLogin) {
+        if (!UserBloom::instance()->sharedDb()) {
+            LOG_DEBUG("user not exist!");
+            return FAIL;
+        }
+        fresh = false;
+    }
+    /*在数据库通道中排队时已经超过期限*/
+    if (DbDeadline::expired()) {
+        return TIMEOUT;
+    }
+    /*注册交给合并写入的写线程，等待本行的结果*/
+    if (!isLogin && RegBatcher::instance()->isOpen()) {
+        auto done = std::make_shared<std::promise<Result>>();
+        if (!RegBatcher::instance()->submit(name, pwd, fresh, [done](Result result) { done->set_value(result); })) {
+            return ERROR;
+        }
+        return done->get_future().get();
+    }
+    if (fresh) {
+        return insert_(name, pwd);
+    }
+
+    /*等待合并查询的请求按自己的期限等待，执行者超时的结果不共享，等待者重新查询*/
+    UserRow expired;
+    expired.timeout = true;
+    UserRow row     = lookups_.doSync(name, [this, &name] { return select_(name); }, DbDeadline::current(), expired,
+                                      [](const UserRow &row) { return !row.timeout; });
+    if (fromRow_(row, pwd, isLogin, &result)) {
+        return result;
+    }
+    /* 注册行为 且 用户名未被使用*/
+    return insert_(name, pwd);
+}
+
+/**
+ * @description: 同步查询用户，由读写分离路由选择只读副本或主库的连接池取连接
+ */
+MysqlBackend::UserRow MysqlBackend::select_(const std::string &name) {
+    /*获取一个sql连接*/
+    MYSQL       *sql;
+    SqlConnPool *pool = SqlRouter::instance()->reader(name, &sql);
+    SqlConnRAII  sqlConnRaii(sql, pool);
+    UserRow      row;
+    if (!sql) {
+        row.timeout = DbDeadline::expired();
+        return row;
+    }
+    /*看门狗在归还连接前取消登记，不会误杀这条连接上之后的查询*/
+    SqlWatchdog::Guard guard(sql, pool->node());
+    row = prepared_ ? selectStmt_(pool, sql, name) : selectText_(sql, name);
+    if (!row.ok) {
+        row.timeout = guard.killed() || DbDeadline::expired();
+    }
+    return row;
+}
+
+/**
+ * @description: 同步注册用户，从主库连接池取连接
+ *              跳过存在性查询时并发注册同名用户只靠user.username上的唯一索引拦住，唯一键冲突返回FAIL，其他错误返回ERROR
+ */
+MysqlBackend::Result MysqlBackend::insert_(const std::string &name, const std::string &pwd) {
+    MYSQL      *sql;
+    SqlConnRAII sqlConnRaii(&sql, SqlRouter::instance()->writer());
+    if (!sql) {
+        return DbDeadline::expired() ? TIMEOUT : ERROR;
+    }
+    SqlWatchdog::Guard guard(sql);
+    Result             result = prepared_ ? insertStmt_(sql, name, pwd) : insertText_(sql, name, pwd);
+    if (result != OK) {
+        return guard.killed() ? TIMEOUT : result;
+    }
+    inserted(name);
+    LOG_DEBUG("regirster!");
+    return OK;
+}
+
+/**
+ * @description: 使用连接上缓存的预处理语句查询，参数与结果走二进制协议
+ */
+MysqlBackend::UserRow MysqlBackend::selectStmt_(SqlConnPool *pool, MYSQL *sql, const std::string &name) {
+    StmtCache  *stmts = pool->stmts(sql);
+    std::string password;
+
+    StmtCache::Result found = stmts->execute(STMT_SELECT_PASSWORD, {name}, &password);
+    if (found == StmtCache::ERROR) {
+        return {};
+    }
+    onSelected_(name, found == StmtCache::ROW ? password.c_str() : nullptr);
+    return {true, found == StmtCache::ROW, std::move(password)};
+}
+
+MysqlBackend::Result MysqlBackend::insertStmt_(MYSQL *sql, const std::string &name, const std::string &pwd) {
+    StmtCache *stmts = SqlRouter::instance()->writer()->stmts(sql);
+    if (stmts->execute(STMT_INSERT_USER, {name, pwd}) == StmtCache::ERROR) {
+        LOG_DEBUG("Insert error!");
+        return stmts->lastErrno() == ER_DUP_ENTRY ? FAIL : ERROR;
+    }
+    return OK;
+}
+
+/**
+ * @description: 使用文本协议查询，每次都由服务端重新解析语句
+ */
+MysqlBackend::UserRow MysqlBackend::selectText_(MYSQL *sql, const std::string &name) {
+    std::string order = selectSql_(escape_(sql, name));
+    LOG_DEBUG("%s", order.c_str());
+
+    /* mysql_query执行由“Null终结的字符串”查询指向的SQL查询，查询成功，返回0。如果出现错误，返回非0值 */
+    if (mysql_query(sql, order.c_str())) {
+        LOG_ERROR("Select user error: %s", mysql_error(sql));
+        return {};
+    }
+
+    /* mysql_store_result()将查询的全部结果读取到客户端，查询失败或没有结果集时返回空指针 */
+    MYSQL_RES *res = mysql_store_result(sql);
+    UserRow    row = readRow_(name, res);
+    /* 完成对结果集的操作后，必须调用mysql_free_result()释放结果集使用的内存 */
+    mysql_free_result(res);
+    return row;
+}
+
+MysqlBackend::Result MysqlBackend::insertText_(MYSQL *sql, const std::string &name, const std::string &pwd) {
+    std::string order = insertSql_(escape_(sql, name), escape_(sql, pwd));
+    LOG_DEBUG("%s", order.c_str());
+    if (mysql_query(sql, order.c_str())) {
+        LOG_DEBUG("Insert error: %s", mysql_error(sql));
+        return mysql_errno(sql) == ER_DUP_ENTRY ? FAIL : ERROR;
+    }
+    return OK;
+}
+
+/**
+ * @description: 异步验证，查询交给SqlAsync的数据库线程执行，不阻塞调用线程；注册时在查询回调中继续插入
+ *              凭据缓存能直接得出结果时在调用线程中直接调用cb；开启合并写入时注册交给RegBatcher，cb在写线程中调用
+ *              同一用户名并发的查询合并为一次，后来的请求只登记回调，不占用线程等待
+ *              MySQL的非阻塞接口没有预处理语句版本，这里使用转义后的文本查询
+ *              cb在数据库线程中调用；异步查询不可用或排队已满时在调用线程中直接以ERROR调用
+ * @param {string} &name
+ * @param {string} &pwd
+ * @param {bool} isLogin
+ * @param {Callback} cb
+ */
+void MysqlBackend::verifyAsync(const std::string &name, const std::string &pwd, bool isLogin, Callback cb) {
+    Result result;
+    if (fromCache_(name, pwd, isLogin, &result)) {
+        cb(result);
+        return;
+    }
+    bool fresh = !UserBloom::instance()->mayContain(name);
+    if (fresh && isLogin) {
+        if (!UserBloom::instance()->sharedDb()) {
+            cb(FAIL);
+            return;
+        }
+        fresh = false;
+    }
+    if (DbDeadline::expired()) {
+        cb(TIMEOUT);
+        return;
+    }
+    /*注册交给合并写入的写线程，cb在写线程中调用*/
+    if (!isLogin && RegBatcher::instance()->isOpen()) {
+        auto done = std::make_shared<Callback>(std::move(cb));
+        if (!RegBatcher::instance()->submit(name, pwd, fresh, [done](Result result) { (*done)(result); })) {
+            (*done)(ERROR);
+        }
+        return;
+    }
+    if (!SqlAsync::instance()->isOpen()) {
+        cb(ERROR);
+        return;
+    }
+    LOG_DEBUG("Verify async name:%s", name.c_str());
+    if (fresh) {
+        insertAsync_(name, pwd, std::move(cb));
+        return;
+    }
+
+    auto onRow = [name, pwd, isLogin, cb = std::move(cb)](const UserRow &row) {
+        Result result;
+        if (fromRow_(row, pwd, isLogin, &result)) {
+            cb(result);
+            return;
+        }
+        /*注册且用户名未被使用，继续插入*/
+        insertAsync_(name, pwd, cb);
+    };
+    lookups_.doAsync(name, std::move(onRow), [name](std::function<void(const UserRow &)> done) {
+        /*提交失败时查询回调不会执行，直接以失败结束这次查询；刚注册的用户名读主库*/
+        SqlAsync       *async  = SqlAsync::instance();
+        SqlAsync::Route route  = SqlRouter::instance()->stickyRead(name) ? SqlAsync::PRIMARY : SqlAsync::REPLICA;
+        bool            queued = async->query(selectSql_(async->escape(name)), [name, done](SqlAsync::Status status, MYSQL_RES *res) {
+            UserRow row;
+            if (status == SqlAsync::OK) {
+                row = readRow_(name, res);
+            }
+            row.timeout = status == SqlAsync::TIMEOUT;
+            done(row);
+        }, route);
+        if (!queued) {
+            done(UserRow{});
+        }
+    });
+}
+
+/**
+ * @description: 异步注册用户，cb在数据库线程中调用，提交失败时在调用线程中以ERROR调用
+ */
+void MysqlBackend::insertAsync_(const std::string &name, const std::string &pwd, Callback cb) {
+    SqlAsync *async  = SqlAsync::instance();
+    bool      queued = async->query(insertSql_(async->escape(name), async->escape(pwd)), [name, cb](SqlAsync::Status status, MYSQL_RES *) {
+        if (status == SqlAsync::OK) {
+            inserted(name);
+        }
+        /*用户名已被并发注册时违反唯一索引，与查到已存在一样返回FAIL*/
+        cb(status == SqlAsync::OK          ? OK
+           : status == SqlAsync::TIMEOUT   ? TIMEOUT
+           : status == SqlAsync::DUPLICATE ? FAIL
+                                           : ERROR);
+    });
+    if (!queued) {
+        cb(ERROR);
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * @Description  : MySQL用户存储后端，同步验证走连接池，异步验证走SqlAsync，带凭据缓存、布隆过滤器与注册合并写入
+ * @Date         : 2026-10-19 02:08:30
+ * @LastEditTime : 2026-10-19 02:08:30
+ */
+#ifndef MYSQLBACKEND_H
+#define MYSQLBACKEND_H
+
+#include <mysql/mysql.h>
+
+#include <memory>
+#include <string>
+
+#include "../logsys/log.h"
+#include "../pool/sqlasync.h"
+#include "../pool/singleflight.h"
+#include "../pool/sqlconnRAII.h"
+#include "../pool/sqlrouter.h"
+#include "../pool/sqlwatchdog.h"
+#include "userbackend.h"
+
+class MysqlBackend : public UserBackend {
+private:
+    /* 按用户名查询的结果，ok为false表示数据库出错，其中timeout表示超过了请求的数据库期限 */
+    struct UserRow {
+        bool        ok{false};
+        bool        found{false};
+        std::string pwd;
+        bool        timeout{false};
+    };
+
+    bool prepared_{true};  // 同步验证使用预处理语句
+
+    SingleFlight<std::string, UserRow> lookups_;  // 同一用户名并发的查询只执行一次
+
+private:
+    static std::string escape_(MYSQL *sql, const std::string &str);
+    static std::string selectSql_(const std::string &name);
+    static std::string insertSql_(const std::string &name, const std::string &pwd);
+
+    static bool fromCache_(const std::string &name, const std::string &pwd, bool isLogin, Result *result);
+    static void onSelected_(const std::string &name, const char *dbPwd);
+    static void insertAsync_(const std::string &name, const std::string &pwd, Callback cb);
+
+    static bool    fromRow_(const UserRow &row, const std::string &pwd, bool isLogin, Result *result);
+    static UserRow readRow_(const std::string &name, MYSQL_RES *res);
+
+    UserRow select_(const std::string &name);
+    Result  insert_(const std::string &name, const std::string &pwd);
+
+    UserRow selectStmt_(SqlConnPool *pool, MYSQL *sql, const std::string &name);
+    Result  insertStmt_(MYSQL *sql, const std::string &name, const std::string &pwd);
+    UserRow selectText_(MYSQL *sql, const std::string &name);
+    Result  insertText_(MYSQL *sql, const std::string &name, const std::string &pwd);
+
+public:
+    void setPrepared(bool prepared);
+
+    Result verify(const std::string &name, const std::string &pwd, bool isLogin) override;
+    void   verifyAsync(const std::string &name, const std::string &pwd, bool isLogin, Callback cb) override;
+
+    const char *name() const override { return "mysql"; }
+    void        logStats() override;
+
+    static void inserted(const std::string &name);
+};
+
+#endif  //MYSQLBACKEND_H
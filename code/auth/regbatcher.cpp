@@ -0,0 +1,270 @@
+#include "regbatcher.h"
+
+#include <mysql/mysqld_error.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "../pool/sqlconnRAII.h"
+#include "../pool/sqlrouter.h"
+#include "../pool/sqlwatchdog.h"
+#include "credcache.h"
+#include "mysqlbackend.h"
+
+namespace {
+
+/**
+ * @description: 转义并加上引号，用于拼接多行语句，行数不固定，不适合用预处理语句
+ */
+std::string quote(MYSQL *sql, const std::string &str) {
+    std::string ret(str.size() * 2 + 3, '\0');
+    ret[0] = '\'';
+    size_t n = mysql_real_escape_string(sql, &ret[1], str.c_str(), str.size());
+    ret[n + 1] = '\'';
+    ret.resize(n + 2);
+    return ret;
+}
+
+}  // namespace
+
+/**
+ * @description: 懒汉单例模式，局部静态变量
+ */
+RegBatcher *RegBatcher::instance() {
+    static RegBatcher batcher;
+    return &batcher;
+}
+
+/**
+ * @description: 启动写线程，maxRows为0时不启动，注册仍逐条写入
+ * @param {size_t} maxRows 一批最多的行数
+ * @param {int} windowMs 收到第一个注册后最多等待的毫秒数，期间凑满maxRows立即写入
+ * @param {size_t} maxPending 排队的注册上限，0表示不限
+ */
+void RegBatcher::init(size_t maxRows, int windowMs, size_t maxPending) {
+    if (maxRows == 0 || writer_.joinable()) {
+        return;
+    }
+    maxRows_    = maxRows;
+    window_     = std::chrono::milliseconds(windowMs);
+    maxPending_ = maxPending;
+    isClose_    = false;
+    writer_     = std::thread(&RegBatcher::writeLoop_, this);
+}
+
+/**
+ * @description: 停止写线程，已排队的注册写完后退出
+ */
+void RegBatcher::close() {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        isClose_ = true;
+    }
+    cond_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+bool RegBatcher::isOpen() {
+    std::lock_guard<std::mutex> locker(mtx_);
+    return !isClose_;
+}
+
+/**
+ * @description: 提交一个注册，cb在写线程中以本行各自的结果调用：写入为OK，用户名已被使用为FAIL，数据库出错为ERROR，
+ *              超过提交时当前线程的数据库期限为TIMEOUT
+ * @param {bool} fresh 布隆过滤器确定用户名不存在，写入前不需要查询
+ * @return {bool} 已关闭或排队已满时返回false，cb不会被调用
+ */
+bool RegBatcher::submit(const std::string &name, const std::string &pwd, bool fresh, UserAuth::Callback cb) {
+    size_t size;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if (isClose_ || (maxPending_ && queue_.size() >= maxPending_)) {
+            return false;
+        }
+        queue_.push_back({name, pwd, fresh, std::move(cb), DbDeadline::current()});
+        size = queue_.size();
+    }
+    /*只在开始凑批和凑满一批时唤醒写线程*/
+    if (size == 1 || size == maxRows_) {
+        cond_.notify_one();
+    }
+    return true;
+}
+
+/**
+ * @description: 写线程：等到第一个注册后再等一个窗口期或凑满一批，取出一批写入
+ */
+void RegBatcher::writeLoop_() {
+    std::vector<Reg> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> locker(mtx_);
+            cond_.wait(locker, [this] { return isClose_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                break;
+            }
+            cond_.wait_for(locker, window_, [this] { return isClose_ || queue_.size() >= maxRows_; });
+            size_t n = std::min(queue_.size(), maxRows_);
+            for (size_t i = 0; i < n; i++) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+        }
+        commit_(batch);
+        batches_++;
+        rows_ += batch.size();
+        batch.clear();
+    }
+}
+
+/**
+ * @description: 执行一条不返回结果集的语句
+ */
+bool RegBatcher::exec_(MYSQL *sql, const std::string &order) {
+    if (mysql_query(sql, order.c_str())) {
+        LOG_ERROR("Register batch error: %s", mysql_error(sql));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @description: 在一个事务中写入一批注册：先锁定批内已存在的用户名，再用一条多行INSERT写入其余的，只提交一次
+ *              布隆过滤器确定不存在的用户名跳过查询，整批都是新用户名时只有一条INSERT
+ *              批内重复的用户名只有第一个参与写入；多行INSERT失败时回滚，改为逐条写入以得到每行各自的结果
+ *              已超过期限的注册不再写入；整批按其中最晚的期限执行，被看门狗取消时整批返回TIMEOUT
+ */
+void RegBatcher::commit_(std::vector<Reg> &batch) {
+    auto deadline = DbDeadline::Clock::time_point::min();
+    for (auto &reg : batch) {
+        if (DbDeadline::expired(reg.deadline)) {
+            reg.cb(UserAuth::TIMEOUT);
+            reg.cb = nullptr;
+        } else {
+            deadline = std::max(deadline, reg.deadline);
+        }
+    }
+    batch.erase(std::remove_if(batch.begin(), batch.end(), [](const Reg &reg) { return !reg.cb; }), batch.end());
+    if (batch.empty()) {
+        return;
+    }
+    DbDeadline::Scope scope(deadline);
+
+    MYSQL      *sql;
+    SqlConnRAII sqlConnRaii(&sql, SqlRouter::instance()->writer());
+    if (!sql) {
+        for (auto &reg : batch) {
+            reg.cb(DbDeadline::expired() ? UserAuth::TIMEOUT : UserAuth::ERROR);
+        }
+        return;
+    }
+    SqlWatchdog::Guard guard(sql);
+
+    /*批内去重，重复的用户名直接失败*/
+    std::unordered_map<std::string, Reg *> byName;
+    std::vector<Reg *>                     rows;
+    for (auto &reg : batch) {
+        if (byName.emplace(reg.name, &reg).second) {
+            rows.push_back(&reg);
+        } else {
+            reg.cb(UserAuth::FAIL);
+        }
+    }
+
+    /*布隆过滤器确定不存在的用户名不需要查询，其余的在事务中一次查询并锁定*/
+    std::string order;
+    for (Reg *reg : rows) {
+        if (!reg->fresh) {
+            order += (order.empty() ? "" : ",") + quote(sql, reg->name);
+        }
+    }
+    bool select = !order.empty();
+    order       = "SELECT username, password FROM user WHERE username IN (" + order + ") FOR UPDATE";
+    if (!exec_(sql, "START TRANSACTION") || (select && !exec_(sql, order))) {
+        exec_(sql, "ROLLBACK");
+        for (Reg *reg : rows) {
+            reg->cb(guard.killed() ? UserAuth::TIMEOUT : UserAuth::ERROR);
+        }
+        return;
+    }
+    MYSQL_RES *res = select ? mysql_store_result(sql) : nullptr;
+    while (res) {
+        MYSQL_ROW row = mysql_fetch_row(res);
+        if (!row) {
+            break;
+        }
+        auto it = byName.find(row[0] ? row[0] : "");
+        if (it != byName.end() && it->second) {
+            CredCache::instance()->putUser(it->first, row[1] ? row[1] : "");
+            it->second->cb(UserAuth::FAIL);
+            it->second = nullptr;
+        }
+    }
+    mysql_free_result(res);
+
+    /*其余的用户名在一条语句中写入*/
+    std::vector<Reg *> inserts;
+    order = "INSERT INTO user(username, password) VALUES";
+    for (Reg *reg : rows) {
+        if (byName[reg->name]) {
+            order += (inserts.empty() ? "(" : ",(") + quote(sql, reg->name) + "," + quote(sql, reg->pwd) + ")";
+            inserts.push_back(reg);
+        }
+    }
+    if (inserts.empty()) {
+        exec_(sql, "COMMIT");
+        return;
+    }
+    if (!exec_(sql, order) || !exec_(sql, "COMMIT")) {
+        /*只有唯一键冲突(其他进程并发注册了同名用户)才逐条重试，其余错误时连接状态不明，整批返回ERROR*/
+        bool duplicate = mysql_errno(sql) == ER_DUP_ENTRY;
+        exec_(sql, "ROLLBACK");
+        if (guard.killed() || !duplicate) {
+            for (Reg *reg : inserts) {
+                reg->cb(guard.killed() ? UserAuth::TIMEOUT : UserAuth::ERROR);
+            }
+            return;
+        }
+        for (size_t i = commitEach_(sql, inserts); i < inserts.size(); i++) {
+            inserts[i]->cb(guard.killed() ? UserAuth::TIMEOUT : UserAuth::ERROR);
+        }
+        return;
+    }
+    LOG_DEBUG("Register batch: %zu rows in one commit", inserts.size());
+    for (Reg *reg : inserts) {
+        MysqlBackend::inserted(reg->name);
+        reg->cb(UserAuth::OK);
+    }
+}
+
+/**
+ * @description: 逐条自动提交写入，多行INSERT因唯一键冲突失败时(例如其他进程并发注册了同名用户)得到每行各自的结果
+ *              只有唯一键冲突返回FAIL；遇到其他错误时停止，这一行与之后的行不再在这个连接上写入
+ * @return {size_t} 已经调用过回调的行数，其余的由调用者返回ERROR或TIMEOUT
+ */
+size_t RegBatcher::commitEach_(MYSQL *sql, std::vector<Reg *> &rows) {
+    for (size_t i = 0; i < rows.size(); i++) {
+        Reg        *reg = rows[i];
+        std::string order =
+            "INSERT INTO user(username, password) VALUES(" + quote(sql, reg->name) + "," + quote(sql, reg->pwd) + ")";
+        if (mysql_query(sql, order.c_str())) {
+            if (mysql_errno(sql) != ER_DUP_ENTRY) {
+                LOG_ERROR("Insert error: %s", mysql_error(sql));
+                return i;
+            }
+            LOG_DEBUG("Insert duplicate: %s", mysql_error(sql));
+            reg->cb(UserAuth::FAIL);
+            continue;
+        }
+        MysqlBackend::inserted(reg->name);
+        reg->cb(UserAuth::OK);
+    }
+    return rows.size();
+}
+
+uint64_t RegBatcher::batches() const { return batches_; }
+
+uint64_t RegBatcher::rows() const { return rows_; }
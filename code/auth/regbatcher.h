@@ -0,0 +1,70 @@
+/*
+ * @Description  : 注册合并写入，写线程把几毫秒内并发的注册收集成一批，在一个事务中用一条多行INSERT写入，单例模式
+ * @Date         : 2026-10-19 00:52:18
+ * @LastEditTime : 2026-10-19 00:52:18
+ */
+#ifndef REGBATCHER_H
+#define REGBATCHER_H
+
+#include <mysql/mysql.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../pool/dbdeadline.h"
+#include "userauth.h"
+
+class RegBatcher {
+private:
+    /* 一个等待写入的注册 */
+    struct Reg {
+        std::string                   name;
+        std::string                   pwd;
+        bool                          fresh;  // 布隆过滤器确定用户名不存在，不需要查询
+        UserAuth::Callback            cb;
+        DbDeadline::Clock::time_point deadline;  // 提交时的数据库期限
+    };
+
+    std::mutex              mtx_;
+    std::condition_variable cond_;
+    std::deque<Reg>         queue_;
+    bool                    isClose_{true};
+
+    size_t                    maxRows_{0};     // 一批最多的行数，0表示关闭
+    std::chrono::milliseconds window_{0};      // 收到第一个注册后最多再等多久凑批
+    size_t                    maxPending_{0};  // 排队的注册上限，0表示不限
+
+    std::thread writer_;
+
+    std::atomic<uint64_t> batches_{0};  // 已提交的批次数
+    std::atomic<uint64_t> rows_{0};     // 已处理的注册数
+
+private:
+    RegBatcher()  = default;
+    ~RegBatcher() = default;
+
+    void        writeLoop_();
+    void        commit_(std::vector<Reg> &batch);
+    size_t      commitEach_(MYSQL *sql, std::vector<Reg *> &rows);
+    static bool exec_(MYSQL *sql, const std::string &order);
+
+public:
+    static RegBatcher *instance();
+
+    void init(size_t maxRows, int windowMs, size_t maxPending);
+    void close();
+    bool isOpen();
+
+    bool submit(const std::string &name, const std::string &pwd, bool fresh, UserAuth::Callback cb);
+
+    uint64_t batches() const;
+    uint64_t rows() const;
+};
+
+#endif  //REGBATCHER_H
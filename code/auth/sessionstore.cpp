@@ -0,0 +1,171 @@
+#include "sessionstore.h"
+
+#include <sys/random.h>
+
+#include "../logsys/log.h"
+
+/**
+ * @description: 从32位十六进制字符串解析会话id，长度或字符不合法时返回false，不产生拷贝
+ */
+bool SessionStore::Id::parse(std::string_view hex) {
+    if (hex.size() != ID_LEN) {
+        return false;
+    }
+    uint64_t half[2] = {0, 0};
+    for (size_t i = 0; i < ID_LEN; i++) {
+        char     ch = hex[i];
+        uint64_t v;
+        if (ch >= '0' && ch <= '9') {
+            v = ch - '0';
+        } else if (ch >= 'a' && ch <= 'f') {
+            v = ch - 'a' + 10;
+        } else {
+            return false;
+        }
+        half[i / 16] = (half[i / 16] << 4) | v;
+    }
+    hi = half[0];
+    lo = half[1];
+    return true;
+}
+
+/**
+ * @description: 格式化为32位小写十六进制，不带结尾的'\0'
+ */
+void SessionStore::Id::format(char out[ID_LEN]) const {
+    static const char DIGITS[] = "0123456789abcdef";
+    for (size_t i = 0; i < 16; i++) {
+        out[i]      = DIGITS[(hi >> (60 - 4 * i)) & 0xf];
+        out[16 + i] = DIGITS[(lo >> (60 - 4 * i)) & 0xf];
+    }
+}
+
+/**
+ * @description: 懒汉单例模式，局部静态变量
+ */
+SessionStore *SessionStore::instance() {
+    static SessionStore store;
+    return &store;
+}
+
+/**
+ * @description: 初始化会话容量与有效期，capacity或ttlSec为0时会话关闭
+ * @param {size_t} capacity 最多保存的会话数，平均分到各分片，分片满时淘汰最早创建的会话
+ * @param {int} ttlSec 会话从创建起的有效秒数
+ */
+void SessionStore::init(size_t capacity, int ttlSec) {
+    shardCap_  = ttlSec > 0 ? (capacity + SHARD_COUNT - 1) / SHARD_COUNT : 0;
+    ttlSec_    = ttlSec;
+    ttl_       = std::chrono::seconds(ttlSec);
+    nextSweep_ = Clock::now();
+}
+
+bool SessionStore::isOpen() const { return shardCap_ > 0; }
+
+int SessionStore::ttlSec() const { return ttlSec_; }
+
+SessionStore::Shard &SessionStore::shard_(const Id &id) { return shards_[id.hi & (SHARD_COUNT - 1)]; }
+
+/**
+ * @description: 为user创建会话，会话id取自内核随机数；取不到随机数时不创建，避免发放可预测的id
+ * @return {bool} 创建成功时写入id
+ */
+bool SessionStore::create(const std::string &user, Id *id) {
+    if (!isOpen()) {
+        return false;
+    }
+    uint64_t rnd[2];
+    if (getrandom(rnd, sizeof(rnd), 0) != static_cast<ssize_t>(sizeof(rnd))) {
+        LOG_ERROR("SessionStore getrandom error");
+        return false;
+    }
+    id->hi = rnd[0];
+    id->lo = rnd[1];
+
+    auto                        expire = Clock::now() + ttl_;
+    Shard                      &shard  = shard_(*id);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    /*分片已满时从队头淘汰最早创建的会话，队中可能有已被查询删除的过期id*/
+    while (shard.map.size() >= shardCap_ && !shard.expiry.empty()) {
+        if (shard.map.erase(shard.expiry.front().second)) {
+            evicted_++;
+        }
+        shard.expiry.pop_front();
+    }
+    shard.map[*id] = {user, expire};
+    shard.expiry.emplace_back(expire, *id);
+    created_++;
+    return true;
+}
+
+/**
+ * @description: 查询会话对应的用户名，O(1)且不访问数据库；已过期的会话顺便删除
+ * @return {bool} 会话存在且未过期时返回true并写入user
+ */
+bool SessionStore::lookup(const Id &id, std::string *user) {
+    if (!isOpen()) {
+        return false;
+    }
+    Shard                      &shard = shard_(id);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto                        it = shard.map.find(id);
+    if (it == shard.map.end()) {
+        misses_++;
+        return false;
+    }
+    if (it->second.expire <= Clock::now()) {
+        shard.map.erase(it);
+        expired_++;
+        misses_++;
+        return false;
+    }
+    hits_++;
+    *user = it->second.user;
+    return true;
+}
+
+/**
+ * @description: 由事件循环每次醒来时调用，至少间隔SWEEP_MS才清理一次，每个分片只弹出队头已过期的会话，
+ *              代价与过期的会话数成正比，不扫描整个表
+ */
+void SessionStore::sweep() {
+    if (!isOpen()) {
+        return;
+    }
+    auto now = Clock::now();
+    if (now < nextSweep_) {
+        return;
+    }
+    nextSweep_ = now + std::chrono::milliseconds(SWEEP_MS);
+    for (auto &shard : shards_) {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        while (!shard.expiry.empty() && shard.expiry.front().first <= now) {
+            if (shard.map.erase(shard.expiry.front().second)) {
+                expired_++;
+            }
+            shard.expiry.pop_front();
+        }
+    }
+}
+
+uint64_t SessionStore::created() const { return created_; }
+
+uint64_t SessionStore::hits() const { return hits_; }
+
+uint64_t SessionStore::misses() const { return misses_; }
+
+uint64_t SessionStore::expired() const { return expired_; }
+
+uint64_t SessionStore::evicted() const { return evicted_; }
+
+/**
+ * @description: 当前保存的会话数，逐个分片加锁统计，只用于输出统计
+ */
+size_t SessionStore::size() {
+    size_t total = 0;
+    for (auto &shard : shards_) {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        total += shard.map.size();
+    }
+    return total;
+}
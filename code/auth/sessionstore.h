@@ -0,0 +1,93 @@
+/*
+ * @Description  : 登录会话表，登录或注册成功时发放随机会话id，之后的请求凭Cookie中的id直接得到用户名，不访问数据库，单例模式
+ * @Date         : 2026-10-19 05:18:44
+ * @LastEditTime : 2026-10-19 05:18:44
+ */
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class SessionStore {
+public:
+    static const int    SHARD_COUNT = 64;    // 分片数，必须是2的幂
+    static const int    SWEEP_MS    = 1000;  // 两次清理过期会话的最短间隔
+    static const size_t ID_LEN      = 32;    // 会话id的十六进制长度
+
+    static constexpr std::string_view COOKIE_NAME = "sid";
+
+    using Clock = std::chrono::steady_clock;
+
+    /* 128位随机会话id，本身是均匀随机数，直接用低位做散列与分片 */
+    struct Id {
+        uint64_t hi{0};
+        uint64_t lo{0};
+
+        bool operator==(const Id &other) const { return hi == other.hi && lo == other.lo; }
+
+        bool parse(std::string_view hex);
+        void format(char out[ID_LEN]) const;
+    };
+
+private:
+    struct IdHash {
+        size_t operator()(const Id &id) const { return id.lo; }
+    };
+
+    struct Session {
+        std::string       user;
+        Clock::time_point expire;
+    };
+
+    /* 每个分片一把锁；会话有效期固定，按创建顺序排队即按过期时间排队，清理只看队头 */
+    struct alignas(64) Shard {
+        std::mutex                                   mtx;
+        std::unordered_map<Id, Session, IdHash>      map;
+        std::deque<std::pair<Clock::time_point, Id>> expiry;
+    };
+
+    Shard shards_[SHARD_COUNT];
+
+    size_t            shardCap_{0};  // 每个分片最多的会话数，0表示会话关闭
+    Clock::duration   ttl_{};        // 会话有效期
+    int               ttlSec_{0};
+    Clock::time_point nextSweep_;    // 只由事件循环线程访问
+
+    std::atomic<uint64_t> created_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> expired_{0};
+    std::atomic<uint64_t> evicted_{0};
+
+private:
+    SessionStore()  = default;
+    ~SessionStore() = default;
+
+    Shard &shard_(const Id &id);
+
+public:
+    static SessionStore *instance();
+
+    void init(size_t capacity, int ttlSec);
+    bool isOpen() const;
+    int  ttlSec() const;
+
+    bool create(const std::string &user, Id *id);
+    bool lookup(const Id &id, std::string *user);
+    void sweep();
+
+    uint64_t created() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+    uint64_t expired() const;
+    uint64_t evicted() const;
+    size_t   size();
+};
+
+#endif  //SESSIONSTORE_H
@@ -0,0 +1,34 @@
+/*
+ * @Description  : SHA-256摘要，用于在内存中保存口令的散列而不是明文
+ * @Date         : 2026-10-19 00:24:10
+ * @LastEditTime : 2026-10-19 00:24:10
+ */
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+
+class Sha256 {
+public:
+    static const size_t DIGEST_LEN = 32;
+    using Digest                   = std::array<uint8_t, DIGEST_LEN>;
+
+private:
+    uint32_t state_[8];
+    uint64_t totalLen_;  // 已输入的总字节数
+    uint8_t  block_[64];
+    size_t   blockLen_;  // block_中未处理的字节数
+
+    void transform_(const uint8_t *block);
+
+public:
+    Sha256();
+
+    void   update(const void *data, size_t len);
+    Digest final();
+};
+
+#endif  //SHA256_H
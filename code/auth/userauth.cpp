@@ -0,0 +1,59 @@
+#include "userauth.h"
+
+#include "mysqlbackend.h"
+
+UserAuth::UserAuth() : backend_(std::make_unique<MysqlBackend>()) {}
+
+UserAuth::~UserAuth() = default;
+
+/**
+ * @description: 懒汉单例模式，局部静态变量
+ */
+UserAuth *UserAuth::instance() {
+    static UserAuth auth;
+    return &auth;
+}
+
+/**
+ * @description: 更换存储后端，需在开始处理请求前调用
+ */
+void UserAuth::setBackend(std::unique_ptr<UserBackend> backend) { backend_ = std::move(backend); }
+
+UserBackend *UserAuth::backend() { return backend_.get(); }
+
+/**
+ * @description: 根据注册或登录同步验证用户，是否阻塞取决于后端
+ * @param {string} &name
+ * @param {string} &pwd
+ * @param {bool} isLogin
+ */
+UserAuth::Result UserAuth::verify(const std::string &name, const std::string &pwd, bool isLogin) {
+    /*密码或用户名为空，直接错误*/
+    if (name == "" || pwd == "") {
+        return FAIL;
+    }
+    return backend_->verify(name, pwd, isLogin);
+}
+
+/**
+ * @description: 异步验证，cb总会被调用一次，在哪个线程中调用取决于后端
+ * @param {string} &name
+ * @param {string} &pwd
+ * @param {bool} isLogin
+ * @param {Callback} cb
+ */
+void UserAuth::verifyAsync(const std::string &name, const std::string &pwd, bool isLogin, Callback cb) {
+    if (name == "" || pwd == "") {
+        cb(FAIL);
+        return;
+    }
+    backend_->verifyAsync(name, pwd, isLogin, std::move(cb));
+}
+
+bool UserAuth::blocking() const { return backend_->blocking(); }
+
+const char *UserAuth::name() const { return backend_->name(); }
+
+void UserAuth::logStats() { backend_->logStats(); }
+
+void UserAuth::close() { backend_->close(); }
@@ -0,0 +1,37 @@
+/*
+ * @Description  : 用户登录注册验证，提供同步与异步两种方式，具体存储由配置的后端完成，单例模式
+ * @Date         : 2026-10-18 23:21:47
+ * @LastEditTime : 2026-10-19 02:10:12
+ */
+#ifndef USERAUTH_H
+#define USERAUTH_H
+
+#include <memory>
+#include <string>
+
+#include "userbackend.h"
+
+class UserAuth : public UserBackend {
+private:
+    std::unique_ptr<UserBackend> backend_;  // 默认为MySQL后端
+
+private:
+    UserAuth();
+    ~UserAuth() override;
+
+public:
+    static UserAuth *instance();
+
+    void         setBackend(std::unique_ptr<UserBackend> backend);
+    UserBackend *backend();
+
+    Result verify(const std::string &name, const std::string &pwd, bool isLogin) override;
+    void   verifyAsync(const std::string &name, const std::string &pwd, bool isLogin, Callback cb) override;
+
+    bool        blocking() const override;
+    const char *name() const override;
+    void        logStats() override;
+    void        close() override;
+};
+
+#endif  //USERAUTH_H
@@ -0,0 +1,52 @@
+/*
+ * @Description  : 用户存储后端接口，登录注册验证由具体后端完成：MySQL或进程内存储
+ * @Date         : 2026-10-19 02:06:44
+ * @LastEditTime : 2026-10-19 02:06:44
+ */
+#ifndef USERBACKEND_H
+#define USERBACKEND_H
+
+#include <functional>
+#include <string>
+
+class UserBackend {
+public:
+    /* 验证结果：通过、用户名或密码不符（注册时为用户名已被使用）、后端出错、超过请求的数据库期限 */
+    enum Result { OK, FAIL, ERROR, TIMEOUT };
+
+    /* 异步验证的回调，可能在后端自己的线程中执行 */
+    using Callback = std::function<void(Result)>;
+
+    virtual ~UserBackend() = default;
+
+    /**
+     * @description: 同步验证，用户名与密码已检查非空
+     */
+    virtual Result verify(const std::string &name, const std::string &pwd, bool isLogin) = 0;
+
+    /**
+     * @description: 异步验证，cb总会被调用一次；默认就地同步验证
+     */
+    virtual void verifyAsync(const std::string &name, const std::string &pwd, bool isLogin, Callback cb) {
+        cb(verify(name, pwd, isLogin));
+    }
+
+    /**
+     * @description: 同步验证是否会阻塞在网络或磁盘上，不会阻塞的后端直接在static通道中验证
+     */
+    virtual bool blocking() const { return true; }
+
+    virtual const char *name() const = 0;
+
+    /**
+     * @description: 由服务器定期调用，输出后端自己的统计
+     */
+    virtual void logStats() {}
+
+    /**
+     * @description: 服务器退出时调用，释放后端自己的线程与文件
+     */
+    virtual void close() {}
+};
+
+#endif  //USERBACKEND_H
@@ -0,0 +1,269 @@
+#include "userbloom.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "../logsys/log.h"
+#include "../pool/sqlconnRAII.h"
+
+namespace {
+
+const int RETRY_SEC = 10;  // 加载失败后的重试间隔
+
+/**
+ * @description: 64位整数混合函数，把std::hash的结果打散成两个独立的哈希值
+ */
+inline uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/**
+ * @description: 把64位哈希映射到[0, n)，用乘法代替取模
+ */
+inline uint64_t reduce(uint64_t x, uint64_t n) { return (uint64_t)(((unsigned __int128)x * n) >> 64); }
+
+/**
+ * @description: 按user.username列的比较规则得到过滤器的键：默认的_ci排序规则不区分大小写并忽略结尾空格，
+ *              "Alice"、"alice "与"alice"是同一个用户名，ASCII字母转小写并去掉结尾空格；
+ *              含非ASCII字符时排序规则还会折叠重音等，无法在这里等价处理，返回false，调用者不能据此判定不存在
+ */
+bool foldName(const std::string &name, std::string *key) {
+    size_t len = name.find_last_not_of(' ');
+    len        = len == std::string::npos ? 0 : len + 1;
+    key->resize(len);
+    bool ascii = true;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char ch = name[i];
+        ascii &= ch < 0x80;
+        (*key)[i] = ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch;
+    }
+    return ascii;
+}
+
+}  // namespace
+
+/**
+ * @description: 按预计元素个数与目标误判率计算位数与哈希函数个数：m = -n*ln(p)/ln2^2，k = m/n*ln2
+ */
+UserBloom::Filter::Filter(uint64_t expected, double fpRate) : setBits(0), count(0) {
+    double m = -(double)expected * log(fpRate) / (M_LN2 * M_LN2);
+    bits     = std::max<uint64_t>(64, ((uint64_t)m + 63) / 64 * 64);
+    hashes   = std::max(1, std::min(16, (int)lround(m / expected * M_LN2)));
+    words.reset(new std::atomic<uint64_t>[bits / 64]);
+    for (uint64_t i = 0; i < bits / 64; i++) {
+        words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @description: 双重哈希：第i个位置为h1 + i*h2
+ */
+void UserBloom::Filter::add(const std::string &name) {
+    std::string key;
+    foldName(name, &key);
+    uint64_t h  = std::hash<std::string>()(key);
+    uint64_t h1 = mix(h);
+    uint64_t h2 = mix(h ^ 0x9e3779b97f4a7c15ULL) | 1;
+    for (int i = 0; i < hashes; i++) {
+        uint64_t bit  = reduce(h1 + i * h2, bits);
+        uint64_t mask = 1ULL << (bit & 63);
+        if (!(words[bit >> 6].fetch_or(mask, std::memory_order_relaxed) & mask)) {
+            setBits.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool UserBloom::Filter::mayContain(const std::string &name) const {
+    std::string key;
+    if (!foldName(name, &key)) {
+        return true;
+    }
+    uint64_t h  = std::hash<std::string>()(key);
+    uint64_t h1 = mix(h);
+    uint64_t h2 = mix(h ^ 0x9e3779b97f4a7c15ULL) | 1;
+    for (int i = 0; i < hashes; i++) {
+        uint64_t bit = reduce(h1 + i * h2, bits);
+        if (!(words[bit >> 6].load(std::memory_order_relaxed) & (1ULL << (bit & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @description: 懒汉单例模式，局部静态变量
+ */
+UserBloom *UserBloom::instance() {
+    static UserBloom bloom;
+    return &bloom;
+}
+
+/**
+ * @description: 启动加载线程，expected为0时不启用，查询总是返回可能存在
+ * @param {uint64_t} expected 预计的用户数，重建时按上次扫描到的用户数放大
+ * @param {double} fpRate 目标误判率
+ * @param {int} rebuildSec 重建间隔秒数，0表示只在启动时加载一次
+ */
+void UserBloom::init(uint64_t expected, double fpRate, int rebuildSec, bool sharedDb) {
+    if (expected == 0 || loader_.joinable()) {
+        return;
+    }
+    sharedDb_   = sharedDb;
+    expected_   = expected;
+    fpRate_     = fpRate > 0 && fpRate < 1 ? fpRate : 0.01;
+    rebuildSec_ = rebuildSec;
+    isClose_    = false;
+    loader_     = std::thread(&UserBloom::loadLoop_, this);
+}
+
+void UserBloom::close() {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        isClose_ = true;
+    }
+    cond_.notify_all();
+    if (loader_.joinable()) {
+        loader_.join();
+    }
+}
+
+bool UserBloom::isReady() const { return current_.load(std::memory_order_acquire) != nullptr; }
+
+/**
+ * @description: 是否有其他进程向同一个库注册用户；此时过滤器只包含本进程知道的用户名，判定不存在的登录仍要查询数据库
+ */
+bool UserBloom::sharedDb() const { return sharedDb_; }
+
+/**
+ * @description: 加载线程：启动时加载一次，之后按间隔重建；加载失败时稍后重试
+ */
+void UserBloom::loadLoop_() {
+    std::unique_lock<std::mutex> locker(mtx_);
+    while (!isClose_) {
+        locker.unlock();
+        bool ok = load_();
+        locker.lock();
+        if (ok && rebuildSec_ <= 0) {
+            cond_.wait(locker, [this] { return isClose_; });
+        } else {
+            cond_.wait_for(locker, std::chrono::seconds(ok ? rebuildSec_ : RETRY_SEC), [this] { return isClose_; });
+        }
+    }
+}
+
+/**
+ * @description: 流式扫描user表生成一个新的过滤器后替换当前的；扫描期间注册的用户名同时加入新过滤器
+ *              mysql_use_result逐行读取结果，不会把整张表读到客户端内存中
+ */
+bool UserBloom::load_() {
+    Filter  *old      = current_.load(std::memory_order_acquire);
+    uint64_t expected = std::max<uint64_t>(expected_, old ? old->count.load() * 2 : 0);
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        building_ = std::make_unique<Filter>(expected, fpRate_);
+    }
+
+    /*扫描读主库，副本复制延迟内注册的用户名也不会漏掉，否则它们登录会被直接判为不存在*/
+    MYSQL      *sql;
+    SqlConnRAII sqlConnRaii(&sql, SqlConnPool::instance());
+    bool        ok = false;
+    if (!sql) {
+        LOG_ERROR("UserBloom load: no sql connection");
+    } else if (mysql_query(sql, "SELECT username FROM user")) {
+        LOG_ERROR("UserBloom load error: %s", mysql_error(sql));
+    } else if (MYSQL_RES *res = mysql_use_result(sql)) {
+        Filter *filter = building_.get();
+        while (MYSQL_ROW row = mysql_fetch_row(res)) {
+            if (row[0]) {
+                filter->add(row[0]);
+            }
+        }
+        /*读取中途出错时mysql_fetch_row也返回空，需要检查错误码*/
+        ok = mysql_errno(sql) == 0;
+        if (!ok) {
+            LOG_ERROR("UserBloom load error: %s", mysql_error(sql));
+        }
+        mysql_free_result(res);
+    }
+
+    std::lock_guard<std::mutex> locker(mtx_);
+    if (!ok) {
+        building_.reset();
+        return false;
+    }
+    /*旧过滤器保留到下次重建，正在查询它的读者早已结束*/
+    retired_ = std::move(owned_);
+    owned_   = std::move(building_);
+    current_.store(owned_.get(), std::memory_order_release);
+    LOG_INFO("UserBloom loaded %llu names, %llu bits, %d hashes", (unsigned long long)owned_->count.load(),
+             (unsigned long long)owned_->bits, owned_->hashes);
+    return true;
+}
+
+/**
+ * @description: 查询用户名是否可能存在，返回false时一定不存在；未加载完成时总是返回true
+ */
+bool UserBloom::mayContain(const std::string &name) {
+    const Filter *filter = current_.load(std::memory_order_acquire);
+    if (!filter) {
+        return true;
+    }
+    queries_.fetch_add(1, std::memory_order_relaxed);
+    if (!filter->mayContain(name)) {
+        negatives_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @description: 注册成功后加入用户名；正在重建时同时加入新过滤器，避免替换后丢失
+ */
+void UserBloom::add(const std::string &name) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    if (owned_) {
+        owned_->add(name);
+    }
+    if (building_) {
+        building_->add(name);
+    }
+}
+
+/**
+ * @description: 通过了过滤器但数据库中查不到，记一次误判
+ */
+void UserBloom::markFalsePositive() {
+    if (isReady()) {
+        falsePos_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint64_t UserBloom::queries() const { return queries_; }
+
+uint64_t UserBloom::negatives() const { return negatives_; }
+
+uint64_t UserBloom::falsePositives() const { return falsePos_; }
+
+uint64_t UserBloom::count() const {
+    const Filter *filter = current_.load(std::memory_order_acquire);
+    return filter ? filter->count.load(std::memory_order_relaxed) : 0;
+}
+
+/**
+ * @description: 按置1的位所占比例估计当前的误判率：(置1位数/总位数)^k
+ */
+double UserBloom::estimatedFpRate() const {
+    const Filter *filter = current_.load(std::memory_order_acquire);
+    if (!filter) {
+        return 0;
+    }
+    return pow((double)filter->setBits.load(std::memory_order_relaxed) / filter->bits, filter->hashes);
+}
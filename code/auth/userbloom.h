@@ -0,0 +1,79 @@
+/*
+ * @Description  : 已注册用户名的布隆过滤器，启动时流式扫描user表加载，注册成功时加入，定期重建，读取无锁，单例模式
+ * @Date         : 2026-10-19 01:38:05
+ * @LastEditTime : 2026-10-19 01:38:05
+ */
+#ifndef USERBLOOM_H
+#define USERBLOOM_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class UserBloom {
+private:
+    /* 一个位数组，位只会被置1，读写都用原子操作，不需要加锁 */
+    struct Filter {
+        std::unique_ptr<std::atomic<uint64_t>[]> words;
+        uint64_t                                 bits;     // 位数
+        int                                      hashes;   // 哈希函数个数
+        std::atomic<uint64_t>                    setBits;  // 已置1的位数，用于估计误判率
+        std::atomic<uint64_t>                    count;    // 加入的用户名个数
+
+        Filter(uint64_t expected, double fpRate);
+
+        void add(const std::string &name);
+        bool mayContain(const std::string &name) const;
+    };
+
+    std::atomic<Filter *>   current_{nullptr};  // 查询使用的过滤器，加载完成前为空
+    std::unique_ptr<Filter> owned_;             // current_的所有者
+    std::unique_ptr<Filter> retired_;           // 上一个过滤器，下次重建时才释放，保证读者用完
+    std::unique_ptr<Filter> building_;          // 正在重建的过滤器，期间注册的用户名同时加入
+
+    std::mutex              mtx_;  // 保护owned_、retired_、building_的切换
+    std::condition_variable cond_;
+    bool                    isClose_{false};
+    std::thread             loader_;
+
+    uint64_t expected_{0};      // 预计的用户数，0表示关闭
+    double   fpRate_{0.01};     // 目标误判率
+    int      rebuildSec_{0};    // 重建间隔，0表示只在启动时加载一次
+    bool     sharedDb_{false};  // 其他进程也向同一个库注册用户，过滤器判定不存在的登录仍查询数据库
+
+    std::atomic<uint64_t> queries_{0};    // 查询次数
+    std::atomic<uint64_t> negatives_{0};  // 确定不存在的次数
+    std::atomic<uint64_t> falsePos_{0};   // 通过过滤器但数据库中不存在的次数
+
+private:
+    UserBloom()  = default;
+    ~UserBloom() = default;
+
+    bool load_();
+    void loadLoop_();
+
+public:
+    static UserBloom *instance();
+
+    void init(uint64_t expected, double fpRate, int rebuildSec, bool sharedDb = false);
+    void close();
+    bool isReady() const;
+    bool sharedDb() const;
+
+    bool mayContain(const std::string &name);
+    void add(const std::string &name);
+    void markFalsePositive();
+
+    uint64_t queries() const;
+    uint64_t negatives() const;
+    uint64_t falsePositives() const;
+    uint64_t count() const;
+    double   estimatedFpRate() const;
+};
+
+#endif  //USERBLOOM_H
@@ -90,8 +90,8 @@ void Buffer::append(const char *str, size_t len) {
     hasWritten(len);
 }
 
-void Buffer::append(const std::string &str) {
-    /*str.data()获取str的char指针*/
+void Buffer::append(std::string_view str) {
+    /*string与字符串字面量都能隐式转换为string_view，避免构造临时string*/
     append(str.data(), str.size());
 }
 
@@ -13,6 +13,7 @@
 #include <atomic>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class Buffer {
@@ -24,7 +25,6 @@ private:
     char *beginPtr() const;
 
     void extendSpace(size_t len);
-    void ensureWritable(size_t len);
 
 public:
     Buffer(int initBufferSize = 1024);
@@ -39,6 +39,8 @@ public:
     char *beginRead() const;
     char *beginWrite() const;
 
+    void ensureWritable(size_t len);
+
     void hasRead(size_t len);
     void hasWritten(size_t len);
 
@@ -46,7 +48,7 @@ public:
     std::string retrieveAllToStr();
 
     void append(const char *str, size_t len);
-    void append(const std::string &str);
+    void append(std::string_view str);
     void append(const Buffer &buff);
 
     ssize_t readFd(int fd, int *saveErrno);
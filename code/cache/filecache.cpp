@@ -0,0 +1,395 @@
+#include "filecache.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "respack.h"
+
+FileEntry::~FileEntry() {
+    if (data) {
+        munmap(data, mapLen);
+    }
+}
+
+FileCache::~FileCache() { close(); }
+
+/**
+ * @description: 懒汉单例模式，局部静态变量
+ */
+FileCache *FileCache::instance() {
+    static FileCache cache;
+    return &cache;
+}
+
+/**
+ * @description: 初始化缓存，递归监视资源目录，并启动后台监视线程
+ * @param {string} &srcDir 资源目录
+ * @param {size_t} hotBytes 热点集合上限，后台线程会把最常请求的文件预缺页并锁定在内存中
+ */
+void FileCache::init(const std::string &srcDir, size_t hotBytes) {
+    assert(!srcDir.empty());
+    srcDir_   = srcDir;
+    hotBytes_ = hotBytes;
+    while (srcDir_.size() > 1 && srcDir_.back() == '/') {
+        srcDir_.pop_back();
+    }
+
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd_    = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd_ < 0 || stopFd_ < 0) {
+        /*没有inotify就无法感知文件变化，此时不能信任缓存，get会直接加载*/
+        LOG_ERROR("FileCache inotify init error: %s", strerror(errno));
+        return;
+    }
+    addWatch_("/");
+    watcher_ = std::make_unique<std::thread>(&FileCache::watchLoop_, this);
+    LOG_INFO("FileCache watching %s, %d dirs", srcDir_.c_str(), (int)watchDirs_.size());
+}
+
+/**
+ * @description: 停止后台线程，清空缓存，被析构函数调用
+ */
+void FileCache::close() {
+    if (watcher_ && watcher_->joinable()) {
+        uint64_t one = 1;
+        ::write(stopFd_, &one, sizeof(one));
+        watcher_->join();
+    }
+    watcher_.reset();
+    if (inotifyFd_ >= 0) {
+        ::close(inotifyFd_);
+        inotifyFd_ = -1;
+    }
+    if (stopFd_ >= 0) {
+        ::close(stopFd_);
+        stopFd_ = -1;
+    }
+    invalidateAll_();
+}
+
+uint64_t FileCache::hits() const { return hits_; }
+
+uint64_t FileCache::misses() const { return misses_; }
+
+uint64_t FileCache::coalesced() const { return loads_.coalesced(); }
+
+/**
+ * @description: 查询缓存，未命中时stat、open、mmap后放入缓存；同一路径并发未命中时只由第一个请求加载，其余等待它的结果
+ * @param {string} &path 请求路径，以'/'开头
+ * @return 文件不存在时返回空指针
+ */
+FileEntryPtr FileCache::get(const std::string &path) {
+    /*后台线程没有运行，或路径可能跳出资源目录时，inotify感知不到变化，不放入缓存*/
+    bool cacheable = watcher_ && path.find("/..") == std::string::npos;
+    if (cacheable) {
+        std::shared_lock<std::shared_mutex> locker(mtx_);
+        auto                                it = entries_.find(path);
+        if (it != entries_.end()) {
+            ++hits_;
+            it->second->hits.fetch_add(1, std::memory_order_relaxed);
+            return it->second;
+        }
+    }
+    ++misses_;
+
+    return loads_.doSync(path, [this, &path, cacheable] {
+        uint64_t     gen   = generation_.load(std::memory_order_acquire);
+        FileEntryPtr entry = load_(path);
+        if (entry && cacheable) {
+            std::unique_lock<std::shared_mutex> locker(mtx_);
+            /*加载期间发生过失效，加载的内容可能已经过期，本次使用但不缓存*/
+            if (gen == generation_.load(std::memory_order_relaxed)) {
+                entries_.emplace(path, entry);
+            }
+        }
+        return entry;
+    });
+}
+
+/**
+ * @description: 从文件系统加载一个缓存项
+ * @param {string} &path
+ */
+FileEntryPtr FileCache::load_(const std::string &path) const {
+    std::string fullPath = srcDir_ + path;
+    auto        entry    = std::make_shared<FileEntry>();
+    if (stat(fullPath.data(), &entry->st) < 0) {
+        return nullptr;
+    }
+    /*目录、无读权限或空文件只缓存文件信息*/
+    if (S_ISDIR(entry->st.st_mode) || !(entry->st.st_mode & S_IROTH) || entry->st.st_size == 0) {
+        return entry;
+    }
+
+    int srcFd = open(fullPath.data(), O_RDONLY);
+    if (srcFd < 0) {
+        return nullptr;
+    }
+    /*首次加载时让内核异步预读整个文件，工作线程发送时尽量不再因为读盘而阻塞*/
+    posix_fadvise(srcFd, 0, 0, POSIX_FADV_WILLNEED);
+    /*MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
+    void *mmRet = mmap(nullptr, entry->st.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
+    ::close(srcFd);
+    if (mmRet == MAP_FAILED) {
+        return nullptr;
+    }
+    madvise(mmRet, entry->st.st_size, MADV_WILLNEED);
+    entry->data   = static_cast<char *>(mmRet);
+    entry->len    = entry->st.st_size;
+    entry->mapLen = entry->len;
+    entry->hits   = 1;
+    LOG_DEBUG("FileCache load %s, size %d", path.c_str(), (int)entry->len);
+    return entry;
+}
+
+void FileCache::invalidate_(const std::string &path) {
+    std::unique_lock<std::shared_mutex> locker(mtx_);
+    generation_.fetch_add(1, std::memory_order_release);
+    RespPack::instance()->markStale(path);
+    if (entries_.erase(path)) {
+        ++invalidations_;
+        LOG_DEBUG("FileCache invalidate %s", path.c_str());
+    }
+}
+
+/**
+ * @description: 失效某个目录下的所有缓存项，目录被删除或移动时使用
+ * @param {string} &prefix 以'/'结尾的目录
+ */
+void FileCache::invalidatePrefix_(const std::string &prefix) {
+    std::unique_lock<std::shared_mutex> locker(mtx_);
+    generation_.fetch_add(1, std::memory_order_release);
+    RespPack::instance()->markStalePrefix(prefix);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->first.compare(0, prefix.size(), prefix) == 0) {
+            it = entries_.erase(it);
+            ++invalidations_;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void FileCache::invalidateAll_() {
+    std::unique_lock<std::shared_mutex> locker(mtx_);
+    generation_.fetch_add(1, std::memory_order_release);
+    invalidations_ += entries_.size();
+    entries_.clear();
+}
+
+/**
+ * @description: 递归地为目录及其子目录添加监视
+ * @param {string} &relDir 相对资源目录的路径，以'/'开头和结尾
+ */
+void FileCache::addWatch_(const std::string &relDir) {
+    std::string fullDir = srcDir_ + relDir;
+    int         wd      = inotify_add_watch(inotifyFd_, fullDir.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        LOG_WARN("FileCache watch %s error: %s", fullDir.c_str(), strerror(errno));
+        return;
+    }
+    watchDirs_[wd] = relDir;
+
+    std::error_code ec;
+    for (auto &item : std::filesystem::directory_iterator(fullDir, ec)) {
+        if (item.is_directory(ec) && !item.is_symlink(ec)) {
+            addWatch_(relDir + item.path().filename().string() + "/");
+        }
+    }
+}
+
+/**
+ * @description: 处理一个inotify事件
+ *  文件的修改、创建、删除、属性变化以及rename覆盖部署都会使对应缓存项失效
+ */
+void FileCache::handleEvent_(const inotify_event *ev) {
+    if (ev->mask & IN_Q_OVERFLOW) {
+        /*事件队列溢出，丢失了事件，只能全部失效*/
+        LOG_WARN("FileCache inotify queue overflow!");
+        RespPack::instance()->markStalePrefix("/");
+        invalidateAll_();
+        return;
+    }
+    auto it = watchDirs_.find(ev->wd);
+    if (it == watchDirs_.end()) {
+        return;
+    }
+    if (ev->mask & IN_IGNORED) {
+        /*目录被删除或移走，内核已自动移除监视*/
+        watchDirs_.erase(it);
+        return;
+    }
+    const std::string &dir = it->second;
+    if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        invalidatePrefix_(dir);
+        return;
+    }
+    if (ev->len == 0) {
+        return;
+    }
+
+    std::string path = dir + ev->name;
+    if (ev->mask & IN_ISDIR) {
+        /*子目录变化：整个前缀失效，新出现的目录需要加入监视*/
+        invalidate_(path);
+        invalidatePrefix_(path + "/");
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+            addWatch_(path + "/");
+        }
+    } else {
+        invalidate_(path);
+    }
+}
+
+/**
+ * @description: 后台监视线程的工作函数，等待inotify事件或退出通知
+ */
+void FileCache::watchLoop_() {
+    alignas(inotify_event) char buf[16 * 1024];
+    pollfd                      fds[2] = {{inotifyFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+
+    using Clock = std::chrono::steady_clock;
+
+    const auto interval  = std::chrono::milliseconds(HOT_INTERVAL_MS);
+    auto       rebalance = Clock::now() + interval;  // 下次调整热点集合的时间
+    while (true) {
+        /*到期就调整一次热点集合，调整中的缺页发生在本线程而不是工作线程；
+         *按到期时间而不是poll超时判断，持续到来的inotify事件不会让调整一直推迟*/
+        int timeout = -1;
+        if (hotBytes_ > 0) {
+            auto now = Clock::now();
+            if (now >= rebalance) {
+                rebalanceHotSet_();
+                now       = Clock::now();
+                rebalance = now + interval;
+            }
+            timeout = std::chrono::duration_cast<std::chrono::milliseconds>(rebalance - now).count() + 1;
+        }
+        int ret = poll(fds, 2, timeout);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("FileCache poll error: %s", strerror(errno));
+            break;
+        }
+        if (ret == 0) {
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        ssize_t len;
+        while ((len = ::read(inotifyFd_, buf, sizeof(buf))) > 0) {
+            for (char *p = buf; p < buf + len;) {
+                auto *ev = reinterpret_cast<inotify_event *>(p);
+                handleEvent_(ev);
+                p += sizeof(inotify_event) + ev->len;
+            }
+        }
+    }
+}
+
+/**
+ * @description: 按请求频率重新选出热点集合：频率最高、总大小不超过hotBytes_的文件
+ *  新进入热点的文件复制到预缺页并锁定的匿名内存中，大文件使用透明大页；
+ *  掉出热点的文件直接移出缓存，下次请求时重新映射
+ */
+void FileCache::rebalanceHotSet_() {
+    std::vector<std::pair<std::string, FileEntryPtr>> snapshot;
+    {
+        std::shared_lock<std::shared_mutex> locker(mtx_);
+        snapshot.reserve(entries_.size());
+        for (auto &item : entries_) {
+            if (item.second->data) {
+                snapshot.push_back(item);
+            }
+        }
+    }
+    /*按频率降序排列，随后频率减半，让热点集合能跟上访问模式的变化*/
+    std::vector<uint64_t> freq(snapshot.size());
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        freq[i] = snapshot[i].second->hits.load(std::memory_order_relaxed);
+        snapshot[i].second->hits.store(freq[i] / 2, std::memory_order_relaxed);
+    }
+    std::vector<size_t> order(snapshot.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&freq](size_t a, size_t b) { return freq[a] > freq[b]; });
+
+    size_t used = 0;
+    for (size_t i : order) {
+        auto &[path, entry] = snapshot[i];
+        bool  keep          = freq[i] > 0 && used + entry->len <= hotBytes_;
+        if (keep) {
+            used += entry->len;
+            if (!entry->hot) {
+                FileEntryPtr hotEntry = makeHot_(entry);
+                if (hotEntry && replaceIfSame_(path, entry, hotEntry)) {
+                    LOG_DEBUG("FileCache hot %s, size %d", path.c_str(), (int)entry->len);
+                }
+            }
+        } else if (entry->hot) {
+            replaceIfSame_(path, entry, nullptr);
+        }
+    }
+}
+
+/**
+ * @description: 生成一个热点副本：匿名内存，复制时完成全部缺页，再尝试mlock
+ * @param {FileEntryPtr} &entry 原来的文件映射缓存项
+ */
+FileEntryPtr FileCache::makeHot_(const FileEntryPtr &entry) {
+    static const size_t PAGE = sysconf(_SC_PAGESIZE);
+
+    bool   useHuge = entry->len >= HUGE_PAGE;
+    size_t align   = useHuge ? HUGE_PAGE : PAGE;
+    size_t mapLen  = (entry->len + align - 1) / align * align;
+
+    /*多申请一个对齐单位，裁掉头尾，保证起始地址按大页对齐*/
+    size_t rawLen = useHuge ? mapLen + align : mapLen;
+    char  *raw    = static_cast<char *>(
+        mmap(nullptr, rawLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+    char *addr = raw;
+    if (useHuge) {
+        addr = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(raw) + align - 1) & ~(align - 1));
+        if (addr > raw) munmap(raw, addr - raw);
+        if (raw + rawLen > addr + mapLen) munmap(addr + mapLen, raw + rawLen - (addr + mapLen));
+        madvise(addr, mapLen, MADV_HUGEPAGE);
+    }
+    memcpy(addr, entry->data, entry->len);
+    mprotect(addr, mapLen, PROT_READ);
+    if (mlock(addr, mapLen) < 0 && !mlockWarned_) {
+        /*超过RLIMIT_MEMLOCK时内存已经预缺页，只是可能被换出*/
+        mlockWarned_ = true;
+        LOG_WARN("FileCache mlock error: %s, hot set is prefaulted but not locked", strerror(errno));
+    }
+
+    auto hotEntry    = std::make_shared<FileEntry>();
+    hotEntry->st     = entry->st;
+    hotEntry->data   = addr;
+    hotEntry->len    = entry->len;
+    hotEntry->mapLen = mapLen;
+    hotEntry->hot    = true;
+    hotEntry->hits   = entry->hits.load(std::memory_order_relaxed);
+    return hotEntry;
+}
+
+/**
+ * @description: 只有缓存中仍是old时才替换，期间被inotify失效的项不会被放回
+ * @param {FileEntryPtr} &entry 新的缓存项，为空表示移除
+ */
+bool FileCache::replaceIfSame_(const std::string &path, const FileEntryPtr &old,
+                               const FileEntryPtr &entry) {
+    std::unique_lock<std::shared_mutex> locker(mtx_);
+    auto                                it = entries_.find(path);
+    if (it == entries_.end() || it->second != old) {
+        return false;
+    }
+    if (entry) {
+        it->second = entry;
+    } else {
+        entries_.erase(it);
+    }
+    return true;
+}
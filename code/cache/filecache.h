@@ -0,0 +1,111 @@
+/*
+ * @Description  : 静态资源缓存，缓存文件信息与内存映射，由inotify后台线程负责失效，单例模式
+ * @Date         : 2026-10-18 11:02:15
+ * @LastEditTime : 2026-10-18 11:02:15
+ */
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../logsys/log.h"
+#include "../pool/singleflight.h"
+
+/**
+ * @description: 一个缓存项，创建后只读；析构时解除映射，
+ *  请求持有shared_ptr，所以缓存项被失效后正在发送的响应仍然安全
+ */
+struct FileEntry {
+    struct stat st;             // 文件信息
+    char       *data{nullptr};  // 文件映射地址，目录、无权限或空文件时为空
+    size_t      len{0};         // 文件长度
+    size_t      mapLen{0};      // 映射长度，热点项按页或大页取整
+    bool        hot{false};     // 是否是已预缺页并锁定在内存中的热点副本
+
+    mutable std::atomic<uint64_t> hits{0};  // 请求次数，每轮热点调整后减半
+
+    FileEntry() : st{} {}
+    ~FileEntry();
+
+    FileEntry(const FileEntry &)            = delete;
+    FileEntry &operator=(const FileEntry &) = delete;
+};
+
+using FileEntryPtr = std::shared_ptr<const FileEntry>;
+
+class FileCache {
+private:
+    static const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE |
+                                       IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |
+                                       IN_MOVE_SELF | IN_ONLYDIR;
+
+    std::string srcDir_;  // 资源根目录，不以'/'结尾
+
+    std::shared_mutex                             mtx_;      // 读多写少，使用读写锁
+    std::unordered_map<std::string, FileEntryPtr> entries_;  // key为请求路径，如 /index.html
+    std::atomic<uint64_t> generation_{0};  // 每次失效加1，防止加载过程中的修改被覆盖
+
+    int                                  inotifyFd_{-1};
+    int                                  stopFd_{-1};  // eventfd，用于通知后台线程退出
+    std::unordered_map<int, std::string> watchDirs_;   // 监视描述符 -> 相对目录，如 /css/
+    std::unique_ptr<std::thread>         watcher_;
+
+    static const int    HOT_INTERVAL_MS = 1000;              // 热点集合调整周期
+    static const size_t HUGE_PAGE       = 2 * 1024 * 1024;  // 透明大页大小
+
+    size_t hotBytes_{0};         // 热点集合的总字节上限，0表示不启用
+    bool   mlockWarned_{false};  // mlock失败只报一次
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> invalidations_{0};
+
+    SingleFlight<std::string, FileEntryPtr> loads_;  // 同一路径并发未命中时只加载一次
+
+private:
+    FileCache() = default;
+    ~FileCache();
+
+    FileEntryPtr load_(const std::string &path) const;
+
+    void invalidate_(const std::string &path);
+    void invalidatePrefix_(const std::string &prefix);
+    void invalidateAll_();
+
+    void addWatch_(const std::string &relDir);
+    void handleEvent_(const inotify_event *ev);
+    void watchLoop_();
+
+    void         rebalanceHotSet_();
+    FileEntryPtr makeHot_(const FileEntryPtr &entry);
+    bool         replaceIfSame_(const std::string &path, const FileEntryPtr &old,
+                                const FileEntryPtr &entry);
+
+public:
+    static FileCache *instance();
+
+    void init(const std::string &srcDir, size_t hotBytes = 0);
+    void close();
+
+    FileEntryPtr get(const std::string &path);
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+    uint64_t coalesced() const;
+};
+
+#endif  //FILECACHE_H
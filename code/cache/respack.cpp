@@ -0,0 +1,400 @@
+#include "respack.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "../http/httpresponse.h"
+
+constexpr char RespPack::MAGIC[8];
+
+namespace {
+
+/* 打包时一个文件的全部信息 */
+struct PackItem {
+    std::string      path;
+    std::string_view mime;
+    std::string      data;
+    std::string      gz;
+    uint64_t         etag;
+};
+
+size_t alignUp(size_t n) { return (n + RespPack::ALIGN - 1) / RespPack::ALIGN * RespPack::ALIGN; }
+
+/**
+ * @description: 以gzip格式压缩，压缩后没有明显变小则返回空串
+ */
+std::string gzipCompress(const std::string &src) {
+    if (src.size() < 256) {
+        return "";
+    }
+    z_stream zs{};
+    /*windowBits加16表示输出gzip格式的头尾*/
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return "";
+    }
+    std::string out(deflateBound(&zs, src.size()), '\0');
+    zs.next_in   = (Bytef *)src.data();
+    zs.avail_in  = src.size();
+    zs.next_out  = (Bytef *)out.data();
+    zs.avail_out = out.size();
+    int ret      = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END || out.size() > src.size() * 9 / 10) {
+        return "";
+    }
+    return out;
+}
+
+std::string gzipDecompress(const char *src, size_t len) {
+    z_stream zs{};
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) {
+        return "";
+    }
+    std::string out;
+    char        buf[64 * 1024];
+    zs.next_in  = (Bytef *)src;
+    zs.avail_in = len;
+    int ret     = Z_OK;
+    while (ret == Z_OK) {
+        zs.next_out  = (Bytef *)buf;
+        zs.avail_out = sizeof(buf);
+        ret          = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    }
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END ? out : "";
+}
+
+/**
+ * @description: 收集资源目录下所有其他用户可读的普通文件，路径按字节序排序
+ */
+bool collectFiles(const std::string &srcDir, std::vector<PackItem> &items, std::string &errMsg) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::path        root = fs::path(srcDir).lexically_normal();
+    for (auto it = fs::recursive_directory_iterator(root, ec); !ec && it != fs::end(it);
+         it.increment(ec)) {
+        struct stat st;
+        if (stat(it->path().c_str(), &st) < 0 || !S_ISREG(st.st_mode) || !(st.st_mode & S_IROTH)) {
+            /*无权限的文件不打包，请求时回退到文件系统，保持403的行为*/
+            continue;
+        }
+        std::ifstream ifs(it->path(), std::ios::binary);
+        if (!ifs) {
+            errMsg = "open " + it->path().string() + " failed";
+            return false;
+        }
+        PackItem item;
+        item.path = "/" + it->path().lexically_relative(root).generic_string();
+        item.data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        item.mime = HttpResponse::fileType(item.path);
+        item.etag = RespPack::fnv1a(item.data.data(), item.data.size());
+        item.gz   = gzipCompress(item.data);
+        items.push_back(std::move(item));
+    }
+    if (ec) {
+        errMsg = "scan " + srcDir + " failed: " + ec.message();
+        return false;
+    }
+    std::sort(items.begin(), items.end(),
+              [](const PackItem &a, const PackItem &b) { return a.path < b.path; });
+    return true;
+}
+
+}  // namespace
+
+RespPack::~RespPack() { close(); }
+
+/**
+ * @description: 懒汉单例模式，局部静态变量
+ */
+RespPack *RespPack::instance() {
+    static RespPack pack;
+    return &pack;
+}
+
+/**
+ * @description: 64位FNV-1a哈希，用作ETag
+ */
+uint64_t RespPack::fnv1a(const char *data, size_t len) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/**
+ * @description: 扫描资源目录生成资源包，先写临时文件再rename，正在使用旧包的进程不受影响
+ * @param {string} &srcDir   资源目录
+ * @param {string} &packPath 输出文件
+ * @param {string} &errMsg   失败原因
+ */
+bool RespPack::build(const std::string &srcDir, const std::string &packPath, std::string &errMsg) {
+    std::vector<PackItem> items;
+    if (!collectFiles(srcDir, items, errMsg)) {
+        return false;
+    }
+
+    /*字符串表：路径与MIME类型*/
+    std::string            strTab;
+    std::vector<PackEntry> entries(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        entries[i].pathOff = strTab.size();
+        entries[i].pathLen = items[i].path.size();
+        strTab += items[i].path;
+        entries[i].mimeOff = strTab.size();
+        entries[i].mimeLen = items[i].mime.size();
+        strTab += items[i].mime;
+    }
+
+    PackHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.count   = items.size();
+    header.strOff  = sizeof(PackHeader) + sizeof(PackEntry) * items.size();
+    header.dataOff = alignUp(header.strOff + strTab.size());
+
+    /*数据区：每段内容都从页边界开始*/
+    uint64_t off = header.dataOff;
+    for (size_t i = 0; i < items.size(); i++) {
+        entries[i].dataOff = off;
+        entries[i].dataLen = items[i].data.size();
+        entries[i].etag    = items[i].etag;
+        off                = alignUp(off + items[i].data.size());
+        if (!items[i].gz.empty()) {
+            entries[i].gzOff = off;
+            entries[i].gzLen = items[i].gz.size();
+            off              = alignUp(off + items[i].gz.size());
+        }
+    }
+    header.totalSize = off;
+
+    std::string   tmpPath = packPath + ".tmp";
+    std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        errMsg = "create " + tmpPath + " failed";
+        return false;
+    }
+    auto padTo = [&ofs](uint64_t pos) {
+        static const char zeros[ALIGN] = {0};
+        uint64_t          cur          = ofs.tellp();
+        if (pos > cur) ofs.write(zeros, pos - cur);
+    };
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char *>(entries.data()), sizeof(PackEntry) * entries.size());
+    ofs.write(strTab.data(), strTab.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        padTo(entries[i].dataOff);
+        ofs.write(items[i].data.data(), items[i].data.size());
+        if (entries[i].gzLen) {
+            padTo(entries[i].gzOff);
+            ofs.write(items[i].gz.data(), items[i].gz.size());
+        }
+    }
+    padTo(header.totalSize);
+    ofs.close();
+    if (!ofs || rename(tmpPath.c_str(), packPath.c_str()) < 0) {
+        errMsg = "write " + packPath + " failed";
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @description: 映射资源包并校验头部与索引，只做一次mmap，之后的查找不再有系统调用
+ * @param {string} &packPath
+ * @param {string} &errMsg
+ */
+bool RespPack::open(const std::string &packPath, std::string &errMsg) {
+    close();
+    int fd = ::open(packPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        errMsg = "open " + packPath + " failed";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(PackHeader)) {
+        ::close(fd);
+        errMsg = packPath + " is too small";
+        return false;
+    }
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        errMsg = "mmap " + packPath + " failed";
+        return false;
+    }
+    base_ = static_cast<char *>(addr);
+    size_ = st.st_size;
+
+    auto *header = reinterpret_cast<const PackHeader *>(base_);
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION ||
+        header->totalSize != size_ ||
+        header->strOff != sizeof(PackHeader) + sizeof(PackEntry) * (uint64_t)header->count ||
+        header->dataOff > size_ || header->strOff > header->dataOff) {
+        close();
+        errMsg = packPath + " has a bad header";
+        return false;
+    }
+    count_   = header->count;
+    entries_ = reinterpret_cast<const PackEntry *>(base_ + sizeof(PackHeader));
+    strTab_  = base_ + header->strOff;
+
+    uint64_t strLen = header->dataOff - header->strOff;
+    for (uint32_t i = 0; i < count_; i++) {
+        const PackEntry &e = entries_[i];
+        if (e.pathOff + (uint64_t)e.pathLen > strLen || e.mimeOff + (uint64_t)e.mimeLen > strLen ||
+            e.dataOff + e.dataLen > size_ || e.gzOff + e.gzLen > size_ ||
+            (i > 0 && pathOf_(i - 1) >= pathOf_(i))) {
+            close();
+            errMsg = packPath + " has a bad index";
+            return false;
+        }
+    }
+    /*整个资源包异步预读进页缓存，工作线程发送时不必等待读盘*/
+    madvise(base_, size_, MADV_WILLNEED);
+    stale_.reset(new std::atomic<bool>[count_]);
+    for (uint32_t i = 0; i < count_; i++) {
+        stale_[i] = false;
+    }
+    return true;
+}
+
+void RespPack::close() {
+    if (base_) {
+        munmap(base_, size_);
+    }
+    base_    = nullptr;
+    size_    = 0;
+    entries_ = nullptr;
+    strTab_  = nullptr;
+    count_   = 0;
+    stale_.reset();
+}
+
+bool RespPack::isOpen() const { return base_ != nullptr; }
+
+uint32_t RespPack::count() const { return count_; }
+
+std::string_view RespPack::pathOf_(uint32_t i) const {
+    return {strTab_ + entries_[i].pathOff, entries_[i].pathLen};
+}
+
+/**
+ * @description: 在有序索引上二分查找，找不到返回-1
+ */
+long RespPack::find_(std::string_view path) const {
+    uint32_t lo = 0, hi = count_;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int      cmp = pathOf_(mid).compare(path);
+        if (cmp == 0) {
+            return mid;
+        } else if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @description: 查找请求路径，内容已过期的文件视为不存在
+ * @param {string_view} path
+ * @param {PackFile} &file 查找结果
+ */
+bool RespPack::lookup(std::string_view path, PackFile &file) const {
+    if (!base_) {
+        return false;
+    }
+    long i = find_(path);
+    if (i < 0 || stale_[i].load(std::memory_order_relaxed)) {
+        return false;
+    }
+    const PackEntry &e = entries_[i];
+    file.mime          = {strTab_ + e.mimeOff, e.mimeLen};
+    file.data          = base_ + e.dataOff;
+    file.len           = e.dataLen;
+    file.gzData        = e.gzLen ? base_ + e.gzOff : nullptr;
+    file.gzLen         = e.gzLen;
+    file.etag          = e.etag;
+    return true;
+}
+
+/**
+ * @description: 标记文件在包中的内容已过期，之后的请求回退到文件系统
+ */
+void RespPack::markStale(std::string_view path) {
+    if (!base_) {
+        return;
+    }
+    long i = find_(path);
+    if (i >= 0) {
+        stale_[i].store(true, std::memory_order_relaxed);
+    }
+}
+
+void RespPack::markStalePrefix(std::string_view prefix) {
+    if (!base_) {
+        return;
+    }
+    for (uint32_t i = 0; i < count_; i++) {
+        if (pathOf_(i).substr(0, prefix.size()) == prefix) {
+            stale_[i].store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @description: 校验资源包：索引有序且不越界，数据页对齐，内容与资源目录一致，预压缩内容可以解压还原
+ * @param {string} &srcDir
+ * @param {string} &packPath
+ * @param {string} &errMsg
+ */
+bool RespPack::verify(const std::string &srcDir, const std::string &packPath, std::string &errMsg) {
+    RespPack pack;
+    if (!pack.open(packPath, errMsg)) {
+        return false;
+    }
+    std::vector<PackItem> items;
+    if (!collectFiles(srcDir, items, errMsg)) {
+        return false;
+    }
+    if (items.size() != pack.count_) {
+        errMsg = "file count mismatch: dir " + std::to_string(items.size()) + ", pack " +
+                 std::to_string(pack.count_);
+        return false;
+    }
+    for (uint32_t i = 0; i < pack.count_; i++) {
+        const PackEntry &e = pack.entries_[i];
+        PackFile         file;
+        std::string      path(pack.pathOf_(i));
+        if (path != items[i].path || !pack.lookup(path, file)) {
+            errMsg = "missing " + items[i].path;
+            return false;
+        }
+        if (e.dataOff % ALIGN != 0 || (e.gzLen && e.gzOff % ALIGN != 0)) {
+            errMsg = path + " is not page aligned";
+            return false;
+        }
+        if (std::string_view(file.data, file.len) != items[i].data ||
+            file.etag != fnv1a(file.data, file.len) || file.mime != items[i].mime) {
+            errMsg = path + " content mismatch";
+            return false;
+        }
+        if (file.gzLen && gzipDecompress(file.gzData, file.gzLen) != items[i].data) {
+            errMsg = path + " gzip variant mismatch";
+            return false;
+        }
+    }
+    return true;
+}
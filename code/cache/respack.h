@@ -0,0 +1,97 @@
+/*
+ * @Description  : 静态资源包，启动时把resources/打包成一个文件并整体映射到内存，查找不需要系统调用
+ * @Date         : 2026-10-18 14:05:31
+ * @LastEditTime : 2026-10-18 14:05:31
+ */
+#ifndef RESPACK_H
+#define RESPACK_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * 资源包文件布局，整数均为小端：
+ *   PackHeader | PackEntry[count]（按路径字节序排序） | 字符串表 | 按页对齐的文件数据
+ * 每个文件的数据和它的gzip预压缩版本各自从页边界开始
+ */
+struct PackHeader {
+    char     magic[8];  // "LWSPACK1"
+    uint32_t version;
+    uint32_t count;      // 文件个数
+    uint64_t strOff;     // 字符串表偏移
+    uint64_t dataOff;    // 数据区偏移
+    uint64_t totalSize;  // 整个资源包的大小，用于校验
+};
+
+struct PackEntry {
+    uint32_t pathOff, pathLen;  // 请求路径，如 /index.html，相对字符串表
+    uint32_t mimeOff, mimeLen;  // Content-type，相对字符串表
+    uint64_t dataOff, dataLen;  // 原始内容，相对文件开头
+    uint64_t gzOff, gzLen;      // gzip预压缩内容，gzLen为0表示没有
+    uint64_t etag;              // 原始内容的FNV-1a哈希
+};
+
+/**
+ * @description: 查找结果，指针都指向资源包的映射区
+ */
+struct PackFile {
+    std::string_view mime;
+    const char      *data{nullptr};
+    size_t           len{0};
+    const char      *gzData{nullptr};
+    size_t           gzLen{0};
+    uint64_t         etag{0};
+};
+
+class RespPack {
+public:
+    static constexpr char     MAGIC[8] = {'L', 'W', 'S', 'P', 'A', 'C', 'K', '1'};
+    static constexpr uint32_t VERSION  = 1;
+    static constexpr size_t   ALIGN    = 4096;
+
+private:
+    char             *base_{nullptr};  // 资源包映射地址
+    size_t            size_{0};
+    const PackEntry  *entries_{nullptr};
+    const char       *strTab_{nullptr};
+    uint32_t          count_{0};
+
+    /* 资源目录中被修改过的文件在包里的内容已过期，由FileCache的监视线程标记，查找时跳过 */
+    std::unique_ptr<std::atomic<bool>[]> stale_;
+
+private:
+    RespPack() = default;
+    ~RespPack();
+
+    std::string_view pathOf_(uint32_t i) const;
+    long             find_(std::string_view path) const;
+
+public:
+    static RespPack *instance();
+
+    static bool build(const std::string &srcDir, const std::string &packPath, std::string &errMsg);
+    static bool verify(const std::string &srcDir, const std::string &packPath, std::string &errMsg);
+
+    static uint64_t fnv1a(const char *data, size_t len);
+
+    bool open(const std::string &packPath, std::string &errMsg);
+    void close();
+
+    bool     isOpen() const;
+    uint32_t count() const;
+
+    bool lookup(std::string_view path, PackFile &file) const;
+
+    void markStale(std::string_view path);
+    void markStalePrefix(std::string_view prefix);
+};
+
+#endif  //RESPACK_H
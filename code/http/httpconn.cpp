@@ -4,8 +4,31 @@ char *HttpConn::srcDir = nullptr;
 bool  HttpConn::isET   = false;
 
 std::atomic<int> HttpConn::userCount;
+int              HttpConn::dbTimeoutMS = 0;
 
-HttpConn::HttpConn() : fd_(-1), isClose_(true) { addr_ = {0}; }
+HttpConn::HttpConn()
+    : fd_(-1),
+      isClose_(true),
+      iovCnt_(0),
+      respBytes_(0),
+      minorFaults_(0),
+      majorFaults_(0),
+      stages_{},
+      reqIndex_(1),
+      dbResult_(UserAuth::OK),
+      dbAsyncUs_(0),
+      dbToken_(0),
+      dbSeq_(0) {
+    addr_   = {0};
+    iov_[0] = iov_[1] = {nullptr, 0};
+}
+
+/* 距离某个时刻经过的微秒数 */
+static long microsSince(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                 begin)
+        .count();
+}
 
 /**
  * @description: 初始化httpconn类实例
@@ -21,6 +44,8 @@ void HttpConn::init(int sockfd, const sockaddr_in &addr) {
 
     writeBuff_.clearAll();
     readBuff_.clearAll();
+    stages_   = {};
+    reqIndex_ = 1;
 
     LOG_INFO("Client[%d](%s:%d) in, userCount: %d", sockfd, getIP(), getPort(), (int)userCount);
 }
@@ -41,7 +66,10 @@ void HttpConn::closeConn() {
     }
 }
 
-bool HttpConn::isKeepAlive() const { return request_.isKeepAlive(); }
+/**
+ * @description: 按已发送的响应决定是否保持连接，响应声明了Connection: close(如400、503、504)时关闭
+ */
+bool HttpConn::isKeepAlive() const { return response_.isKeepAlive(); }
 
 int HttpConn::getFd() const { return fd_; }
 
@@ -53,17 +81,22 @@ int HttpConn::getPort() const { return addr_.sin_port; }
 
 /**
  * @description: 读取socket中的数据，保存到读缓冲区中，并设置可能的错误号
+ *  单次最多读取READ_BUDGET字节，剩余的数据在重新注册EPOLLIN后由下一次事件读取
  * @param {int} *saveErrno
  */
 ssize_t HttpConn::read(int *saveErrno) {
-    ssize_t len = -1;
-    /*如果是LT模式，那么只读取一次，如果是ET模式，会一直读取，直到读不出数据*/
+    ssize_t len   = -1;
+    size_t  total = 0;
+    auto    begin = std::chrono::steady_clock::now();
+    /*如果是LT模式，那么只读取一次，如果是ET模式，会一直读取，直到读不出数据或用完额度*/
     do {
         len = readBuff_.readFd(fd_, saveErrno);
         if (len <= 0) {
             break;
         }
-    } while (isET);
+        total += len;
+    } while (isET && total < READ_BUDGET);
+    stages_.read += microsSince(begin);
 
     return len;
 }
@@ -73,13 +106,91 @@ ssize_t HttpConn::read(int *saveErrno) {
  */
 int HttpConn::bytesNeedWrite() { return iov_[0].iov_len + iov_[1].iov_len; }
 
+size_t HttpConn::responseBytes() const { return respBytes_; }
+
+std::chrono::steady_clock::time_point HttpConn::responseStart() const { return respStart_; }
+
+void HttpConn::addFaults(long minor, long major) {
+    minorFaults_ += minor;
+    majorFaults_ += major;
+}
+
+long HttpConn::minorFaults() const { return minorFaults_; }
+
+long HttpConn::majorFaults() const { return majorFaults_; }
+
+/**
+ * @description: 读写任务加入线程池前由事件循环调用，任务开始执行时再调用markDequeued统计排队时间
+ */
+void HttpConn::markQueued() { queuedAt_ = std::chrono::steady_clock::now(); }
+
+void HttpConn::markDequeued() { stages_.queue += microsSince(queuedAt_); }
+
+/**
+ * @description: 响应发送完成后开始计量下一个请求
+ */
+void HttpConn::nextRequest() {
+    stages_ = {};
+    reqIndex_++;
+}
+
+/* 追加JSON字符串，转义引号、反斜杠与控制字符 */
+static void appendJsonString(Buffer &buff, const std::string &str) {
+    buff.append("\"", 1);
+    size_t lit = 0;
+    for (size_t i = 0; i < str.size(); i++) {
+        unsigned char ch = str[i];
+        if (ch != '"' && ch != '\\' && ch >= 0x20) {
+            continue;
+        }
+        buff.append(str.data() + lit, i - lit);
+        char esc[8];
+        int  n = ch == '"' || ch == '\\' ? snprintf(esc, sizeof(esc), "\\%c", ch)
+                                           : snprintf(esc, sizeof(esc), "\\u%04x", ch);
+        buff.append(esc, n);
+        lit = i + 1;
+    }
+    buff.append(str.data() + lit, str.size() - lit);
+    buff.append("\"", 1);
+}
+
+/**
+ * @description: 以一行JSON追加本次请求的访问记录，在响应发送完成时调用，write为响应生成到发送完成的时间
+ * @param {Buffer} &buff
+ */
+void HttpConn::appendAccessLog(Buffer &buff) const {
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    char ip[INET_ADDRSTRLEN] = {0};
+    inet_ntop(AF_INET, &addr_.sin_addr, ip, sizeof(ip));
+
+    char head[128];
+    int  n = snprintf(head, sizeof(head), "{\"ts_us\":%lld,\"ip\":\"%s\",\"port\":%d,\"method\":",
+                      static_cast<long long>(tv.tv_sec) * 1000000 + tv.tv_usec, ip,
+                      ntohs(addr_.sin_port));
+    buff.append(head, n);
+    appendJsonString(buff, request_.method());
+    buff.append(",\"path\":", 8);
+    appendJsonString(buff, request_.path());
+
+    char tail[256];
+    n = snprintf(tail, sizeof(tail),
+                 ",\"status\":%d,\"bytes\":%zu,\"req\":%u,\"queue_us\":%ld,\"read_us\":%ld,"
+                 "\"parse_us\":%ld,\"db_us\":%ld,\"build_us\":%ld,\"write_us\":%ld}",
+                 response_.code(), respBytes_, reqIndex_, stages_.queue, stages_.read,
+                 stages_.parse, stages_.db, stages_.build, microsSince(respStart_));
+    buff.append(tail, n);
+}
+
 /**
  * @description: 使用聚集写writev方法将数据发送到指定socket中，并设置可能的错误号
+ *  单次最多发送WRITE_BUDGET字节，大文件分多次事件发送，避免长时间占用工作线程
  * @param {int} *saveErrno
- * @return {*}
+ * @return 最后一次writev的返回值，用完额度但未发完时为正数
  */
 ssize_t HttpConn::write(int *saveErrno) {
-    ssize_t len = -1;
+    ssize_t len   = -1;
+    size_t  total = 0;
     do {
         len = writev(fd_, iov_, iovCnt_);
         if (len <= 0) {
@@ -104,7 +215,8 @@ ssize_t HttpConn::write(int *saveErrno) {
             /*回收对应长度的空间*/
             writeBuff_.hasRead(len);
         }
-    } while (bytesNeedWrite() > 0);
+        total += len;
+    } while (bytesNeedWrite() > 0 && total < WRITE_BUDGET);
 
     return len;
 }
@@ -121,27 +233,131 @@ bool HttpConn::process() {
      * 一个客户端连接可能有多次请求，需要保存上次连接的状态，用以指示是否为新的http请求
      * 只有当上一次的请求为完成状态时，才重新init，以重新开始解析一个http请求 
      */
-    if (request_.state() == HttpRequest::FINISH) request_.init();
+    if (request_.state() == HttpRequest::FINISH) {
+        request_.init();
+        minorFaults_ = majorFaults_ = 0;
+    }
 
     /*使用httprequest类对象解析请求内容，若解析完成，进入回复请求阶段，若失败进入其它分支*/
+    auto                   begin         = std::chrono::steady_clock::now();
     HttpRequest::HTTP_CODE processStatus = request_.parse(readBuff_);
+    stages_.parse += microsSince(begin);
     if (processStatus == HttpRequest::NO_REQUEST) {
         /*请求没有读取完整，应该继续读取请求,返回false让上一层继续读取请求数据*/
         return false;
     } else if (processStatus == HttpRequest::GET_REQUEST) {
         LOG_DEBUG("request path %s", request_.path().c_str());
+        if (request_.needsVerify()) {
+            /*登录注册需要访问数据库，先返回，由调用者转到数据库通道调用processDb，或者异步验证后调用finishDb；
+              期限从这里开始计算，在数据库通道中排队的时间也计算在内*/
+            dbDeadline_ = dbTimeoutMS > 0 ? begin + std::chrono::milliseconds(dbTimeoutMS) : DbDeadline::NONE;
+            return true;
+        }
         /*初始化一个httpresponse对象，负责http应答阶段*/
-        response_.init(srcDir, request_.path(), request_.isKeepAlive(), 200);
+        response_.init(srcDir, request_.path(), request_.isKeepAlive(), 200,
+                       request_.acceptsGzip());
     } else {
         /*其他情况表示解析失败，则返回400错误*/
         response_.init(srcDir, request_.path(), false, 400);
     }
+    buildResponse_();
+    return true;
+}
+
+/**
+ * @description: 解析后仍需访问数据库的请求是否在等待
+ */
+bool HttpConn::needsDb() const { return request_.needsVerify(); }
 
+/**
+ * @description: 在数据库通道中执行用户验证，再生成响应
+ */
+void HttpConn::processDb() {
+    DbDeadline::Scope deadline(dbDeadline_);
+    buildDbResponse_(request_.verify());
+}
+
+/**
+ * @description: 异步验证用户，不阻塞当前线程；验证结束后在数据库线程中调用resume，之后需调用finishDb生成响应
+ * @param {function<void()>} resume
+ */
+void HttpConn::processDbAsync(std::function<void()> resume) {
+    dbStart_ = std::chrono::steady_clock::now();
+    /*期限在提交查询时随查询一起交给数据库线程*/
+    DbDeadline::Scope deadline(dbDeadline_);
+    request_.verifyAsync([this, resume = std::move(resume)](UserAuth::Result result) {
+        dbResult_  = result;
+        dbAsyncUs_ = microsSince(dbStart_);
+        resume();
+    });
+}
+
+/**
+ * @description: 异步验证结束后生成响应
+ */
+void HttpConn::finishDb() {
+    request_.finishVerify(dbResult_, dbAsyncUs_);
+    buildDbResponse_(dbResult_);
+}
+
+/**
+ * @description: 连接交给数据库通道或数据库线程前调用，期间事件循环的超时不关闭连接
+ * @return {uint64_t} 这次交接的序号，交回时传给leaveDb
+ */
+uint64_t HttpConn::enterDb() {
+    dbToken_.store(++dbSeq_);
+    return dbSeq_;
+}
+
+/**
+ * @description: 数据库处理结束、重新注册epoll事件之后调用，只清除自己这次交接
+ */
+void HttpConn::leaveDb(uint64_t token) { dbToken_.compare_exchange_strong(token, 0); }
+
+bool HttpConn::inDb() const { return dbToken_.load() != 0; }
+
+/**
+ * @description: 数据库通道已满，放弃验证，直接返回503并关闭连接
+ */
+void HttpConn::rejectDb() {
+    request_.cancelVerify();
+    buildDbResponse_(UserAuth::ERROR);
+}
+
+/**
+ * @description: 根据验证结果生成响应，数据库出错时返回503、超过期限时返回504，并关闭连接
+ */
+void HttpConn::buildDbResponse_(UserAuth::Result result) {
+    stages_.db = request_.dbMicros();
+    if (result == UserAuth::ERROR) {
+        response_.init(srcDir, request_.path(), false, 503);
+    } else if (result == UserAuth::TIMEOUT) {
+        response_.init(srcDir, request_.path(), false, 504);
+    } else {
+        response_.init(srcDir, request_.path(), request_.isKeepAlive(), 200, request_.acceptsGzip());
+        /*登录注册成功时下发会话Cookie，之后的请求凭它识别用户*/
+        SessionStore::Id session;
+        if (request_.newSession(&session)) {
+            char sid[SessionStore::ID_LEN];
+            session.format(sid);
+            response_.setSession(std::string_view(sid, sizeof(sid)), SessionStore::instance()->ttlSec());
+        }
+    }
+    buildResponse_();
+}
+
+/**
+ * @description: 生成响应头部，设置writev要发送的两块数据
+ */
+void HttpConn::buildResponse_() {
     /*httpresponse负责拼装返回的头部以及需要发送的文件*/
+    auto begin = std::chrono::steady_clock::now();
     response_.makeResponse(writeBuff_);
+    stages_.build += microsSince(begin);
     /*响应头，将写缓冲区赋值给iov_，后面使用writev函数发送至客户端*/
     iov_[0].iov_base = writeBuff_.beginRead();
     iov_[0].iov_len  = writeBuff_.readableBytes();
+    iov_[1]          = {nullptr, 0};
     iovCnt_          = 1;
     /*如果需要返回服务器的文件内容，且文件内容不为空*/
     if (response_.file() && response_.fileLen() > 0) {
@@ -150,7 +366,7 @@ bool HttpConn::process() {
         iov_[1].iov_len  = response_.fileLen();
         iovCnt_          = 2;
     }
+    respBytes_ = bytesNeedWrite();
+    respStart_ = std::chrono::steady_clock::now();
     LOG_DEBUG("filesize: %d, %d to %d", response_.fileLen(), iovCnt_, bytesNeedWrite());
-
-    return true;
 }
@@ -12,8 +12,13 @@
 #include <sys/types.h>
 #include <sys/uio.h>
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+
 #include "../buffer/buffer.h"
 #include "../logsys/log.h"
+#include "../pool/dbdeadline.h"
 #include "../pool/sqlconnRAII.h"
 #include "httprequest.h"
 #include "httpresponse.h"
@@ -25,6 +30,10 @@ public:
     static char *srcDir;  // 资源文件目录
 
     static std::atomic<int> userCount;  // 用户连接个数
+    static int              dbTimeoutMS;  // 登录注册从解析完成起访问数据库的期限，0表示不限
+
+    static const size_t READ_BUDGET  = 64 * 1024;   // 每次事件最多读取的字节数
+    static const size_t WRITE_BUDGET = 256 * 1024;  // 每次事件最多发送的字节数
 
 private:
     int         fd_;       // socket对应的文件描述符
@@ -40,6 +49,34 @@ private:
     HttpRequest  request_;   // 包装的处理http请求的类
     HttpResponse response_;  // 包装的处理http回应的类
 
+    size_t                                respBytes_;  // 本次响应的总字节数
+    std::chrono::steady_clock::time_point respStart_;  // 响应生成的时刻，用于统计发送延迟
+
+    long minorFaults_;  // 本次请求在工作线程中产生的次缺页数
+    long majorFaults_;  // 本次请求在工作线程中产生的主缺页数（需要读盘）
+
+    /* 本次请求各阶段的耗时，单位微秒，写入访问日志 */
+    struct StageTimes {
+        long queue;  // 读写任务在线程池中排队
+        long read;   // 读取socket
+        long parse;  // 解析请求，不含数据库
+        long db;     // 访问数据库
+        long build;  // 生成响应
+    };
+    StageTimes                            stages_;
+    std::chrono::steady_clock::time_point queuedAt_;  // 最近一次任务加入线程池的时刻
+    unsigned                              reqIndex_;  // 当前请求是长连接上的第几个请求
+
+    std::chrono::steady_clock::time_point dbDeadline_;  // 本次请求访问数据库的期限
+    std::chrono::steady_clock::time_point dbStart_;    // 异步验证开始的时刻
+    UserAuth::Result                      dbResult_;   // 异步验证的结果，由数据库线程写入
+    long                                  dbAsyncUs_;  // 异步验证的耗时，由数据库线程写入
+
+    /* 连接交给数据库通道或数据库线程期间为这次交接的序号，0表示没有交出；序号在连接复用时也不清零，
+       迟到的leaveDb不会清掉之后的交接 */
+    std::atomic<uint64_t> dbToken_;
+    uint64_t              dbSeq_;
+
 public:
     HttpConn();
     ~HttpConn();
@@ -58,10 +95,35 @@ public:
     sockaddr_in getAddr() const;
 
     bool process();
+    bool needsDb() const;
+    void processDb();
+    void processDbAsync(std::function<void()> resume);
+    void finishDb();
+    void rejectDb();
+
+    uint64_t enterDb();
+    void     leaveDb(uint64_t token);
+    bool     inDb() const;
 
     int bytesNeedWrite();
 
+    size_t                                responseBytes() const;
+    std::chrono::steady_clock::time_point responseStart() const;
+
+    void addFaults(long minor, long major);
+    long minorFaults() const;
+    long majorFaults() const;
+
+    void markQueued();
+    void markDequeued();
+    void appendAccessLog(Buffer &buff) const;
+    void nextRequest();
+
     bool isKeepAlive() const;
+
+private:
+    void buildResponse_();
+    void buildDbResponse_(UserAuth::Result result);
 };
 
 #endif  //HTTPCONN_H
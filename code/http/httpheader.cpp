@@ -0,0 +1,120 @@
+#include "httpheader.h"
+
+std::atomic<time_t> HttpHeader::dateSec_{0};
+
+/**
+ * @description: 由事件循环每轮调用，只发布当前秒数，格式化由各工作线程在appendDate中按需完成
+ */
+void HttpHeader::updateDate() { dateSec_.store(time(nullptr), std::memory_order_relaxed); }
+
+/**
+ * @description: 返回预渲染的状态行，未知状态码返回空
+ * @param {int} code
+ */
+std::string_view HttpHeader::statusLine(int code) {
+    switch (code) {
+        case 200:
+            return "HTTP/1.1 200 OK\r\n";
+        case 400:
+            return "HTTP/1.1 400 Bad Request\r\n";
+        case 403:
+            return "HTTP/1.1 403 Forbidden\r\n";
+        case 404:
+            return "HTTP/1.1 404 Not Found\r\n";
+        case 503:
+            return "HTTP/1.1 503 Service Unavailable\r\n";
+        case 504:
+            return "HTTP/1.1 504 Gateway Timeout\r\n";
+        default:
+            return {};
+    }
+}
+
+/**
+ * @description: 追加状态行，状态码必须是statusLine能识别的
+ */
+void HttpHeader::appendStatusLine(Buffer &buff, int code) {
+    std::string_view line = statusLine(code);
+    assert(!line.empty());
+    buff.append(line);
+}
+
+/**
+ * @description: 追加Date头部，缓冲属于当前线程，事件循环发布的秒数变化时才重新格式化，每个线程每秒至多一次
+ *              事件循环尚未发布过秒数时使用当前时间
+ */
+void HttpHeader::appendDate(Buffer &buff) {
+    thread_local time_t sec = 0;
+    thread_local char   buf[DATE_LEN + 1];
+
+    time_t now = dateSec_.load(std::memory_order_relaxed);
+    if (now == 0) {
+        now = time(nullptr);
+    }
+    if (now != sec) {
+        tm gmt;
+        gmtime_r(&now, &gmt);
+        strftime(buf, sizeof(buf), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &gmt);
+        sec = now;
+    }
+    buff.append(buf, DATE_LEN);
+}
+
+/**
+ * @description: 使用to_chars格式化Content-length头部，不产生堆内存分配
+ */
+void HttpHeader::appendContentLength(Buffer &buff, std::size_t len) {
+    static constexpr std::string_view KEY = "Content-length: ";
+
+    char buf[KEY.size() + 24];
+    memcpy(buf, KEY.data(), KEY.size());
+    char *end = std::to_chars(buf + KEY.size(), buf + sizeof(buf) - 2, len).ptr;
+    *end++    = '\r';
+    *end++    = '\n';
+    buff.append(buf, end - buf);
+}
+
+/**
+ * @description: 追加ETag头部，格式为带引号的16位十六进制数；gzip编码的内容加上"-gz"后缀，
+ *              同一资源的两种编码字节不同，强校验器不能相同
+ */
+void HttpHeader::appendETag(Buffer &buff, uint64_t etag, bool gzip) {
+    static constexpr std::string_view KEY  = "ETag: \"";
+    static constexpr std::string_view GZIP = "-gz";
+
+    char buf[KEY.size() + GZIP.size() + 20] = {0};
+    memcpy(buf, KEY.data(), KEY.size());
+    char *begin = buf + KEY.size();
+    char *end   = std::to_chars(begin, begin + 16, etag, 16).ptr;
+    /*左侧补0到16位*/
+    size_t width = end - begin;
+    memmove(begin + 16 - width, begin, width);
+    memset(begin, '0', 16 - width);
+    end = begin + 16;
+    if (gzip) {
+        memcpy(end, GZIP.data(), GZIP.size());
+        end += GZIP.size();
+    }
+    *end++ = '"';
+    *end++ = '\r';
+    *end++ = '\n';
+    buff.append(buf, end - buf);
+}
+
+/**
+ * @description: 追加Set-Cookie头部，只允许HTTP访问，不产生堆内存分配
+ * @param {int} maxAgeSec Cookie的有效秒数，与服务端会话的有效期一致
+ */
+void HttpHeader::appendSetCookie(Buffer &buff, std::string_view name, std::string_view value, int maxAgeSec) {
+    static constexpr std::string_view KEY  = "Set-Cookie: ";
+    static constexpr std::string_view ATTR = "; Path=/; HttpOnly; SameSite=Lax\r\n";
+
+    char buf[16];
+    buff.append(KEY);
+    buff.append(name);
+    buff.append("=");
+    buff.append(value);
+    buff.append("; Max-Age=");
+    buff.append(buf, std::to_chars(buf, buf + sizeof(buf), maxAgeSec).ptr - buf);
+    buff.append(ATTR);
+}
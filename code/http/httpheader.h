@@ -0,0 +1,41 @@
+/*
+ * @Description  : HTTP响应头写入工具，预渲染状态行与常用头部片段，直接追加到缓冲区
+ * @Date         : 2026-10-18 10:12:40
+ * @LastEditTime : 2026-10-19 05:31:02
+ */
+#ifndef HTTPHEADER_H
+#define HTTPHEADER_H
+
+#include <time.h>
+
+#include <atomic>
+#include <charconv>
+#include <string_view>
+
+#include "../buffer/buffer.h"
+
+class HttpHeader {
+public:
+    static constexpr std::string_view SERVER = "Server: LightWebServer\r\n";
+    static constexpr std::string_view CRLF   = "\r\n";
+
+private:
+    /* "Date: Sun, 18 Oct 2026 10:12:40 GMT\r\n" 的固定长度 */
+    static constexpr std::size_t DATE_LEN = 37;
+
+    /* 事件循环只发布当前秒数，每个工作线程在秒数变化时格式化到自己的缓冲，没有跨线程共享的字符缓冲，读取不会撕裂 */
+    static std::atomic<time_t> dateSec_;
+
+public:
+    static void updateDate();
+
+    static std::string_view statusLine(int code);
+
+    static void appendStatusLine(Buffer &buff, int code);
+    static void appendDate(Buffer &buff);
+    static void appendContentLength(Buffer &buff, std::size_t len);
+    static void appendETag(Buffer &buff, uint64_t etag, bool gzip = false);
+    static void appendSetCookie(Buffer &buff, std::string_view name, std::string_view value, int maxAgeSec);
+};
+
+#endif  //HTTPHEADER_H
@@ -14,6 +14,9 @@ HttpRequest::HttpRequest() { init(); }
  */
 void HttpRequest::init() {
     method_ = path_ = version_ = body_ = "";
+    dbMicros_                          = 0;
+    verify_                            = NO_VERIFY;
+    newSession_                        = false;
 
     /*状态重置到解析请求行状态*/
     state_ = REQUEST_LINE;
@@ -28,6 +31,10 @@ std::string HttpRequest::path() const { return path_; }
 
 std::string HttpRequest::method() const { return method_; }
 
+long HttpRequest::dbMicros() const { return dbMicros_; }
+
+bool HttpRequest::needsVerify() const { return verify_ != NO_VERIFY; }
+
 std::string HttpRequest::version() const { return version_; }
 
 bool HttpRequest::isKeepAlive() const {
@@ -37,6 +44,65 @@ bool HttpRequest::isKeepAlive() const {
     return false;
 }
 
+/**
+ * @description: 请求头Accept-Encoding中是否包含gzip
+ */
+bool HttpRequest::acceptsGzip() const {
+    auto it = header_.find("Accept-Encoding");
+    return it != header_.end() && it->second.find("gzip") != std::string::npos;
+}
+
+/**
+ * @description: 取出Cookie头部中name对应的值，返回的视图指向请求头的存储，不产生拷贝
+ *              - Cookie头部示例：Cookie: theme=dark; sid=0123456789abcdef0123456789abcdef
+ * @param {string_view} name
+ * @return {string_view} 没有这个Cookie时为空
+ */
+std::string_view HttpRequest::cookie(std::string_view name) const {
+    auto it = header_.find("Cookie");
+    if (it == header_.end()) {
+        return {};
+    }
+    std::string_view rest = it->second;
+    while (!rest.empty()) {
+        size_t           semi = rest.find(';');
+        std::string_view pair = rest.substr(0, semi);
+        rest                  = semi == std::string_view::npos ? std::string_view() : rest.substr(semi + 1);
+
+        size_t begin = pair.find_first_not_of(' ');
+        size_t eq    = pair.find('=');
+        if (begin == std::string_view::npos || eq == std::string_view::npos || eq < begin) {
+            continue;
+        }
+        if (pair.substr(begin, eq - begin) == name) {
+            std::string_view value = pair.substr(eq + 1);
+            size_t           end   = value.find_last_not_of(' ');
+            return end == std::string_view::npos ? std::string_view() : value.substr(0, end + 1);
+        }
+    }
+    return {};
+}
+
+/**
+ * @description: 根据Cookie中的会话id查出已登录的用户名，只查内存中的会话表，不访问数据库
+ * @return {bool} 会话有效时返回true并写入user
+ */
+bool HttpRequest::sessionUser(std::string *user) const {
+    SessionStore::Id id;
+    return SessionStore::instance()->isOpen() && id.parse(cookie(SessionStore::COOKIE_NAME)) &&
+           SessionStore::instance()->lookup(id, user);
+}
+
+/**
+ * @description: 本次请求验证成功后新建的会话，由调用者写入响应的Set-Cookie
+ */
+bool HttpRequest::newSession(SessionStore::Id *id) const {
+    if (newSession_) {
+        *id = session_;
+    }
+    return newSession_;
+}
+
 /**
  * @description: 将16进制数转为十进制数
  * @param {char} ch
@@ -65,10 +131,39 @@ std::string HttpRequest::getPost(const std::string &key) const {
     return "";
 }
 
+/**
+ * @description: 规范化路径：合并连续的'/'，去掉"."，".."回退一级且不会越过根目录，
+ *              "/./welcome.html"、"//welcome.html"等写法与"/welcome.html"得到同一个路径，按路径做的检查不会被绕过
+ */
+void HttpRequest::normalizePath_() {
+    std::string path;
+    size_t      pos = 0;
+    while (pos < path_.size()) {
+        size_t end = path_.find('/', pos);
+        if (end == std::string::npos) {
+            end = path_.size();
+        }
+        std::string_view seg(path_.data() + pos, end - pos);
+        if (seg == "..") {
+            path.resize(path.empty() ? 0 : path.rfind('/'));
+        } else if (!seg.empty() && seg != ".") {
+            path += '/';
+            path.append(seg);
+        }
+        pos = end + 1;
+    }
+    /*保留目录结尾的'/'*/
+    if (path.empty() || path_.back() == '/') {
+        path += '/';
+    }
+    path_ = std::move(path);
+}
+
 /**
  * @description: 将客户端传来的path变量添加完整，以目录结束的路径添加上默认页面
  */
 void HttpRequest::parsePath_() {
+    normalizePath_();
     if (path_ == "/") {  // 浏览器加上 /index.html 时会被自动转化为 /
         path_ = "/index.html";
     } else {
@@ -145,11 +240,29 @@ bool HttpRequest::parseBody_(const std::string &line) {
     }
     /*将状态置为FINISH，指示解析完成*/
     state_ = FINISH;
+    requireSession_();
 
     LOG_DEBUG("Body: %s, len: %d", line.c_str(), line.size());
     return true;
 }
 
+/**
+ * @description: 登录后才能访问的页面，没有有效会话时改为返回登录页；请求头解析完后才有Cookie，会话关闭时不检查
+ *              对所有方法都检查，路径已经规范化；登录本身(POST登录页)总是校验密码，会话只用来放行之后的页面请求
+ */
+void HttpRequest::requireSession_() {
+    if (path_ != "/welcome.html" || !SessionStore::instance()->isOpen()) {
+        return;
+    }
+    std::string user;
+    if (!sessionUser(&user)) {
+        LOG_DEBUG("No session for %s", path_.c_str());
+        path_ = "/login.html";
+        return;
+    }
+    LOG_DEBUG("Session user: %s", user.c_str());
+}
+
 /**
  * @description:  按行解析请求体
  *              - 目前只能解析application/x-www-form-urlencoded此种格式，表示以键值对的数据格式提交
@@ -172,15 +285,9 @@ bool HttpRequest::parsePost_() {
             int tag = DEFAULT_HTML_TAG.find(path_)->second;
             LOG_DEBUG("Tag:%d", tag);
             if (tag == 0 || tag == 1) {
-                /*通过标识确定用户请求的是登录还是注册*/
-                bool isLogin = (tag == 1);
-                if (userVerify(post_["username"], post_["password"], isLogin)) {
-                    /*验证成功，进入下一步，设置为成功页面*/
-                    path_ = "/welcome.html";
-                } else {
-                    /*验证失败，设置返回错误页面*/
-                    path_ = "/error.html";
-                }
+                /*通过标识确定用户请求的是登录还是注册，这里只做标记，访问数据库由verify完成，
+                调用者可以把它放到专门的数据库通道中执行，不占用处理静态资源的线程*/
+                verify_ = (tag == 1) ? LOGIN : REGISTER;
             }
         }
     }
@@ -241,86 +348,52 @@ void HttpRequest::parseFromUrlencoded_() {
 }
 
 /**
- * @description: 根据注册或登录验证用户
- * @param {string} &name
- * @param {string} &pwd
- * @param {bool} isLogin
- * @return {bool}
+ * @description: 执行解析时标记的登录或注册验证，会同步访问数据库
  */
-bool HttpRequest::userVerify(const std::string &name, const std::string &pwd, bool isLogin) {
-    /*密码或用户名为空，直接错误*/
-    if (name == "" || pwd == "") {
-        return false;
+UserAuth::Result HttpRequest::verify() {
+    if (verify_ == NO_VERIFY) {
+        return UserAuth::OK;
     }
-    LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
-
-    /*获取一个sql连接*/
-    MYSQL      *sql;
-    SqlConnRAII sqlConnRaii(&sql, SqlConnPool::instance());
-    assert(sql);
-
-    /*初始化一系列数据库连接相关变量*/
-    bool       flag       = false;
-    char       order[256] = {0};
-    MYSQL_RES *res        = nullptr;
+    auto             begin  = std::chrono::steady_clock::now();
+    UserAuth::Result result = UserAuth::instance()->verify(post_["username"], post_["password"], verify_ == LOGIN);
+    finishVerify(result, std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count());
+    return result;
+}
 
-    /*如果是注册，那么将flag置为true*/
-    if (!isLogin) {
-        flag = true;
-    }
+/**
+ * @description: 异步执行解析时标记的验证，结果通过cb返回，之后需调用finishVerify
+ * @param {Callback} cb 通常在数据库线程中执行
+ */
+void HttpRequest::verifyAsync(UserAuth::Callback cb) {
+    assert(verify_ != NO_VERIFY);
+    UserAuth::instance()->verifyAsync(post_["username"], post_["password"], verify_ == LOGIN, std::move(cb));
+}
 
-    /* 查询用户及密码的语句 */
-    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1",
-             name.c_str());
-    LOG_DEBUG("%s", order);
-
-    /* mysql_query执行由“Null终结的字符串”查询指向的SQL查询，查询成功，返回0。如果出现错误，返回非0值 */
-    if (mysql_query(sql, order)) return false;
-
-    /* mysql_store_result()将查询的全部结果读取到客户端，分配1个MYSQL_RES结构，并将结果置于该结构中。
-    如果查询未返回结果集，mysql_store_result()将返回Null指针（例如，如果查询是INSERT语句）。
-    如果读取结果集失败，mysql_store_result()还会返回Null指针 */
-    res = mysql_store_result(sql);
-
-    /*从结果集中获取下一行*/
-    while (MYSQL_ROW row = mysql_fetch_row(res)) {
-        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-        std::string password(row[1]);
-        /*登录验证*/
-        if (isLogin) {
-            if (pwd == password) {
-                flag = true;
-            } else {
-                flag = false;
-                LOG_DEBUG("pwd error!");
-            }
-        } else {
-            flag = false;
-            LOG_DEBUG("user used!");
-        }
-    }
-    /* 完成对结果集的操作后，必须调用mysql_free_result()释放结果集使用的内存。释放完成后，不要尝试访问结果集。 */
-    mysql_free_result(res);
-
-    /* 注册行为 且 用户名未被使用*/
-    if (!isLogin && flag) {
-        LOG_DEBUG("regirster!");
-        bzero(order, 256);
-        snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(),
-                 pwd.c_str());
-        LOG_DEBUG("%s", order);
-        /*插入数据库，用户注册成功*/
-        if (mysql_query(sql, order)) {
-            LOG_DEBUG("Insert error!");
-            flag = false;
-        }
-        flag = true;
+/**
+ * @description: 记录验证结果，根据结果设置要返回的页面；数据库出错时不改变路径，由调用者返回错误
+ * @param {Result} result
+ * @param {long} micros 访问数据库的耗时
+ */
+void HttpRequest::finishVerify(UserAuth::Result result, long micros) {
+    verify_ = NO_VERIFY;
+    dbMicros_ += micros;
+    if (result == UserAuth::OK) {
+        /*验证成功，进入下一步，设置为成功页面，并为用户新建会话*/
+        path_       = "/welcome.html";
+        newSession_ = SessionStore::instance()->create(post_["username"], &session_);
+    } else if (result == UserAuth::FAIL) {
+        /*验证失败，设置返回错误页面*/
+        path_ = "/error.html";
     }
-
-    LOG_DEBUG("UserVerify success!!");
-    return flag;
 }
 
+/**
+ * @description: 放弃解析时标记的验证，例如数据库通道已满时
+ */
+void HttpRequest::cancelVerify() { verify_ = NO_VERIFY; }
+
 /**
  * @description: 有限状态机、解析读缓冲区的http请求内容
  * @param {Buffer} &buff
@@ -358,6 +431,7 @@ HttpRequest::HTTP_CODE HttpRequest::parse(Buffer &buff) {
                 if (state_ == BODY && method_ == "GET") {
                     state_ = FINISH;
                     buff.clearAll();
+                    requireSession_();
                     return GET_REQUEST;
                 }
                 break;
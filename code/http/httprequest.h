@@ -1,7 +1,7 @@
 /*
  * @Description  : HTTP请求的解析类
  * @Date         : 2022-07-16 01:14:05
- * @LastEditTime : 2022-07-18 00:01:12
+ * @LastEditTime : 2026-10-19 05:40:16
  */
 #ifndef HTTPREQUEST_H
 #define HTTPREQUEST_H
@@ -9,14 +9,17 @@
 #include <errno.h>
 #include <mysql/mysql.h>
 
+#include <chrono>
 #include <regex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 
+#include "../auth/sessionstore.h"
+#include "../auth/userauth.h"
 #include "../buffer/buffer.h"
 #include "../logsys/log.h"
-#include "../pool/sqlconnRAII.h"
 
 class HttpRequest {
 public:
@@ -35,9 +38,17 @@ public:
         CLOSED_CONNECTION
     };
 
+    /*请求体解析完成后待执行的用户验证*/
+    enum VERIFY { NO_VERIFY, LOGIN, REGISTER };
+
 private:
     PARSE_STATE state_;                           // 状态机状态
     std::string method_, path_, version_, body_;  // 请求头中的信息
+    long        dbMicros_;                        // 本次请求访问数据库的耗时
+    VERIFY      verify_;                          // 待执行的验证，需要访问数据库
+
+    SessionStore::Id session_;     // 验证成功后新建的会话
+    bool             newSession_;  // 本次请求是否新建了会话，需要下发Cookie
 
     /* 以键值对的方式保存请求头、请求体中的信息 */
     std::unordered_map<std::string, std::string> header_;
@@ -62,16 +73,28 @@ public:
     std::string getPost(const std::string &key) const;
 
     bool isKeepAlive() const;
+    bool acceptsGzip() const;
+    long dbMicros() const;
+
+    std::string_view cookie(std::string_view name) const;
+    bool             sessionUser(std::string *user) const;
+    bool             newSession(SessionStore::Id *id) const;
+
+    bool             needsVerify() const;
+    UserAuth::Result verify();
+    void             verifyAsync(UserAuth::Callback cb);
+    void             finishVerify(UserAuth::Result result, long micros);
+    void             cancelVerify();
 
 private:
     static int convertHex(char ch);
 
-    static bool userVerify(const std::string &name, const std::string &pwd, bool isLogin);
-
     bool parseRequestLine_(const std::string &line);
     void parseHeader_(const std::string &line);
     bool parseBody_(const std::string &line);
+    void normalizePath_();
     void parsePath_();
+    void requireSession_();
     bool parsePost_();
     void parseFromUrlencoded_();
 };
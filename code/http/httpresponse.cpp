@@ -1,6 +1,6 @@
 #include "httpresponse.h"
 
-const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE = {
+const std::unordered_map<std::string_view, std::string_view> HttpResponse::SUFFIX_TYPE = {
     {".html", "text/html"},
     {".xml", "text/xml"},
     {".xhtml", "application/xhtml+xml"},
@@ -27,41 +27,48 @@ const std::unordered_map<int, std::string> HttpResponse::CODE_STATUS = {
     {400, "Bad Request"},
     {403, "Forbidden"},
     {404, "Not Found"},
+    {503, "Service Unavailable"},
+    {504, "Gateway Timeout"},
 };
 
 const std::unordered_map<int, std::string> HttpResponse::CODE_PATH = {
     {400, "/400.html"},
     {403, "/403.html"},
     {404, "/404.html"},
+    {503, "/503.html"},
+    {504, "/504.html"},
 };
 
 HttpResponse::HttpResponse()
-    : code_(-1), isKeepAlive_(false), path_(""), srcDir_(""), mmFile_(nullptr) {
+    : code_(-1),
+      isKeepAlive_(false),
+      path_(""),
+      srcDir_(""),
+      mmFile_(nullptr),
+      acceptGzip_(false),
+      fromPack_(false),
+      sessionMaxAge_(0) {
     mmFileStat_ = {0};
 }
 
 HttpResponse::~HttpResponse() { unmapFile(); }
 
 /**
- * @description: 解除内存映射，由析构函数调用
+ * @description: 释放持有的缓存项，映射由缓存项负责解除，由析构函数调用
  */
 void HttpResponse::unmapFile() {
-    if (mmFile_) {
-        munmap(mmFile_, mmFileStat_.st_size);
-        mmFile_ = nullptr;
-    }
+    entry_.reset();
+    mmFile_ = nullptr;
 }
 
 /**
  * @description: 初始化httpResponse类对象
  */
 void HttpResponse::init(const std::string &srcDir, const std::string &path, bool isKeepAlive,
-                        int code) {
+                        int code, bool acceptGzip) {
     assert(srcDir != "");
-    /*如果mmFile_不为空，那么先取消对应的映射*/
-    if (mmFile_) {
-        unmapFile();
-    }
+    /*释放上一次请求持有的缓存项*/
+    unmapFile();
     code_        = code;
     isKeepAlive_ = isKeepAlive;
     path_        = path;
@@ -69,6 +76,20 @@ void HttpResponse::init(const std::string &srcDir, const std::string &path, bool
 
     mmFile_     = nullptr;
     mmFileStat_ = {0};
+    acceptGzip_ = acceptGzip;
+    fromPack_   = false;
+
+    sessionMaxAge_ = 0;
+}
+
+/**
+ * @description: 在响应头中下发会话Cookie，需在init之后调用
+ * @param {string_view} sid 已格式化的会话id，由调用者格式化，响应模块不依赖会话表的实现
+ */
+void HttpResponse::setSession(std::string_view sid, int maxAgeSec) {
+    assert(sid.size() == SessionStore::ID_LEN);
+    memcpy(sessionId_, sid.data(), SessionStore::ID_LEN);
+    sessionMaxAge_ = maxAgeSec;
 }
 
 /**
@@ -76,6 +97,11 @@ void HttpResponse::init(const std::string &srcDir, const std::string &path, bool
  */
 int HttpResponse::code() const { return code_; }
 
+/**
+ * @description: 响应头中是否声明了保持长连接，503、504等错误响应为false
+ */
+bool HttpResponse::isKeepAlive() const { return isKeepAlive_; }
+
 /**
  * @description: 返回请求的资源文件的映射到内存中的地址
  */
@@ -87,33 +113,44 @@ char *HttpResponse::file() const { return mmFile_; }
 size_t HttpResponse::fileLen() const { return mmFileStat_.st_size; }
 
 /**
- * @description: 获取返回文件类型
+ * @description: 根据后缀名获取文件类型，返回的是静态表中的视图，不产生拷贝
+ * @param {string_view} path
  */
-std::string HttpResponse::getFileType_() {
+std::string_view HttpResponse::fileType(std::string_view path) {
     /*根据后缀名，判断文件类型*/
-    std::string::size_type idx = path_.find_last_of('.');
-    if (idx == std::string::npos) {  // 没找到
+    std::string_view::size_type idx = path.find_last_of('.');
+    if (idx == std::string_view::npos) {  // 没找到
         /*没有后缀名，那就设置文件类型为 text/plain*/
         return "text/plain";
     }
-    /*分割得到后缀名*/
-    std::string suffix = path_.substr(idx);
     /*根据后缀名拿到SUFFIX_TYPE中的对应值*/
-    if (SUFFIX_TYPE.count(suffix) == 1) {
-        return SUFFIX_TYPE.find(suffix)->second;
+    auto it = SUFFIX_TYPE.find(path.substr(idx));
+    if (it != SUFFIX_TYPE.end()) {
+        return it->second;
     }
     /*不符合上面条件就返回text/plain*/
     return "text/plain";
 }
 
+/**
+ * @description: 获取返回文件类型，来自资源包时直接使用包中记录的类型
+ */
+std::string_view HttpResponse::getFileType_() const {
+    return fromPack_ ? packFile_.mime : fileType(path_);
+}
+
 /**
  * @description: 映射错误码为400，403，404的页面文件，将文件信息存入mmFileStat_变量中
  */
 void HttpResponse::errorHtml_() {
     /*若返回码为400，403，404其中之一，则将对应的文件路径与信息读取出来，并将文件信息保存mmFileStat_*/
     if (CODE_PATH.count(code_) == 1) {
-        path_ = CODE_PATH.find(code_)->second;
-        stat((srcDir_ + path_).data(), &mmFileStat_);
+        path_       = CODE_PATH.find(code_)->second;
+        entry_      = FileCache::instance()->get(path_);
+        mmFileStat_ = {0};
+        if (entry_) {
+            mmFileStat_ = entry_->st;
+        }
     }
 }
 
@@ -137,46 +174,48 @@ void HttpResponse::errorContent(Buffer &buff, std::string message) {
     body += "<hr><em>TinyWebServer</em></body></html>";
 
     /*这里多一个 \r\n 表示返回头后的必须的空行*/
-    buff.append("Content-length: " + std::to_string(body.size()) + "\r\n\r\n");
+    HttpHeader::appendContentLength(buff, body.size());
+    buff.append(HttpHeader::CRLF);
     buff.append(body);
 }
 
 /**
  * @description: 将返回信息中的 状态行 添加到写缓冲区中
  *              - 状态行示例：HTTP/1.1 200 OK
- *              - CODE_STATUS中含有200，400，403，404这四个状态
+ *              - 状态行都是HttpHeader中预渲染好的片段，直接追加，不拼接字符串
  * @param {Buffer} &buff
  */
 void HttpResponse::addStateLine_(Buffer &buff) {
-    std::string status;
-    if (CODE_STATUS.count(code_) == 1) {
-        /*根据状态码获取对应的字符串，将其赋值给status变量*/
-        status = CODE_STATUS.find(code_)->second;
-    } else {
-        /*其余CODE_STATUS中不存在的状态码统一以400作为状态码，表示请求报文存在语法错误*/
+    if (HttpHeader::statusLine(code_).empty()) {
+        /*其余不认识的状态码统一以400作为状态码，表示请求报文存在语法错误*/
         code_ = 400;
-        /*根据状态码获取对应的字符串，将其赋值给status变量*/
-        status = CODE_STATUS.find(400)->second;
     }
-    /*拼接字符串获取状态行，并将信息加入到写缓冲区中*/
-    buff.append("HTTP/1.1 " + std::to_string(code_) + " " + status + "\r\n");
+    HttpHeader::appendStatusLine(buff, code_);
 }
 
 /**
- * @description: 将返回信息中的 消息报头 添加到写缓冲区中
+ * @description: 将返回信息中的 消息报头 添加到写缓冲区中，整个过程没有堆内存分配
  * @param {Buffer} &buff
  */
 void HttpResponse::addHeader_(Buffer &buff) {
+    /*Date使用事件循环每秒刷新一次的缓存字符串*/
+    HttpHeader::appendDate(buff);
+    buff.append(HttpHeader::SERVER);
     /*组装信息，将信息送入写缓冲区中*/
-    buff.append("Connection: ");
     if (isKeepAlive_) {
-        buff.append("keep-alive\r\n");
-        buff.append("keep-alive: max=6, timeout=120\r\n");
+        buff.append("Connection: keep-alive\r\n"
+                    "keep-alive: max=6, timeout=120\r\n");
     } else {
-        buff.append("close\r\n");
+        buff.append("Connection: close\r\n");
+    }
+    if (sessionMaxAge_ > 0) {
+        HttpHeader::appendSetCookie(buff, SessionStore::COOKIE_NAME,
+                                    std::string_view(sessionId_, SessionStore::ID_LEN), sessionMaxAge_);
     }
     /*继续组装信息，将信息输送写缓冲区中*/
-    buff.append("Content-type: " + getFileType_() + "\r\n");
+    buff.append("Content-type: ");
+    buff.append(getFileType_());
+    buff.append(HttpHeader::CRLF);
 }
 
 /**
@@ -184,29 +223,46 @@ void HttpResponse::addHeader_(Buffer &buff) {
  * @param {Buffer} &buff
  */
 void HttpResponse::addContent_(Buffer &buff) {
-    /*根据文件名以只读方式打开文件*/
-    int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
-    if (srcFd < 0) {
-        /*若打开文件失败，向客户端发送指定错误信息的html页面*/
+    /*文件内容已由静态资源缓存映射到内存中，这里直接引用*/
+    if (!entry_ || (!entry_->data && mmFileStat_.st_size > 0)) {
+        /*若文件不存在或映射失败，向客户端发送指定错误信息的html页面*/
         errorContent(buff, "File NotFound!");
         return;
     }
 
-    LOG_DEBUG("file path %s", (srcDir_ + path_).c_str());
-    /* 将文件映射到内存提高文件的访问速度，MAP_PRIVATE 建立一个写入时拷贝的私有映射,MAP_PRIVATE被该进程私有，不会共享*/
-    int *mmRet = (int *)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if (*mmRet == -1) {
-        /*若映射文件失败，向客户端发送指定错误信息的html页面*/
-        errorContent(buff, "File NotFound!");
-        return;
-    }
+    LOG_DEBUG("file path %s", path_.c_str());
     /*将映射的地址赋值给mmFile_变量*/
-    mmFile_ = (char *)mmRet;
-    /*映射成功后就可以关闭文件描述符了*/
-    close(srcFd);
+    mmFile_ = entry_->data;
+
+    /*继续向返回头添加信息并加入发送缓存中，返回内容的长度信息，再加一组 \r\n 表示请求头后的空行*/
+    HttpHeader::appendContentLength(buff, mmFileStat_.st_size);
+    buff.append(HttpHeader::CRLF);
+}
 
-    /*继续向返回头添加信息并加入发送缓存中，返回内容的长度信息，这里有两组 \r\n 后面表示请求头后的空行*/
-    buff.append("Content-length: " + std::to_string(mmFileStat_.st_size) + "\r\n\r\n");
+/**
+ * @description: 资源包中的文件：按客户端能力选择原始或gzip预压缩内容，并附带ETag
+ * @param {Buffer} &buff
+ */
+void HttpResponse::addPackContent_(Buffer &buff) {
+    const char *data = packFile_.data;
+    size_t      len  = packFile_.len;
+    bool        gzip = false;
+    if (packFile_.gzLen) {
+        buff.append("Vary: Accept-Encoding\r\n");
+        if (acceptGzip_) {
+            buff.append("Content-Encoding: gzip\r\n");
+            data = packFile_.gzData;
+            len  = packFile_.gzLen;
+            gzip = true;
+        }
+    }
+    HttpHeader::appendETag(buff, packFile_.etag, gzip);
+    HttpHeader::appendContentLength(buff, len);
+    buff.append(HttpHeader::CRLF);
+
+    /*资源包是只读映射，发送时不会写入*/
+    mmFile_             = const_cast<char *>(data);
+    mmFileStat_.st_size = len;
 }
 
 /**
@@ -215,10 +271,22 @@ void HttpResponse::addContent_(Buffer &buff) {
  * @return {*}
  */
 void HttpResponse::makeResponse(Buffer &buff) {
-    /*判断请求的资源文件*/
-    if (stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
-        /*stat用来将参数file_name所指的文件状态, 复制到参数mmFileStat_所指的结构中。
-        若执行失败，即返回值为-1 或 路径为目录则设置状态码code_为404*/
+    /*优先在资源包中查找，命中时整个过程没有系统调用*/
+    if ((code_ == 200 || code_ == -1) && RespPack::instance()->lookup(path_, packFile_)) {
+        code_     = 200;
+        fromPack_ = true;
+        addStateLine_(buff);
+        addHeader_(buff);
+        addPackContent_(buff);
+        return;
+    }
+    /*从静态资源缓存中查找请求的资源文件，缓存由inotify保证与文件系统一致*/
+    entry_ = FileCache::instance()->get(path_);
+    if (entry_) {
+        mmFileStat_ = entry_->st;
+    }
+    if (!entry_ || S_ISDIR(mmFileStat_.st_mode)) {
+        /*文件不存在或路径为目录则设置状态码code_为404*/
         code_ = 404;
     } else if (!(mmFileStat_.st_mode & S_IROTH)) {
         /*如果没有读取权限则置状态码code_为403*/
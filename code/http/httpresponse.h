@@ -1,7 +1,7 @@
 /*
  * @Description  : HTTP应答类
  * @Date         : 2022-07-16 01:14:05
- * @LastEditTime : 2022-07-18 00:01:18
+ * @LastEditTime : 2026-10-19 05:33:27
  */
 #ifndef HTTPRESPONSE_H
 #define HTTPRESPONSE_H
@@ -11,10 +11,15 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <string_view>
 #include <unordered_map>
 
+#include "../auth/sessionstore.h"
 #include "../buffer/buffer.h"
+#include "../cache/filecache.h"
+#include "../cache/respack.h"
 #include "../logsys/log.h"
+#include "httpheader.h"
 
 class HttpResponse {
 private:
@@ -24,10 +29,18 @@ private:
     std::string path_;    // 文件路径
     std::string srcDir_;  // 项目根目录
 
-    char       *mmFile_;      // 发送文件
-    struct stat mmFileStat_;  // 发送文件的信息
+    FileEntryPtr entry_;       // 持有的缓存项，保证发送期间映射有效
+    char        *mmFile_;      // 发送文件
+    struct stat  mmFileStat_;  // 发送文件的信息
 
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;  // 返回类型键值对
+    bool     acceptGzip_;  // 客户端是否接受gzip编码
+    bool     fromPack_;    // 本次响应的内容是否来自资源包
+    PackFile packFile_;    // 资源包中的文件
+
+    char sessionId_[SessionStore::ID_LEN];  // 本次响应下发的会话id
+    int  sessionMaxAge_;                    // 会话Cookie的有效秒数，0表示不下发
+
+    static const std::unordered_map<std::string_view, std::string_view> SUFFIX_TYPE;  // 返回类型键值对
 
     static const std::unordered_map<int, std::string> CODE_STATUS;  // 状态码键值对
     static const std::unordered_map<int, std::string> CODE_PATH;  // 错误码与页面对应关系
@@ -37,25 +50,31 @@ public:
     ~HttpResponse();
 
     void init(const std::string &srcDir, const std::string &path, bool isKeepAlive = false,
-              int code = -1);
+              int code = -1, bool acceptGzip = false);
+
+    void setSession(std::string_view sid, int maxAgeSec);
 
     void makeResponse(Buffer &buff);
 
     void unmapFile();
 
     int    code() const;
+    bool   isKeepAlive() const;
     char  *file() const;
     size_t fileLen() const;
 
+    static std::string_view fileType(std::string_view path);
+
 private:
     void addStateLine_(Buffer &buff);
     void addHeader_(Buffer &buff);
     void addContent_(Buffer &buff);
+    void addPackContent_(Buffer &buff);
 
     void errorHtml_();
     void errorContent(Buffer &buff, std::string message);
 
-    std::string getFileType_();
+    std::string_view getFileType_() const;
 };
 
 #endif  //HTTPRESPONSE_H
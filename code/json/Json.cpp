@@ -40,7 +40,7 @@ Json::Json(const Json& rhs) {
     }
 }
 
-Json::Json(Json&& rhs) : valuePtr_(std::move(rhs.valuePtr_)) { rhs.valuePtr_ = nullptr; }
+Json::Json(Json&& rhs) noexcept : valuePtr_(std::move(rhs.valuePtr_)) { rhs.valuePtr_ = nullptr; }
 
 Json& Json::operator=(Json rhs) {
     Json temp(rhs);
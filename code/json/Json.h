@@ -46,6 +46,9 @@ public:
     explicit Json(const std::string& val) : valuePtr_(std::make_unique<type>(val)) {}
     explicit Json(const jsonArray& val) : valuePtr_(std::make_unique<type>(val)) {}
     explicit Json(const jsonObject& val) : valuePtr_(std::make_unique<type>(val)) {}
+    explicit Json(std::string&& val) : valuePtr_(std::make_unique<type>(std::move(val))) {}
+    explicit Json(jsonArray&& val) : valuePtr_(std::make_unique<type>(std::move(val))) {}
+    explicit Json(jsonObject&& val) : valuePtr_(std::make_unique<type>(std::move(val))) {}
     /* 委托构造函数 */
     explicit Json() : Json(nullptr) {}
     explicit Json(int val) : Json(1.0 * val) {}
@@ -53,8 +56,8 @@ public:
 
     /* 拷贝构造函数 */
     Json(const Json&);
-    /* 移动构造函数 */
-    Json(Json&&);
+    /* 移动构造函数，不抛异常，jsonArray扩容时才会移动而不是深拷贝元素 */
+    Json(Json&&) noexcept;
     /* 赋值运算符重载，值传递，传实参给形参时：左值拷贝，右值移动 */
     Json& operator=(Json);
 
@@ -0,0 +1,92 @@
+#include "JsonArena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace lightJson {
+
+JsonArena::~JsonArena() { freeAll_(); }
+
+void JsonArena::freeAll_() {
+    while (head_) {
+        Chunk* next = head_->next;
+        ::operator delete(head_);
+        head_ = next;
+    }
+    cur_    = nullptr;
+    end_    = nullptr;
+    chunks_ = 0;
+}
+
+/**
+ * @description: 新申请一块至少bytes字节的内存块并切换到它上面，块大小按上一块翻倍，块数随文档大小对数增长
+ */
+void JsonArena::grow_(size_t bytes) {
+    size_t cap   = std::max({bytes, CHUNK_MIN, head_ ? head_->cap * 2 : 0});
+    Chunk* chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + cap));
+    chunk->next  = head_;
+    chunk->cap   = cap;
+    head_        = chunk;
+    cur_         = reinterpret_cast<char*>(chunk + 1);
+    end_         = cur_ + cap;
+    chunks_++;
+}
+
+/**
+ * @description: 在当前内存块上按align对齐顺序分配bytes字节，放不下时换到新的内存块，旧块中剩余的空间不再使用
+ * @param {size_t} align 必须是2的幂
+ */
+void* JsonArena::allocate(size_t bytes, size_t align) {
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cur_) + align - 1) & ~(align - 1);
+    if (!cur_ || p + bytes > reinterpret_cast<uintptr_t>(end_)) {
+        grow_(bytes + align);
+        p = (reinterpret_cast<uintptr_t>(cur_) + align - 1) & ~(align - 1);
+    }
+    cur_ = reinterpret_cast<char*>(p + bytes);
+    return reinterpret_cast<void*>(p);
+}
+
+/**
+ * @description: 保证当前内存块还能连续分配bytes字节，解析前按输入长度预留，一般的文档只需要这一块
+ */
+void JsonArena::reserve(size_t bytes) {
+    if (static_cast<size_t>(end_ - cur_) < bytes) {
+        grow_(bytes);
+    }
+}
+
+/**
+ * @description: 释放已分配的所有空间。只有一块时原样复用；有多块时合并成一块总大小相同的，
+ *              同一个文档对象反复解析相近大小的输入时，稳定后不再申请内存
+ */
+void JsonArena::reset() {
+    if (!head_) {
+        return;
+    }
+    if (!head_->next) {
+        cur_ = reinterpret_cast<char*>(head_ + 1);
+        return;
+    }
+    size_t total = 0;
+    for (Chunk* chunk = head_; chunk; chunk = chunk->next) {
+        total += chunk->cap;
+    }
+    freeAll_();
+    grow_(total);
+}
+
+size_t JsonArena::chunks() const { return chunks_; }
+
+/**
+ * @description: 所有内存块的总字节数
+ */
+size_t JsonArena::capacity() const {
+    size_t total = 0;
+    for (Chunk* chunk = head_; chunk; chunk = chunk->next) {
+        total += chunk->cap;
+    }
+    return total;
+}
+
+}  // namespace lightJson
@@ -0,0 +1,57 @@
+/*
+ * @Description  : 单调增长的内存区，一个Json文档的所有节点与解码后的字符串都从这里顺序分配，文档销毁或重新解析时一次性释放
+ * @Date         : 2026-10-19 05:52:17
+ * @LastEditTime : 2026-10-19 05:52:17
+ */
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <cstddef>
+
+namespace lightJson {
+
+class JsonArena {
+public:
+    static const size_t CHUNK_MIN = 4096;  // 最小的内存块字节数
+
+private:
+    /* 内存块头部，数据紧跟在头部之后；按最大对齐，保证数据起始地址对任何类型都对齐 */
+    struct alignas(alignof(std::max_align_t)) Chunk {
+        Chunk* next;
+        size_t cap;
+    };
+
+    Chunk* head_{nullptr};  // 最新的内存块，分配只在它上面进行
+    char*  cur_{nullptr};
+    char*  end_{nullptr};
+    size_t chunks_{0};
+
+private:
+    void grow_(size_t bytes);
+    void freeAll_();
+
+public:
+    JsonArena() = default;
+    ~JsonArena();
+
+    JsonArena(const JsonArena&)            = delete;
+    JsonArena& operator=(const JsonArena&) = delete;
+
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+    /* 分配n个T的空间，不调用构造函数，只用于可平凡复制的类型 */
+    template <typename T>
+    T* allocate(size_t n) {
+        return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void reserve(size_t bytes);
+    void reset();
+
+    size_t chunks() const;
+    size_t capacity() const;
+};
+
+}  // namespace lightJson
+
+#endif
@@ -0,0 +1,497 @@
+#include "JsonDocument.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace lightJson {
+
+/* 解析到JsonDocument的解析器，校验规则与JsonParser相同，不生成std::string与容器 */
+class JsonDocParser {
+private:
+    const char*              _curr;
+    JsonArena&               arena_;
+    std::vector<JsonMember>& stack_;
+
+public:
+    JsonDocParser(const std::string& content, JsonArena& arena, std::vector<JsonMember>& stack)
+        : _curr(content.c_str()), arena_(arena), stack_(stack) {}
+
+    JsonValue parseJson();
+
+private:
+    JsonValue parseValue();
+
+    JsonValue parseLiteral(const char* literal, size_t len);
+    JsonValue parseNumber();
+    JsonValue parseString();
+    JsonValue parseArray();
+    JsonValue parseObject();
+
+    void jumpSpace();
+
+    unsigned         parse4hex(const char*& p);
+    std::string_view parseRawString();
+    std::string_view decodeString(const char* begin, const char* end);
+    uint32_t         stackCount(size_t base);
+};
+
+void JsonDocParser::jumpSpace() {
+    while (*_curr == ' ' || *_curr == '\t' || *_curr == '\n' || *_curr == '\r') {
+        ++_curr;
+    }
+}
+
+JsonValue JsonDocParser::parseLiteral(const char* literal, size_t len) {
+    if (strncmp(_curr, literal, len) != 0) {
+        throw JsonException("parse invalid value");
+    }
+    _curr += len;
+    JsonValue val;
+    if (literal[0] != 'n') {
+        val.type_ = JsonType::Bool;
+        val.bool_ = literal[0] == 't';
+    }
+    return val;
+}
+
+JsonValue JsonDocParser::parseNumber() {
+    const char* start = _curr;
+    if (*_curr == '-') {
+        ++_curr;
+    }
+    if (*_curr == '0') {
+        ++_curr;
+    } else {
+        if (!is1to9(*_curr)) {
+            throw JsonException("parse invalid value");
+        }
+        while (is0to9(*++_curr)) {
+        }
+    }
+    if (*_curr == '.') {
+        if (!is0to9(*++_curr)) {
+            throw JsonException("parse invalid value");
+        }
+        while (is0to9(*++_curr)) {
+        }
+    }
+    if (*_curr == 'E' || *_curr == 'e') {
+        ++_curr;
+        if (*_curr == '-' || *_curr == '+') {
+            ++_curr;
+        }
+        if (!is0to9(*_curr)) {
+            throw JsonException("parse invalid value");
+        }
+        while (is0to9(*++_curr)) {
+        }
+    }
+    JsonValue val;
+    val.type_   = JsonType::Number;
+    val.number_ = strtod(start, nullptr);
+    if (fabs(val.number_) == HUGE_VAL) {
+        throw JsonException("parse number too big");
+    }
+    return val;
+}
+
+unsigned JsonDocParser::parse4hex(const char*& p) {
+    unsigned u = 0;
+    for (int i = 0; i != 4; ++i) {
+        char ch = *++p;
+        u <<= 4;
+        if (ch >= '0' && ch <= '9') {
+            u |= ch - '0';
+        } else if (ch >= 'A' && ch <= 'F') {
+            u |= ch - ('A' - 10);
+        } else if (ch >= 'a' && ch <= 'f') {
+            u |= ch - ('a' - 10);
+        } else {
+            throw JsonException("parse invalid unicode hex");
+        }
+    }
+    return u;
+}
+
+/**
+ * @description: 找到字符串的结束引号并检查控制字符；没有转义时直接返回指向输入的视图，不拷贝。
+ *              出错时先解码出错位置之前的部分，前面有非法转义时报告转义错误，与JsonParser逐字符解析的报错顺序一致
+ */
+std::string_view JsonDocParser::parseRawString() {
+    const char* begin   = ++_curr;
+    bool        escaped = false;
+    while (*_curr != '\"') {
+        unsigned char ch = static_cast<unsigned char>(*_curr);
+        if (ch == '\\') {
+            escaped = true;
+            if (*++_curr == '\0') {
+                decodeString(begin, _curr);
+            }
+        } else if (ch < 0x20) {
+            if (escaped) {
+                decodeString(begin, _curr);
+            }
+            throw JsonException(ch == '\0' ? "parse miss quotation mark" : "parse invalid string char");
+        }
+        ++_curr;
+    }
+    const char* end = _curr++;
+    if (end - begin > std::numeric_limits<uint32_t>::max()) {
+        throw JsonException("parse string too long");
+    }
+    return escaped ? decodeString(begin, end) : std::string_view(begin, end - begin);
+}
+
+/**
+ * @description: 把含转义的字符串解码到内存区中；解码后不会比原文长，按原文长度分配一次即可
+ */
+std::string_view JsonDocParser::decodeString(const char* begin, const char* end) {
+    char* out  = static_cast<char*>(arena_.allocate(end - begin, 1));
+    char* last = out;
+    for (const char* p = begin; p != end; ++p) {
+        if (*p != '\\') {
+            *last++ = *p;
+            continue;
+        }
+        switch (*++p) {
+            case '\"':
+                *last++ = '\"';
+                break;
+            case '\\':
+                *last++ = '\\';
+                break;
+            case '/':
+                *last++ = '/';
+                break;
+            case 'b':
+                *last++ = '\b';
+                break;
+            case 'f':
+                *last++ = '\f';
+                break;
+            case 'n':
+                *last++ = '\n';
+                break;
+            case 't':
+                *last++ = '\t';
+                break;
+            case 'r':
+                *last++ = '\r';
+                break;
+            case 'u': {
+                /*结束引号不是十六进制字符，读到它就会报错，不会越过字符串的末尾*/
+                unsigned u = parse4hex(p);
+                if (u >= 0xd800 && u <= 0xdbff) {
+                    if (*++p != '\\' || *++p != 'u') {
+                        throw JsonException("parse invalid unicode surrogate");
+                    }
+                    unsigned u2 = parse4hex(p);
+                    if (u2 < 0xdc00 || u2 > 0xdfff) {
+                        throw JsonException("parse invalid unicode surrogate");
+                    }
+                    u = (((u - 0xd800) << 10) | (u2 - 0xdc00)) + 0x10000;
+                }
+                if (u <= 0x7F) {
+                    *last++ = static_cast<char>(u);
+                } else if (u <= 0x7FF) {
+                    *last++ = static_cast<char>(0xc0 | (u >> 6));
+                    *last++ = static_cast<char>(0x80 | (u & 0x3f));
+                } else if (u <= 0xFFFF) {
+                    *last++ = static_cast<char>(0xe0 | (u >> 12));
+                    *last++ = static_cast<char>(0x80 | ((u >> 6) & 0x3f));
+                    *last++ = static_cast<char>(0x80 | (u & 0x3f));
+                } else {
+                    *last++ = static_cast<char>(0xf0 | (u >> 18));
+                    *last++ = static_cast<char>(0x80 | ((u >> 12) & 0x3f));
+                    *last++ = static_cast<char>(0x80 | ((u >> 6) & 0x3f));
+                    *last++ = static_cast<char>(0x80 | (u & 0x3f));
+                }
+            } break;
+            default:
+                throw JsonException("parse invalid string escape");
+        }
+    }
+    return std::string_view(out, last - out);
+}
+
+JsonValue JsonDocParser::parseString() {
+    std::string_view str = parseRawString();
+    JsonValue        val;
+    val.type_ = JsonType::String;
+    val.size_ = static_cast<uint32_t>(str.size());
+    val.str_  = str.data();
+    return val;
+}
+
+/**
+ * @description: 暂存栈中base之后的元素个数，即正在闭合的数组或对象的元素个数
+ */
+uint32_t JsonDocParser::stackCount(size_t base) {
+    size_t count = stack_.size() - base;
+    if (count > std::numeric_limits<uint32_t>::max()) {
+        throw JsonException("parse too many elements");
+    }
+    return static_cast<uint32_t>(count);
+}
+
+/**
+ * @description: 解析数组类型，递归处理；元素先压入暂存栈，闭合时连续存放到内存区
+ */
+JsonValue JsonDocParser::parseArray() {
+    JsonValue arr;
+    arr.type_   = JsonType::Array;
+    arr.elems_  = nullptr;
+    size_t base = stack_.size();
+    ++_curr;
+    jumpSpace();
+    if (*_curr == ']') {
+        ++_curr;
+        return arr;
+    }
+    while (true) {
+        jumpSpace();
+        JsonValue val = parseValue();
+        stack_.push_back({std::string_view(), val});
+        jumpSpace();
+        if (*_curr == ',') {
+            ++_curr;
+        } else if (*_curr == ']') {
+            ++_curr;
+            break;
+        } else {
+            throw JsonException("parse miss comma or square bracket");
+        }
+    }
+    arr.size_        = stackCount(base);
+    JsonValue* elems = arena_.allocate<JsonValue>(arr.size_);
+    for (uint32_t i = 0; i < arr.size_; i++) {
+        elems[i] = stack_[base + i].value;
+    }
+    arr.elems_ = elems;
+    stack_.resize(base);
+    return arr;
+}
+
+/**
+ * @description: 解析对象类型，递归处理；成员保持输入中的顺序，重复的键按第一个查找，与JsonParser一致
+ */
+JsonValue JsonDocParser::parseObject() {
+    JsonValue obj;
+    obj.type_    = JsonType::Object;
+    obj.members_ = nullptr;
+    size_t base  = stack_.size();
+    ++_curr;
+    jumpSpace();
+    if (*_curr == '}') {
+        ++_curr;
+        return obj;
+    }
+    while (true) {
+        jumpSpace();
+        if (*_curr != '\"') {
+            throw JsonException("parse miss key");
+        }
+        std::string_view key = parseRawString();
+        jumpSpace();
+        if (*_curr++ != ':') {
+            throw JsonException("parse miss colon");
+        }
+        jumpSpace();
+        JsonValue val = parseValue();
+        stack_.push_back({key, val});
+        jumpSpace();
+        if (*_curr == ',') {
+            ++_curr;
+        } else if (*_curr == '}') {
+            ++_curr;
+            break;
+        } else {
+            throw JsonException("parse miss comma or curly bracket");
+        }
+    }
+    obj.size_          = stackCount(base);
+    JsonMember* member = arena_.allocate<JsonMember>(obj.size_);
+    std::copy(stack_.begin() + base, stack_.end(), member);
+    obj.members_ = member;
+    stack_.resize(base);
+    return obj;
+}
+
+JsonValue JsonDocParser::parseValue() {
+    switch (*_curr) {
+        case 'n':
+            return parseLiteral("null", 4);
+        case 't':
+            return parseLiteral("true", 4);
+        case 'f':
+            return parseLiteral("false", 5);
+        case '\"':
+            return parseString();
+        case '[':
+            return parseArray();
+        case '{':
+            return parseObject();
+        case '\0':
+            throw JsonException("parse expect value");
+        default:
+            return parseNumber();
+    }
+}
+
+JsonValue JsonDocParser::parseJson() {
+    jumpSpace();
+    JsonValue json = parseValue();
+    jumpSpace();
+    if (*_curr) {
+        throw JsonException("parse root not singular");
+    }
+    return json;
+}
+
+/**
+ * @description: 解析content，先释放上一次解析得到的所有节点；不含转义的字符串指向content，
+ *              content必须比文档以及从文档中取得的值活得更久
+ * @return {bool} 失败时errMsg为错误信息，根节点为null
+ */
+bool JsonDocument::parse(const std::string& content, std::string& errMsg) {
+    arena_.reset();
+    /*节点大小与输入长度大致成正比，预留两倍输入长度，一般的文档只用这一块内存*/
+    arena_.reserve(content.size() * 2);
+    stack_.clear();
+    stack_.reserve(STACK_MIN);
+    root_ = JsonValue();
+    try {
+        JsonDocParser p(content, arena_, stack_);
+        root_ = p.parseJson();
+        return true;
+    } catch (JsonException& e) {
+        errMsg = e.what();
+        return false;
+    }
+}
+
+const JsonValue& JsonDocument::root() const { return root_; }
+
+const JsonArena& JsonDocument::arena() const { return arena_; }
+
+JsonType JsonValue::getType() const { return type_; }
+
+bool JsonValue::isNull() const { return type_ == JsonType::Null; }
+bool JsonValue::isBool() const { return type_ == JsonType::Bool; }
+bool JsonValue::isNumber() const { return type_ == JsonType::Number; }
+bool JsonValue::isString() const { return type_ == JsonType::String; }
+bool JsonValue::isArray() const { return type_ == JsonType::Array; }
+bool JsonValue::isObject() const { return type_ == JsonType::Object; }
+
+bool JsonValue::toBool() const {
+    if (isBool()) {
+        return bool_;
+    } else {
+        throw JsonException("not a bool");
+    }
+}
+
+double JsonValue::toNumber() const {
+    if (isNumber()) {
+        return number_;
+    } else {
+        throw JsonException("not a number");
+    }
+}
+
+/**
+ * @description: 字符串的视图，指向输入或文档的内存区，不以'\0'结尾
+ */
+std::string_view JsonValue::toString() const {
+    if (isString()) {
+        return std::string_view(str_, size_);
+    } else {
+        throw JsonException("not a string");
+    }
+}
+
+std::size_t JsonValue::size() const {
+    if (isArray() || isObject()) {
+        return size_;
+    } else {
+        throw JsonException("not a jsonArray or jsonObject");
+    }
+}
+
+const JsonValue& JsonValue::operator[](std::size_t pos) const {
+    if (!isArray()) {
+        throw JsonException("not a jsonArray");
+    }
+    if (pos >= size_) {
+        throw JsonException("jsonArray index out of range");
+    }
+    return elems_[pos];
+}
+
+/**
+ * @description: 按键顺序查找对象的成员，请求大小的对象成员很少，顺序查找比散列更快；找不到时返回nullptr
+ */
+const JsonValue* JsonValue::find(std::string_view key) const {
+    if (!isObject()) {
+        throw JsonException("not a jsonObject");
+    }
+    for (uint32_t i = 0; i < size_; i++) {
+        if (members_[i].key == key) {
+            return &members_[i].value;
+        }
+    }
+    return nullptr;
+}
+
+const JsonValue& JsonValue::operator[](std::string_view key) const {
+    const JsonValue* val = find(key);
+    if (!val) {
+        throw JsonException("jsonObject key not found");
+    }
+    return *val;
+}
+
+const JsonMember& JsonValue::member(std::size_t pos) const {
+    if (!isObject()) {
+        throw JsonException("not a jsonObject");
+    }
+    if (pos >= size_) {
+        throw JsonException("jsonObject index out of range");
+    }
+    return members_[pos];
+}
+
+/**
+ * @description: 深拷贝为独立的Json对象，之后不再依赖文档与输入
+ */
+Json JsonValue::toJson() const {
+    switch (type_) {
+        case JsonType::Bool:
+            return Json(bool_);
+        case JsonType::Number:
+            return Json(number_);
+        case JsonType::String:
+            return Json(std::string(str_, size_));
+        case JsonType::Array: {
+            jsonArray arr;
+            arr.reserve(size_);
+            for (uint32_t i = 0; i < size_; i++) {
+                arr.push_back(elems_[i].toJson());
+            }
+            return Json(arr);
+        }
+        case JsonType::Object: {
+            jsonObject obj;
+            for (uint32_t i = 0; i < size_; i++) {
+                obj.emplace(std::string(members_[i].key), members_[i].value.toJson());
+            }
+            return Json(obj);
+        }
+        default:
+            return Json(nullptr);
+    }
+}
+
+}  // namespace lightJson
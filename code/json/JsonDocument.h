@@ -0,0 +1,93 @@
+/*
+ * @Description  : 只读的Json文档，节点都分配在文档自己的JsonArena中，不含转义的字符串直接指向输入，数组与对象的元素连续存放
+ * @Date         : 2026-10-19 05:52:17
+ * @LastEditTime : 2026-10-19 05:52:17
+ */
+#ifndef JSON_DOCUMENT_H
+#define JSON_DOCUMENT_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Json.h"
+#include "JsonArena.h"
+
+namespace lightJson {
+
+struct JsonMember;
+
+/* 文档中的一个值，16字节，可平凡复制；array与object只保存指向连续元素的指针与元素个数 */
+class JsonValue {
+    friend class JsonDocParser;
+
+private:
+    JsonType type_{JsonType::Null};
+    uint32_t size_{0};  // 字符串长度，或数组、对象的元素个数
+    union {
+        bool              bool_;
+        double            number_;
+        const char*       str_;
+        const JsonValue*  elems_;
+        const JsonMember* members_;
+    };
+
+public:
+    JsonValue() : str_(nullptr) {}
+
+    JsonType getType() const;
+
+    bool isNull() const;
+    bool isBool() const;
+    bool isNumber() const;
+    bool isString() const;
+    bool isArray() const;
+    bool isObject() const;
+
+    bool             toBool() const;
+    double           toNumber() const;
+    std::string_view toString() const;
+
+    /* 仅限 Array 和 Object 类型调用，只读 */
+    std::size_t       size() const;
+    const JsonValue&  operator[](std::size_t) const;
+    const JsonValue&  operator[](std::string_view) const;
+    const JsonValue*  find(std::string_view key) const;
+    const JsonMember& member(std::size_t) const;
+
+    Json toJson() const;
+};
+
+/* 对象的一个键值对，对象的成员按在输入中出现的顺序连续存放 */
+struct JsonMember {
+    std::string_view key;
+    JsonValue        value;
+};
+
+class JsonDocument {
+public:
+    static const size_t STACK_MIN = 64;  // 暂存栈的初始容量，请求大小的文档不需要再扩容
+
+private:
+    JsonArena               arena_;
+    std::vector<JsonMember> stack_;  // 解析时暂存尚未闭合的数组、对象的元素，容量跨解析保留
+    JsonValue               root_;
+
+public:
+    JsonDocument() = default;
+
+    JsonDocument(const JsonDocument&)            = delete;
+    JsonDocument& operator=(const JsonDocument&) = delete;
+
+    bool parse(const std::string& content, std::string& errMsg);
+    /* 字符串值会指向输入，禁止传入临时字符串 */
+    bool parse(std::string&& content, std::string& errMsg) = delete;
+
+    const JsonValue& root() const;
+    const JsonArena& arena() const;
+};
+
+}  // namespace lightJson
+
+#endif
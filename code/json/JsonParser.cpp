@@ -114,9 +114,29 @@ std::string JsonParser::encodeUTF8(unsigned u) {
 
 /**
  * @description: 解析然后返回原始字符串
- *  先处理转义字符，再检测合法性
+ *  字符串内部不产生结构索引，开引号之后的第一个索引就是闭引号；没有转义和控制字符时整段拷贝，否则逐字符解码
  */
 std::string JsonParser::parseRawString() {
+    skipIndex();
+    const char* first = _curr + 1;
+    if (_next != _scanner.end() && _begin[*_next] == '\"') {
+        const char* last = _begin + *_next;
+        size_t      ctrl = _scanner.firstCtrl();
+        if ((ctrl < static_cast<size_t>(first - _begin) || ctrl >= *_next) &&
+            !memchr(first, '\\', last - first)) {
+            _curr = _start = last + 1;
+            ++_next;
+            return std::string(first, last);
+        }
+    }
+    return decodeString();
+}
+
+/**
+ * @description: 从开引号开始逐字符解码
+ *  先处理转义字符，再检测合法性
+ */
+std::string JsonParser::decodeString() {
     std::string str;
     while (true) {
         switch (*++_curr) {
@@ -198,7 +218,7 @@ Json JsonParser::parseArray() {
     jumpSpace();
     if (*_curr == ']') {
         _start = ++_curr;
-        return Json(arr);
+        return Json(std::move(arr));
     }
     while (true) {
         jumpSpace();
@@ -208,7 +228,7 @@ Json JsonParser::parseArray() {
             ++_curr;
         } else if (*_curr == ']') {
             _start = ++_curr;
-            return (Json(arr));
+            return Json(std::move(arr));
         } else {
             throw(JsonException("parse miss comma or square bracket"));
         }
@@ -225,7 +245,7 @@ Json JsonParser::parseObject() {
     jumpSpace();
     if (*_curr == '}') {
         _start = ++_curr;
-        return Json(obj);
+        return Json(std::move(obj));
     }
     while (true) {
         jumpSpace();
@@ -238,14 +258,13 @@ Json JsonParser::parseObject() {
             throw(JsonException("parse miss colon"));
         }
         jumpSpace();
-        Json val = parseValue();
-        obj.emplace(key, val);
+        obj.emplace(std::move(key), parseValue());
         jumpSpace();
         if (*_curr == ',') {
             ++_curr;
         } else if (*_curr == '}') {
             _start = ++_curr;
-            return Json(obj);
+            return Json(std::move(obj));
         } else {
             throw JsonException("parse miss comma or curly bracket");
         }
@@ -254,15 +273,26 @@ Json JsonParser::parseObject() {
 
 /**
  * @description: 解析空白处，即跳过空白
- * 空白可能有：空格、Tab、换行、回车
+ * 空白可能有：空格、Tab、换行、回车；空白之后的第一个字符一定在结构索引中，直接跳到下一个索引处
  */
 void JsonParser::jumpSpace() {
-    while (*_curr == ' ' || *_curr == '\t' || *_curr == '\n' || *_curr == '\r') {
-        ++_curr;
+    if (*_curr == ' ' || *_curr == '\t' || *_curr == '\n' || *_curr == '\r') {
+        skipIndex();
+        _curr = _next != _scanner.end() ? _begin + *_next : _end;
     }
     _start = _curr;
 }
 
+/**
+ * @description: 结构索引前进到_curr之后的第一个，_curr只会向后移动，整个解析中索引总共只遍历一遍
+ */
+void JsonParser::skipIndex() {
+    uint32_t pos = static_cast<uint32_t>(_curr - _begin);
+    while (_next != _scanner.end() && *_next <= pos) {
+        ++_next;
+    }
+}
+
 /**
  * @description: 解析Json中键值对的 值
  */
@@ -289,9 +319,11 @@ Json JsonParser::parseValue() {
 
 /**
  * @description: 解析
- * 过程就是：跳过空白、解析Json、跳过空白
+ * 过程就是：第一阶段扫描出结构索引，第二阶段跳过空白、解析Json、跳过空白
  */
 Json JsonParser::parseJson() {
+    _scanner.scan(_begin, _end - _begin);
+    _next = _scanner.begin();
     jumpSpace();
     Json json = parseValue();
     jumpSpace();
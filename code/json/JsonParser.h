@@ -11,6 +11,7 @@
 #include <cstring>
 
 #include "JsonException.h"
+#include "JsonScanner.h"
 
 namespace lightJson {
 
@@ -21,11 +22,17 @@ class Json;
 
 class JsonParser {
 private:
+    const char* _begin;  // 输入开头，结构索引是相对它的偏移
+    const char* _end;    // 输入结尾的'\0'
     const char* _start;
     const char* _curr;
 
+    JsonScanner     _scanner;
+    const uint32_t* _next;  // 下一个要查看的结构索引，只向后移动
+
 public:
-    explicit JsonParser(const char* cstr) : _start(cstr), _curr(cstr) {}
+    explicit JsonParser(const char* cstr)
+        : _begin(cstr), _end(cstr + strlen(cstr)), _start(cstr), _curr(cstr), _next(nullptr) {}
     explicit JsonParser(const std::string& content) : JsonParser(content.c_str()) {}
 
     JsonParser(const JsonParser&)            = delete;
@@ -45,10 +52,12 @@ private:
     Json parseObject();
 
     void jumpSpace();
+    void skipIndex();
 
     unsigned    parse4hex();
     std::string encodeUTF8(unsigned u);
     std::string parseRawString();
+    std::string decodeString();
 };
 
 }  // namespace lightJson
@@ -0,0 +1,265 @@
+#include "JsonScanner.h"
+
+#include <cstring>
+
+#include "JsonException.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace lightJson {
+
+namespace {
+
+enum : uint8_t { C_QUOTE = 1, C_BACKSLASH = 2, C_SPACE = 4, C_OP = 8, C_CTRL = 16 };
+
+/* 逐字节实现使用的字符分类表；'\t' '\n' '\r'既是空白也是控制字符，出现在字符串中不合法 */
+struct CharTable {
+    uint8_t cls[256];
+
+    constexpr CharTable() : cls() {
+        for (int c = 0; c < 0x20; c++) {
+            cls[c] = C_CTRL;
+        }
+        cls[static_cast<uint8_t>('\"')] = C_QUOTE;
+        cls[static_cast<uint8_t>('\\')] = C_BACKSLASH;
+        cls[static_cast<uint8_t>(' ')]  = C_SPACE;
+        cls[static_cast<uint8_t>('\t')] |= C_SPACE;
+        cls[static_cast<uint8_t>('\n')] |= C_SPACE;
+        cls[static_cast<uint8_t>('\r')] |= C_SPACE;
+        cls[static_cast<uint8_t>('{')] = C_OP;
+        cls[static_cast<uint8_t>('}')] = C_OP;
+        cls[static_cast<uint8_t>('[')] = C_OP;
+        cls[static_cast<uint8_t>(']')] = C_OP;
+        cls[static_cast<uint8_t>(':')] = C_OP;
+        cls[static_cast<uint8_t>(',')] = C_OP;
+    }
+};
+
+constexpr CharTable TABLE;
+
+/**
+ * @description: 第i位为x的第0到第i位的异或，引号掩码经过它得到字符串内部的掩码(含开引号，不含闭引号)
+ */
+inline uint64_t prefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+}  // namespace
+
+/**
+ * @description: 当前CPU支持的最快实现；可能在全局对象构造前调用，先初始化CPU特性检测
+ */
+JsonScanner::Kernel JsonScanner::best() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? AVX2 : SSE2;
+#else
+    return SCALAR;
+#endif
+}
+
+const char* JsonScanner::name(Kernel kernel) {
+    switch (kernel) {
+        case AVX2:
+            return "avx2";
+        case SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
+
+static JsonScanner::Kernel currKernel = JsonScanner::best();
+
+JsonScanner::Classify JsonScanner::classify_ =
+#if defined(__x86_64__)
+    currKernel == AVX2 ? classifyAvx2_ : classifySse2_;
+#else
+    classifyScalar_;
+#endif
+
+/**
+ * @description: 切换所有解析使用的实现，只用于测试比较，不能与解析同时进行
+ * @return {bool} CPU不支持该实现时返回false，不切换
+ */
+bool JsonScanner::setKernel(Kernel kernel) {
+    switch (kernel) {
+#if defined(__x86_64__)
+        case AVX2:
+            if (best() != AVX2) {
+                return false;
+            }
+            classify_ = classifyAvx2_;
+            break;
+        case SSE2:
+            classify_ = classifySse2_;
+            break;
+#endif
+        case SCALAR:
+            classify_ = classifyScalar_;
+            break;
+        default:
+            return false;
+    }
+    currKernel = kernel;
+    return true;
+}
+
+JsonScanner::Kernel JsonScanner::kernel() { return currKernel; }
+
+void JsonScanner::classifyScalar_(const char* block, Masks* masks) {
+    uint64_t m[5] = {0, 0, 0, 0, 0};
+    for (size_t i = 0; i < BLOCK; i++) {
+        uint8_t cls = TABLE.cls[static_cast<uint8_t>(block[i])];
+        m[0] |= static_cast<uint64_t>((cls & C_QUOTE) != 0) << i;
+        m[1] |= static_cast<uint64_t>((cls & C_BACKSLASH) != 0) << i;
+        m[2] |= static_cast<uint64_t>((cls & C_SPACE) != 0) << i;
+        m[3] |= static_cast<uint64_t>((cls & C_OP) != 0) << i;
+        m[4] |= static_cast<uint64_t>((cls & C_CTRL) != 0) << i;
+    }
+    *masks = {m[0], m[1], m[2], m[3], m[4]};
+}
+
+#if defined(__x86_64__)
+
+/**
+ * @description: 每次比较16字节；'['与'{'、']'与'}'只差0x20这一位，或上0x20后各比较一次
+ */
+void JsonScanner::classifySse2_(const char* block, Masks* masks) {
+    *masks = {0, 0, 0, 0, 0};
+    for (size_t i = 0; i < BLOCK; i += 16) {
+        __m128i v     = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i quote = _mm_cmpeq_epi8(v, _mm_set1_epi8('\"'));
+        __m128i bs    = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+        __m128i space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                     _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        __m128i op    = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')),
+                                                  _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+                                     _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')),
+                                                  _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        __m128i ctrl  = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);
+        masks->quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(quote))) << i;
+        masks->backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(bs))) << i;
+        masks->space |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(space))) << i;
+        masks->op |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(op))) << i;
+        masks->ctrl |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(ctrl))) << i;
+    }
+}
+
+/**
+ * @description: 与SSE2实现相同，每次比较32字节，只为这个函数开启AVX2指令，其余代码仍可在不支持AVX2的CPU上运行
+ */
+__attribute__((target("avx2"))) void JsonScanner::classifyAvx2_(const char* block, Masks* masks) {
+    *masks = {0, 0, 0, 0, 0};
+    for (size_t i = 0; i < BLOCK; i += 32) {
+        __m256i v     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i quote = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"'));
+        __m256i bs    = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'));
+        __m256i space = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        __m256i op    = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')),
+                                                        _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')),
+                                                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        __m256i ctrl  = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v);
+        masks->quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(quote))) << i;
+        masks->backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(bs))) << i;
+        masks->space |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(space))) << i;
+        masks->op |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(op))) << i;
+        masks->ctrl |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ctrl))) << i;
+    }
+}
+
+#endif
+
+/**
+ * @description: 扫描buf的前len字节，生成结构索引：字符串外的{}[]:,、所有未转义的引号、字符串外每段空白之后的第一个字符。
+ *              第二阶段只在空白处查索引，所以空白后的字符都在索引中，紧跟在结构字符后面的值不需要；
+ *              另记下字符串中第一个控制字符的位置，第二阶段据此判断无转义的字符串能否整段拷贝
+ */
+void JsonScanner::scan(const char* buf, size_t len) {
+    if (len > UINT32_MAX) {
+        throw JsonException("parse input too large");
+    }
+    /*每个字节最多一个索引，按输入长度分配，不需要初始化*/
+    if (capacity_ < len) {
+        indexes_.reset(new uint32_t[len]);
+        capacity_ = len;
+    }
+    uint32_t* out          = indexes_.get();
+    uint64_t  prevEscaped  = 0;  // 上一块末尾的反斜杠转义了本块第0个字节
+    uint64_t  prevInString = 0;  // 上一块结束时在字符串中，全1或全0
+    uint64_t  prevSpace    = 1;  // 上一块最后一个字节是空白，文档开头视为空白
+    char      tail[BLOCK];
+    firstCtrl_ = SIZE_MAX;
+
+    for (size_t base = 0; base < len; base += BLOCK) {
+        const char* block = buf + base;
+        if (len - base < BLOCK) {
+            /*最后不满一块时用空格补齐，空格不会产生索引*/
+            memset(tail, ' ', BLOCK);
+            memcpy(tail, block, len - base);
+            block = tail;
+        }
+        Masks m;
+        classify_(block, &m);
+
+        /*反斜杠很少，逐个处理：每个未被转义的反斜杠转义它后面的一个字节，被转义的反斜杠不再转义别的字节*/
+        uint64_t escaped = prevEscaped;
+        uint64_t bs      = m.backslash & ~escaped;
+        prevEscaped      = 0;
+        while (bs) {
+            int i = __builtin_ctzll(bs);
+            if (i == 63) {
+                prevEscaped = 1;
+                break;
+            }
+            escaped |= 2ULL << i;
+            bs &= ~(3ULL << i);
+        }
+
+        uint64_t quote    = m.quote & ~escaped;
+        uint64_t inString = prefixXor(quote) ^ prevInString;
+        prevInString      = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+
+        uint64_t ctrl = m.ctrl & inString;
+        if (ctrl && firstCtrl_ == SIZE_MAX) {
+            firstCtrl_ = base + __builtin_ctzll(ctrl);
+        }
+
+        uint64_t start = ~m.space & ((m.space << 1) | prevSpace);
+        prevSpace      = m.space >> 63;
+
+        uint64_t bits = ((m.op | start) & ~inString) | quote;
+        while (bits) {
+            *out++ = static_cast<uint32_t>(base + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+    count_ = out - indexes_.get();
+}
+
+const uint32_t* JsonScanner::begin() const { return indexes_.get(); }
+
+const uint32_t* JsonScanner::end() const { return indexes_.get() + count_; }
+
+/**
+ * @description: 字符串中第一个控制字符的位置，没有时为SIZE_MAX
+ */
+size_t JsonScanner::firstCtrl() const { return firstCtrl_; }
+
+}  // namespace lightJson
@@ -0,0 +1,69 @@
+/*
+ * @Description  : Json解析的第一阶段，每次处理64字节，用SIMD比较找出字符串外的结构字符、所有未转义的引号以及每个空白之后的值的起点，
+ *                 得到按位置排序的结构索引，由JsonParser在第二阶段按索引跳过空白、定位字符串的结束引号
+ * @Date         : 2026-10-19 06:41:26
+ * @LastEditTime : 2026-10-19 06:41:26
+ */
+#ifndef JSON_SCANNER_H
+#define JSON_SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace lightJson {
+
+class JsonScanner {
+public:
+    /* 求字符分类掩码的实现，AVX2与SSE2只在x86-64上可用，其余平台只有逐字节查表 */
+    enum Kernel { SCALAR, SSE2, AVX2 };
+
+    static const size_t BLOCK = 64;  // 每次处理的字节数，即一个64位掩码
+
+    static Kernel      best();
+    static const char* name(Kernel kernel);
+    static bool        setKernel(Kernel kernel);
+    static Kernel      kernel();
+
+private:
+    /* 一个块中各类字符的位掩码，第i位对应块中第i个字节 */
+    struct Masks {
+        uint64_t quote;
+        uint64_t backslash;
+        uint64_t space;
+        uint64_t op;
+        uint64_t ctrl;
+    };
+
+    using Classify = void (*)(const char* block, Masks* masks);
+
+    static Classify classify_;
+
+    std::unique_ptr<uint32_t[]> indexes_;
+    size_t                      capacity_{0};
+    size_t                      count_{0};
+    size_t                      firstCtrl_{SIZE_MAX};
+
+private:
+    static void classifyScalar_(const char* block, Masks* masks);
+#if defined(__x86_64__)
+    static void classifySse2_(const char* block, Masks* masks);
+    static void classifyAvx2_(const char* block, Masks* masks);
+#endif
+
+public:
+    JsonScanner() = default;
+
+    JsonScanner(const JsonScanner&)            = delete;
+    JsonScanner& operator=(const JsonScanner&) = delete;
+
+    void scan(const char* buf, size_t len);
+
+    const uint32_t* begin() const;
+    const uint32_t* end() const;
+    size_t          firstCtrl() const;
+};
+
+}  // namespace lightJson
+
+#endif
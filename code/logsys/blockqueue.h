@@ -1,35 +1,75 @@
 /*
- * @Description  : 封装生产者消费者模型，实现线程安全的阻塞队列
+ * @Description  : 有界多生产者多消费者队列，基于2的幂大小的环形数组与每个槽位的序号实现无锁入队出队，
+ *                 只有队列真正为空或为满时才通过futex阻塞
  * @Date         : 2022-07-16 01:14:05
- * @LastEditTime : 2022-07-18 00:01:28
+ * @LastEditTime : 2026-10-18 17:38:20
  */
 #ifndef BLOCKQUEUE_H
 #define BLOCKQUEUE_H
 
 #include <assert.h>
+#include <errno.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
-#include <condition_variable>
-#include <mutex>
-#include <queue>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
 
 template <class T>
 class BlockQueue {
 private:
-    std::queue<T> que_;  // 共享队列
-    std::mutex    mtx_;  // 互斥量
+    static const int SPIN_COUNT = 200;  // 阻塞前先自旋等待的次数，避免每个元素都触发一次睡眠与唤醒
 
-    std::condition_variable condConsumer_;  // 消费者条件变量
-    std::condition_variable condProducer_;  // 生产者条件变量
+    /* 槽位：seq等于入队位置时可写，等于入队位置+1时可读 */
+    struct Slot {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
 
-    size_t capacity_;  // 最大容量
-    bool   isClose_;   // 是否关闭
+        T *item() { return std::launder(reinterpret_cast<T *>(storage)); }
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t                  mask_;
+
+    alignas(64) std::atomic<size_t> enqPos_;  // 下一个入队位置
+    alignas(64) std::atomic<size_t> deqPos_;  // 下一个出队位置
+
+    /* futex字，最低位表示有线程在其上睡眠；唤醒方清除该位后才发起系统调用，
+     * 被唤醒者重新睡眠前不会再有多余的唤醒调用，平时入队出队对它只读不写 */
+    alignas(64) std::atomic<uint32_t> notEmpty_;
+    alignas(64) std::atomic<uint32_t> notFull_;
+
+    std::atomic<bool> isClose_;  // 是否关闭
+
+    static size_t roundUp_(size_t n);
+
+    static long futexWait_(std::atomic<uint32_t> &word, uint32_t val, const timespec *timeout);
+    static void futexWake_(std::atomic<uint32_t> &word, int count);
+
+    static uint32_t prepareSleep_(std::atomic<uint32_t> &word);
+    static void     notify_(std::atomic<uint32_t> &word);
+
+    bool waitNotEmpty_(const timespec *deadline);
+    bool waitNotFull_();
+
+    template <class Pred>
+    static bool spin_(Pred pred);
 
 public:
-    explicit BlockQueue(size_t MaxCapacity = 1000);
+    explicit BlockQueue(size_t MaxCapacity = 1024);
 
     ~BlockQueue();
 
+    BlockQueue(const BlockQueue &)            = delete;
+    BlockQueue &operator=(const BlockQueue &) = delete;
+
     void clear();
     void close();
 
@@ -39,17 +79,43 @@ public:
     bool empty();
     bool full();
 
-    void push(const T &item);
+    bool try_push(T &&item);
+    bool push(T &&item);
+    bool push(const T &item);
 
-    bool pop(T &item);
-    bool pop(T &item, int timeout);
+    bool   try_pop(T &item);
+    bool   pop(T &item);
+    bool   pop(T &item, int timeout);
+    size_t pop_batch(std::vector<T> &out, size_t max);
 
     void wakeupOneConsumer();
 };
 
 template <typename T>
-BlockQueue<T>::BlockQueue(size_t MaxCapacity) : capacity_(MaxCapacity), isClose_(false) {
+size_t BlockQueue<T>::roundUp_(size_t n) {
+    size_t cap = 2;
+    while (cap < n) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+/**
+ * @description: 容量向上取整到2的幂
+ */
+template <typename T>
+BlockQueue<T>::BlockQueue(size_t MaxCapacity)
+    : slots_(new Slot[roundUp_(MaxCapacity)]),
+      mask_(roundUp_(MaxCapacity) - 1),
+      enqPos_(0),
+      deqPos_(0),
+      notEmpty_(0),
+      notFull_(0),
+      isClose_(false) {
     assert(MaxCapacity > 0);
+    for (size_t i = 0; i <= mask_; i++) {
+        slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
 }
 
 template <typename T>
@@ -57,15 +123,125 @@ BlockQueue<T>::~BlockQueue() {
     close();
 }
 
+template <typename T>
+long BlockQueue<T>::futexWait_(std::atomic<uint32_t> &word, uint32_t val,
+                               const timespec *timeout) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, val,
+                   timeout, nullptr, 0);
+}
+
+template <typename T>
+void BlockQueue<T>::futexWake_(std::atomic<uint32_t> &word, int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, count, nullptr,
+            nullptr, 0);
+}
+
+/**
+ * @description: 准备睡眠：置上futex字的睡眠位，返回睡眠时应比较的值。
+ *               调用者之后必须复查队列状态，再以返回值调用futexWait_
+ */
+template <typename T>
+uint32_t BlockQueue<T>::prepareSleep_(std::atomic<uint32_t> &word) {
+    uint32_t val = word.load(std::memory_order_seq_cst);
+    while (!(val & 1) && !word.compare_exchange_weak(val, val | 1, std::memory_order_seq_cst)) {
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return val | 1;
+}
+
+/**
+ * @description: 入队或出队后调用。与prepareSleep_配对：要么这里看到睡眠位，清除它、改变futex字并唤醒所有睡眠者，
+ *               要么睡眠者复查时看到本次的修改，不会丢失唤醒；没有睡眠者时只有一次读
+ */
+template <typename T>
+void BlockQueue<T>::notify_(std::atomic<uint32_t> &word) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t val = word.load(std::memory_order_relaxed);
+    while (val & 1) {
+        if (word.compare_exchange_weak(val, (val + 2) & ~1u, std::memory_order_seq_cst)) {
+            futexWake_(word, INT32_MAX);
+            return;
+        }
+    }
+}
+
+/**
+ * @description: 短暂自旋直到pred成立，成立返回true
+ */
+template <typename T>
+template <class Pred>
+bool BlockQueue<T>::spin_(Pred pred) {
+    for (int i = 0; i < SPIN_COUNT; i++) {
+        if (pred()) {
+            return true;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    return pred();
+}
+
+/**
+ * @description: 队列为空时阻塞，直到可能有数据、关闭或超时
+ * @param {timespec} *deadline 绝对时间(CLOCK_MONOTONIC)，为空表示一直等待
+ * @return {bool} 超时返回false
+ */
+template <typename T>
+bool BlockQueue<T>::waitNotEmpty_(const timespec *deadline) {
+    if (spin_([this] { return !empty() || isClose_.load(std::memory_order_relaxed); })) {
+        return true;
+    }
+    uint32_t val = prepareSleep_(notEmpty_);
+    bool     ok  = true;
+    if (empty() && !isClose_.load(std::memory_order_seq_cst)) {
+        timespec  rel;
+        timespec *timeout = nullptr;
+        if (deadline) {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            rel.tv_sec  = deadline->tv_sec - now.tv_sec;
+            rel.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+            if (rel.tv_nsec < 0) {
+                rel.tv_sec--;
+                rel.tv_nsec += 1000000000;
+            }
+            timeout = &rel;
+            ok      = rel.tv_sec >= 0;
+        }
+        if (ok && futexWait_(notEmpty_, val, timeout) < 0 && errno == ETIMEDOUT) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/**
+ * @description: 队列为满时阻塞，直到可能有空位或关闭
+ */
+template <typename T>
+bool BlockQueue<T>::waitNotFull_() {
+    if (spin_([this] { return !full() || isClose_.load(std::memory_order_relaxed); })) {
+        return !isClose_.load(std::memory_order_acquire);
+    }
+    uint32_t val = prepareSleep_(notFull_);
+    if (full() && !isClose_.load(std::memory_order_seq_cst)) {
+        futexWait_(notFull_, val, nullptr);
+    }
+    return !isClose_.load(std::memory_order_acquire);
+}
+
 /**
  * @description: 用在析构函数中，释放资源，关闭前唤醒所有等待的事件
  */
 template <typename T>
 void BlockQueue<T>::close() {
     clear();
-    isClose_ = true;
-    condProducer_.notify_all();
-    condConsumer_.notify_all();
+    isClose_.store(true, std::memory_order_seq_cst);
+    notEmpty_.fetch_add(2, std::memory_order_seq_cst);
+    notFull_.fetch_add(2, std::memory_order_seq_cst);
+    futexWake_(notEmpty_, INT32_MAX);
+    futexWake_(notFull_, INT32_MAX);
 }
 
 /**
@@ -73,9 +249,9 @@ void BlockQueue<T>::close() {
  */
 template <typename T>
 void BlockQueue<T>::clear() {
-    std::lock_guard<std::mutex> locker(mtx_);
-    std::queue<T>               tmp;
-    std::swap(tmp, que_);
+    T item;
+    while (try_pop(item)) {
+    }
 }
 
 /**
@@ -83,90 +259,159 @@ void BlockQueue<T>::clear() {
  */
 template <typename T>
 void BlockQueue<T>::wakeupOneConsumer() {
-    condConsumer_.notify_one();
+    notify_(notEmpty_);
 }
 
+/**
+ * @description: 近似的元素个数，不加锁
+ */
 template <typename T>
 size_t BlockQueue<T>::size() {
-    std::lock_guard<std::mutex> locker(mtx_);
-    return que_.size();
+    size_t deq = deqPos_.load(std::memory_order_acquire);
+    size_t enq = enqPos_.load(std::memory_order_acquire);
+    return enq > deq ? enq - deq : 0;
 }
 
 template <typename T>
 size_t BlockQueue<T>::capacity() {
-    std::lock_guard<std::mutex> locker(mtx_);
-    return capacity_;
+    return mask_ + 1;
 }
 
 template <typename T>
 bool BlockQueue<T>::empty() {
-    std::lock_guard<std::mutex> locker(mtx_);
-    return que_.empty();
+    return size() == 0;
 }
 
 template <typename T>
 bool BlockQueue<T>::full() {
-    std::lock_guard<std::mutex> locker(mtx_);
-    return que_.size() >= capacity_;
+    return size() >= capacity();
 }
 
 /**
- * @description: 向队尾加入一个元素
+ * @description: 非阻塞入队，队列满时返回false，item保持不变
  */
 template <typename T>
-void BlockQueue<T>::push(const T &item) {
-    std::unique_lock<std::mutex> locker(mtx_);
-    /*条件变量控制，如果元素超过了容量，需要阻塞等待消费者消费后才能加入*/
-    while (que_.size() >= capacity_) {
-        /*生产者等待*/
-        condProducer_.wait(locker);
+bool BlockQueue<T>::try_push(T &&item) {
+    size_t pos = enqPos_.load(std::memory_order_relaxed);
+    Slot  *slot;
+    while (true) {
+        slot          = &slots_[pos & mask_];
+        size_t   seq  = slot->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqPos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqPos_.load(std::memory_order_relaxed);
+        }
     }
-    que_.push(item);
-    /*唤醒一个消费者*/
-    condConsumer_.notify_one();
+    new (slot->storage) T(std::move(item));
+    slot->seq.store(pos + 1, std::memory_order_release);
+    notify_(notEmpty_);
+    return true;
 }
 
 /**
- * @description: 在队头弹出一个元素
+ * @description: 向队尾加入一个元素，队列满时阻塞等待消费者消费；队列关闭时返回false
  */
 template <typename T>
-bool BlockQueue<T>::pop(T &item) {
-    std::unique_lock<std::mutex> locker(mtx_);
-    /*如果队列为空，消费者条件变量等待，若关闭变量isClose为true这返回false*/
-    while (que_.empty()) {
-        condConsumer_.wait(locker);
-        if (isClose_) {
+bool BlockQueue<T>::push(T &&item) {
+    while (!try_push(std::move(item))) {
+        if (!waitNotFull_()) {
             return false;
         }
     }
-    item = que_.front();
-    que_.pop();
-    /*唤醒一个生产者*/
-    condProducer_.notify_one();
-
     return true;
 }
 
+template <typename T>
+bool BlockQueue<T>::push(const T &item) {
+    return push(T(item));
+}
+
 /**
- * @description: 在队头弹出一个元素，设有阻塞时间
+ * @description: 非阻塞出队，队列空时返回false
  */
 template <typename T>
-bool BlockQueue<T>::pop(T &item, int timeout) {
-    std::unique_lock<std::mutex> locker(mtx_);
-    while (que_.empty()) {
-        if (condConsumer_.wait_for(locker, std::chrono::seconds(timeout)) ==
-            std::cv_status::timeout) {
+bool BlockQueue<T>::try_pop(T &item) {
+    size_t pos = deqPos_.load(std::memory_order_relaxed);
+    Slot  *slot;
+    while (true) {
+        slot          = &slots_[pos & mask_];
+        size_t   seq  = slot->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0) {
+            if (deqPos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
             return false;
+        } else {
+            pos = deqPos_.load(std::memory_order_relaxed);
         }
-        if (isClose_) {
+    }
+    item = std::move(*slot->item());
+    slot->item()->~T();
+    slot->seq.store(pos + mask_ + 1, std::memory_order_release);
+    notify_(notFull_);
+    return true;
+}
+
+/**
+ * @description: 在队头弹出一个元素，队列为空时阻塞；关闭且为空时返回false
+ */
+template <typename T>
+bool BlockQueue<T>::pop(T &item) {
+    while (!try_pop(item)) {
+        if (isClose_.load(std::memory_order_acquire)) {
             return false;
         }
+        waitNotEmpty_(nullptr);
     }
-    item = que_.front();
-    que_.pop();
-    /*唤醒一个生产者*/
-    condProducer_.notify_one();
+    return true;
+}
 
+/**
+ * @description: 在队头弹出一个元素，设有阻塞时间
+ * @param {int} timeout 秒
+ */
+template <typename T>
+bool BlockQueue<T>::pop(T &item, int timeout) {
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout;
+    while (!try_pop(item)) {
+        if (isClose_.load(std::memory_order_acquire) || !waitNotEmpty_(&deadline)) {
+            return false;
+        }
+    }
     return true;
 }
+
+/**
+ * @description: 阻塞到至少有一个元素，然后一次取出最多max个追加到out，一次唤醒处理一批
+ * @return {size_t} 取出的个数，关闭且为空时返回0
+ */
+template <typename T>
+size_t BlockQueue<T>::pop_batch(std::vector<T> &out, size_t max) {
+    T      item;
+    size_t n = 0;
+    while (n == 0) {
+        while (n < max && try_pop(item)) {
+            out.push_back(std::move(item));
+            n++;
+        }
+        if (n == 0) {
+            if (isClose_.load(std::memory_order_acquire)) {
+                return 0;
+            }
+            waitNotEmpty_(nullptr);
+        }
+    }
+    return n;
+}
+
 #endif  //BLOCKQUEUE_H
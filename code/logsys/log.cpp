@@ -1,15 +1,25 @@
 #include "log.h"
 
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
 Log::Log()
-    : lineCount_(0),
-      today_(0),
+    : fileIdx_(0),
+      today_(-1),
       isOpen_(false),  // isOpen_必须初始化为false，因为可能日志没init
       isAsync_(false),
-      fp_(nullptr),
+      isBinary_(false),
+      rollSec_(-1),
+      rollTm_{},
       que_(nullptr),
       writeThread_(nullptr),
-      curTimeval(nullptr),
-      curTm(nullptr) {}
+      dropped_(0),
+      gzQue_(nullptr),
+      gzThread_(nullptr),
+      spareDay_(-1),
+      spareIdx_(-1),
+      binThread_(nullptr),
+      binStop_(false) {}
 
 /**
  * @description: 初始化Log类对象
@@ -17,59 +27,55 @@ Log::Log()
  * @param {char} *path          文件路径
  * @param {char} *suffix        文件后缀
  * @param {int} maxQueueSize    异步阻塞队列大小
+ * @param {bool} binary         二进制模式，格式化推迟到写线程，此时不使用异步队列
  */
-void Log::init(int level, const char *path, const char *suffix, int maxQueueSize) {
-    isOpen_ = true;
-    level_  = level;
+void Log::init(int level, const char *path, const char *suffix, int maxQueueSize, bool binary) {
+    isOpen_   = true;
+    level_    = level;
+    isBinary_ = binary;
 
     /*如果消息队列大于0，说明启用了异步写入log*/
-    if (maxQueueSize > 0) {
+    if (maxQueueSize > 0 && !binary) {
         /* 开启异步写入 */
         isAsync_ = true;
         if (!que_) {
             /*获取deque_的unique智能指针*/
-            que_ = std::make_unique<BlockQueue<std::string>>();
-            /*创建异步写线程，获取writeThread_的unique智能指针*/
-            writeThread_ = std::make_unique<std::thread>(flushLogThread);
+            que_ = std::make_unique<BlockQueue<std::string>>(maxQueueSize);
         }
     } else {
         /* 未开启异步写入 */
         isAsync_ = false;
     }
 
-    /*从第一行开始*/
-    lineCount_ = 0;
-    /*获取当前时间*/
-    curTimeval = new timeval();
-    curTm      = new tm();
-    updateTime();
     /*初始化文件路径以及后缀名*/
     path_   = path;
     suffix_ = suffix;
-    /*根据 路径+时间+后缀名创建log文件*/
-    char fileName[LOG_NAME_LEN] = {0};
-    snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s", path_, curTm->tm_year + 1900,
-             curTm->tm_mon + 1, curTm->tm_mday, suffix_);
 
-    /*将日期保存到today_变量中*/
-    today_ = curTm->tm_mday;
+    /*写满或换天后关闭的日志段交给低优先级线程关闭并压缩，下一个段也由它预先分配*/
+    if (!gzThread_) {
+        gzQue_    = std::make_unique<BlockQueue<std::function<void()>>>(GZ_QUEUE_SIZE);
+        gzThread_ = std::make_unique<std::thread>([this] { gzipWrite_(); });
+    }
 
     /*创建文件，使用互斥量保证线程安全*/
     {
-        std::lock_guard<std::mutex> locker(mtx_);
-        /*确保buff回收完全*/
-        if (fp_) {
-            flush();
-            fclose(fp_);
-        }
-        /*创建文件目录与文件*/
-        fp_ = fopen(fileName, "a");
-        /*如果未创建成功，说明没有对应的目录，创建目录后再创建文件即可*/
-        if (!fp_) {
-            mkdir(path_, 0777);
-            fp_ = fopen(fileName, "a");
-        }
-        assert(fp_ != nullptr);
+        std::unique_lock<std::shared_mutex> locker(mtx_);
+        /*获取当前时间，根据 路径+时间+后缀名创建log文件*/
+        rollSec_ = time(nullptr);
+        localtime_r(&rollSec_, &rollTm_);
+        today_ = -1;
+        openNewFile_(rollTm_);
+        assert(file_->isOpen());
+    }
+
+    /*文件打开后再创建异步写线程，获取writeThread_的unique智能指针*/
+    if (isAsync_ && !writeThread_) {
+        writeThread_ = std::make_unique<std::thread>(flushLogThread);
+    }
+
+    /*文件打开后再启动二进制模式的写线程*/
+    if (isBinary_ && !binThread_) {
+        binThread_ = std::make_unique<std::thread>([this] { binaryWrite_(); });
     }
 }
 
@@ -82,27 +88,197 @@ Log *Log::instance() {
 }
 
 /**
- * @description: 更新当前时间
+ * @description:异步写线程的工作函数，静态的
+ */
+void Log::flushLogThread() { Log::instance()->asyncWrite_(); }
+
+/**
+ * @description: 循环从阻塞队列取出数据写入磁盘日志文件，只有队列为空时会休眠等待；
+ *               队列满时调用线程丢弃的行数在这里记一条警告
+ */
+void Log::asyncWrite_() {
+    std::vector<std::string> lines;
+    lines.reserve(WRITE_BATCH);
+    Buffer buff(128);
+    /*一次唤醒取出一批，分文件检查由写线程完成，调用线程不再参与*/
+    while (que_->pop_batch(lines, WRITE_BATCH)) {
+        time_t now = time(nullptr);
+        for (const std::string &str : lines) {
+            append_(now, str.data(), str.size());
+        }
+        lines.clear();
+        uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if (dropped) {
+            appendDropped_(buff, dropped, "log queue full, dropped");
+            append_(now, buff.beginRead(), buff.readableBytes());
+            buff.clearAll();
+        }
+    }
+}
+
+/**
+ * @description: 写入一条丢弃了多少条日志的警告
  */
-void Log::updateTime() {
-    gettimeofday(curTimeval, nullptr);
-    time_t tSec = curTimeval->tv_sec;
-    curTm       = localtime(&tSec);
+void Log::appendDropped_(Buffer &buff, uint64_t dropped, const char *what) {
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    appendTime_(buff, tv.tv_sec, tv.tv_usec);
+    appendLogLevelTitle_(buff, 2);
+    char msg[64];
+    int  len = snprintf(msg, sizeof(msg), "%s %llu lines\n", what, static_cast<unsigned long long>(dropped));
+    buff.append(msg, len);
 }
 
 /**
- * @description:异步写线程的工作函数，静态的
+ * @description: 获取当前线程的二进制记录缓冲，首次使用时创建并登记，线程退出时标记为可回收
  */
-void Log::flushLogThread() { Log::instance()->asyncWrite_(); }
+logrec::ThreadRing &Log::threadRing_() {
+    struct Holder {
+        std::shared_ptr<logrec::ThreadRing> ring;
+        ~Holder() {
+            if (ring) {
+                ring->dead.store(true, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Holder holder;
+    if (!holder.ring) {
+        holder.ring = std::make_shared<logrec::ThreadRing>();
+        std::lock_guard<std::mutex> locker(ringMtx_);
+        rings_.push_back(holder.ring);
+    }
+    return *holder.ring;
+}
 
 /**
- * @description: 循环从阻塞队列取出数据写入磁盘日志文件，只有队列为空时会休眠等待
+ * @description: 二进制模式写线程，轮询各线程的记录缓冲，按时间先后取出记录格式化后写入文件；
+ *               收到退出通知后读空所有缓冲才退出
  */
-void Log::asyncWrite_() {
-    std::string str = "";
-    while (que_->pop(str)) {
-        std::lock_guard<std::mutex> locker(mtx_);
-        fputs(str.c_str(), fp_);
+void Log::binaryWrite_() {
+    Buffer                                           buff(BIN_WRITE_LEN * 2);
+    std::vector<std::shared_ptr<logrec::ThreadRing>> rings;
+
+    time_t lastSec = -1;
+    while (true) {
+        bool stop = binStop_.load(std::memory_order_acquire);
+        {
+            std::lock_guard<std::mutex> locker(ringMtx_);
+            rings = rings_;
+        }
+
+        size_t n = 0;
+        while (true) {
+            /*多个线程的记录按时间归并*/
+            logrec::ThreadRing         *src   = nullptr;
+            const logrec::RecordHeader *first = nullptr;
+            for (auto &ring : rings) {
+                const logrec::RecordHeader *rec = ring->peek();
+                if (rec && (!first || rec->ts.tv_sec < first->ts.tv_sec ||
+                            (rec->ts.tv_sec == first->ts.tv_sec &&
+                             rec->ts.tv_nsec < first->ts.tv_nsec))) {
+                    first = rec;
+                    src   = ring.get();
+                }
+            }
+            if (!first) {
+                break;
+            }
+            if (first->ts.tv_sec != lastSec) {
+                /*可能换天，先把攒下的日志写入旧文件*/
+                lastSec = first->ts.tv_sec;
+                writeOut_(buff);
+                std::unique_lock<std::shared_mutex> locker(mtx_);
+                rollFile_(lastSec, 0);
+            }
+            if (first->level != RAW_LEVEL) {
+                appendTime_(buff, first->ts.tv_sec, first->ts.tv_nsec / 1000);
+                appendLogLevelTitle_(buff, first->level);
+            }
+            logrec::format(first, buff);
+            buff.append("\n", 1);
+            src->release(first);
+            if (++n % 256 == 0 && buff.readableBytes() >= BIN_WRITE_LEN) {
+                writeOut_(buff);
+            }
+        }
+
+        uint64_t dropped = 0;
+        for (auto &ring : rings) {
+            dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+        }
+        if (dropped) {
+            appendDropped_(buff, dropped, "binary log dropped");
+        }
+        writeOut_(buff);
+
+        /*回收已退出且读空的线程缓冲*/
+        {
+            std::lock_guard<std::mutex> locker(ringMtx_);
+            for (auto it = rings_.begin(); it != rings_.end();) {
+                if ((*it)->dead.load(std::memory_order_acquire) && !(*it)->peek()) {
+                    it = rings_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        rings.clear();
+
+        if (n == 0 && !dropped) {
+            if (stop) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(BIN_POLL_MS));
+        }
+    }
+}
+
+/**
+ * @description: 把写线程攒下的日志写入文件，当前日志段放不下时先滚动到新段；换天已在写入前检查过
+ */
+void Log::writeOut_(Buffer &buff) {
+    if (!buff.readableBytes()) {
+        return;
+    }
+    append_(0, buff.beginRead(), buff.readableBytes());
+    buff.clearAll();
+}
+
+/**
+ * @description: 后台线程，降低CPU与I/O优先级后逐个执行任务：关闭并压缩旧段、预先分配下一个段
+ */
+void Log::gzipWrite_() {
+    pid_t tid = syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, tid, 19);
+    /*IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE*/
+    syscall(SYS_ioprio_set, 1, tid, 3 << 13);
+
+    std::function<void()> task;
+    while (gzQue_->pop(task)) {
+        task();
+        task = nullptr;
+    }
+}
+
+/**
+ * @description: 通知后台线程退出，正在执行的任务会先完成，未压缩的日志段保持原样，
+ *               队列中的旧段在清空队列时关闭
+ */
+void Log::stopGzip_() {
+    if (gzThread_ && gzThread_->joinable()) {
+        gzQue_->close();
+        gzThread_->join();
+        gzQue_.reset();
+    }
+}
+
+/**
+ * @description: 通知二进制写线程读空缓冲后退出
+ */
+void Log::stopBinary_() {
+    if (binThread_ && binThread_->joinable()) {
+        binStop_.store(true, std::memory_order_release);
+        binThread_->join();
     }
 }
 
@@ -110,6 +286,7 @@ void Log::asyncWrite_() {
  * @description: 在析构时将所有log信息写入文件，再关闭写入线程，关闭文件
  */
 Log::~Log() {
+    stopBinary_();
     if (writeThread_ && writeThread_->joinable()) {
         while (!que_->empty()) {
             que_->wakeupOneConsumer();  // 唤醒一个消费者执行任务
@@ -117,10 +294,16 @@ Log::~Log() {
         que_->close();
         writeThread_->join();  // 回收子线程
     }
-    if (fp_) {
-        std::lock_guard<std::mutex> locker(mtx_);
-        flush();
-        fclose(fp_);
+    {
+        std::unique_lock<std::shared_mutex> locker(mtx_);
+        if (file_) {
+            file_->close();
+        }
+    }
+    stopGzip_();
+    /*没有用上的预分配段*/
+    if (spare_) {
+        retire_(std::move(spare_), false);
     }
     isOpen_ = false;
 }
@@ -133,120 +316,335 @@ void Log::flush() {
         /*如果是异步模式，需要将整个队列都写入*/
         que_->wakeupOneConsumer();
     }
-    /*刷新文件缓冲区*/
-    fflush(fp_);  // fflush()会强迫将系统缓冲区内的数据写回参数stream 指定的文件中
+    /*日志段是共享映射，写入后即在页缓存中，由内核回写，不需要fflush*/
 }
 
 bool Log::isOpen() { return isOpen_; }
 
 int Log::getLevel() { return level_; }
 
+bool Log::isBinary() { return isBinary_; }
+
+/**
+ * @description: 向缓冲区中加入时间信息，每个线程缓存格式化好的日期与秒，
+ *               秒数不变时只需手工写入6位微秒，不调用localtime_r与snprintf
+ * @param {Buffer} &buff
+ * @param {time_t} sec
+ * @param {long} usec
+ */
+void Log::appendTime_(Buffer &buff, time_t sec, long usec) {
+    struct TimeCache {
+        time_t sec = -1;
+        int    len = 0;
+        char   text[40];  // "YYYY-MM-DD HH:MM:SS.uuuuuu "
+    };
+    thread_local TimeCache cache;
+
+    if (cache.sec != sec) {
+        tm t;
+        localtime_r(&sec, &t);
+        cache.len = snprintf(cache.text, sizeof(cache.text), "%d-%02d-%02d %02d:%02d:%02d.",
+                             t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min,
+                             t.tm_sec);
+        cache.text[cache.len + 6] = ' ';
+        cache.sec                 = sec;
+    }
+    char *p = cache.text + cache.len + 6;
+    for (int i = 0; i < 6; i++) {
+        *--p = '0' + usec % 10;
+        usec /= 10;
+    }
+    buff.append(cache.text, cache.len + 7);
+}
+
 /**
  * @description: 向缓冲区中加入log的级别信息
+ * @param {Buffer} &buff
  * @param {int} level
  */
-void Log::appendLogLevelTitle_(int level) {
+void Log::appendLogLevelTitle_(Buffer &buff, int level) {
     switch (level) {
         case 0:
-            buff_.append("[debug]: ", 9);
+            buff.append("[debug]: ", 9);
             break;
         case 1:
-            buff_.append("[info]:  ", 9);
+            buff.append("[info]:  ", 9);
             break;
         case 2:
-            buff_.append("[warn]:  ", 9);
+            buff.append("[warn]:  ", 9);
             break;
         case 3:
-            buff_.append("[error]: ", 9);
+            buff.append("[error]: ", 9);
             break;
         default:
-            buff_.append("[info]:  ", 9);
+            buff.append("[info]:  ", 9);
             break;
     }
 }
 
 /**
- * @description: 按天记录、超行分文件
+ * @description: 追加到当前日志段：持共享锁用fetch_add预留空间，多个写入方可以同时拷贝；
+ *               时间进入新的一秒或段已写满时才取独占锁检查换天、滚动到新段
+ * @param {time_t} sec 这条日志的时间，0表示不检查换天
+ */
+void Log::append_(time_t sec, const char *data, size_t len) {
+    {
+        std::shared_lock<std::shared_mutex> locker(mtx_);
+        if (sec <= rollSec_ && file_->append(data, len)) {
+            return;
+        }
+    }
+    std::unique_lock<std::shared_mutex> locker(mtx_);
+    rollFile_(sec, len);
+    file_->append(data, len);
+}
+
+/**
+ * @description: 按天、按大小分文件，只由写入文件的一方在持有mtx_独占锁时调用
+ * @param {time_t} sec 当前时间，不晚于已检查过的时间时只按大小分文件
+ * @param {size_t} len 接下来要写入的字节数
+ */
+void Log::rollFile_(time_t sec, size_t len) {
+    if (sec > rollSec_) {
+        rollSec_ = sec;
+        localtime_r(&sec, &rollTm_);
+    }
+    /*日期变化了，也就是到第二天了，或者当前日志段放不下时都需要创建一个新的日志段*/
+    if (today_ != rollTm_.tm_mday || !file_->fits(len)) {
+        openNewFile_(rollTm_);
+    }
+}
+
+/**
+ * @description: 日志段的文件名，同一天的第二个及之后的段带上段号
+ */
+std::string Log::fileName_(const tm &t, int idx) const {
+    char name[LOG_NAME_LEN];
+    if (idx == 0) {
+        snprintf(name, LOG_NAME_LEN - 72, "%s/%04d_%02d_%02d%s", path_, t.tm_year + 1900, t.tm_mon + 1,
+                 t.tm_mday, suffix_);
+    } else {
+        snprintf(name, LOG_NAME_LEN - 72, "%s/%04d_%02d_%02d-%d%s", path_, t.tm_year + 1900, t.tm_mon + 1,
+                 t.tm_mday, idx, suffix_);
+    }
+    return name;
+}
+
+/**
+ * @description: 换上新的日志段，调用者持有mtx_独占锁。后台线程预先打开的段正好是下一个段时直接换上，
+ *               旧段的截断与解除映射交给后台线程；否则就地打开，跳过已经压缩过、已写满或预留给后台线程的段，
+ *               重启后同一天的日志接着写入未写满的段。换上后让后台线程预先分配再下一个段
+ * @param {tm} &t
  */
-void Log::adjustFile() {
-    /*如果日期变了，也就是到第二天了，或者当前log文件行数达到规定的最大值时都需要创建一个新的log文件*/
-    if (today_ != curTm->tm_mday || (lineCount_ && (lineCount_ % MAX_LINES) == 0)) {
-        /*最终文件路径存储变量*/
-        char newFile[LOG_NAME_LEN];
-        char tail[36] = {0};
-        /*根据时间获取文件名*/
-        snprintf(tail, 36, "%04d_%02d_%02d", curTm->tm_year + 1900, curTm->tm_mon + 1,
-                 curTm->tm_mday);
+void Log::openNewFile_(const tm &t) {
+    std::shared_ptr<LogFile> closed = std::move(file_);
+
+    if (today_ != t.tm_mday) {
+        /*日期变化了，更新today变量并从当天的第一个段开始*/
+        today_   = t.tm_mday;
+        fileIdx_ = 0;
+    } else {
+        fileIdx_++;
+    }
+
+    std::shared_ptr<LogFile> stale;
+    int                      reservedDay, reservedIdx;
+    {
+        std::lock_guard<std::mutex> locker(spareMtx_);
+        if (spareDay_ == today_ && spareIdx_ == fileIdx_ && spare_) {
+            file_     = std::move(spare_);
+            spareIdx_ = -1;
+        } else if (spare_) {
+            /*换天后没用上的预分配段*/
+            stale     = std::move(spare_);
+            spareIdx_ = -1;
+        }
+        reservedDay = spareDay_;
+        reservedIdx = spareIdx_;
+    }
+    if (stale) {
+        retire_(std::move(stale), false);
+    }
+
+    if (!file_) {
+        /*没有预分配好的段，就地打开；先关闭旧段，重新init时可能打开的是同一个文件*/
+        std::string closedPath;
+        if (closed) {
+            closedPath = closed->path();
+            closed->close();
+            closed.reset();
+        }
+        file_ = std::make_shared<LogFile>();
+        mkdir(path_, 0777);
+        for (; fileIdx_ < MAX_FILE_IDX; fileIdx_++) {
+            if (reservedDay == today_ && reservedIdx == fileIdx_) {
+                /*后台线程正在打开这个段*/
+                continue;
+            }
+            std::string name = fileName_(t, fileIdx_);
+            if (access((name + ".gz").c_str(), F_OK) == 0) {
+                continue;
+            }
+            if (file_->open(name) && file_->fits(BIN_WRITE_LEN)) {
+                break;
+            }
+            file_->close();
+        }
+        if (!closedPath.empty() && closedPath != file_->path() && gzQue_) {
+            /*压缩跟不上时该段保持不压缩*/
+            gzQue_->try_push([closedPath] { LogFile::gzip(closedPath); });
+        }
+    }
 
-        if (today_ != curTm->tm_mday) {
-            /*日期变化了，拼接 path_ tail suffix_ 获取最新文件名*/
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
-            /*更新today变量*/
-            today_ = curTm->tm_mday;
-            /*重置文件行计数变量*/
-            lineCount_ = 0;
-        } else {
-            /*进入到此分支表示文件行数超过了最大行数，需要分出第二个log文件来存储今日的文件*/
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", path_, tail,
-                     (lineCount_ / MAX_LINES), suffix_);
+    /*先预分配下一个段，排在旧段的压缩之前*/
+    prepareSpare_(t);
+    if (closed) {
+        retire_(std::move(closed), true);
+    }
+}
+
+/**
+ * @description: 让后台线程预先分配并映射当天的下一个段，写满时滚动只需换上它；调用者持有mtx_独占锁
+ *              段号在这里预留，打开期间写入端不会再打开同一个文件，预留已变化时后台线程丢弃打开的段
+ * @param {tm} &t 当前段的日期
+ */
+void Log::prepareSpare_(const tm &t) {
+    if (!gzQue_ || fileIdx_ + 1 >= MAX_FILE_IDX) {
+        return;
+    }
+    int         day  = today_;
+    int         idx  = fileIdx_ + 1;
+    std::string name = fileName_(t, idx);
+    {
+        std::lock_guard<std::mutex> locker(spareMtx_);
+        spareDay_ = day;
+        spareIdx_ = idx;
+    }
+    bool queued = gzQue_->try_push([this, day, idx, name] {
+        auto file   = std::make_shared<LogFile>();
+        bool opened = access((name + ".gz").c_str(), F_OK) != 0 && file->open(name);
+        {
+            std::lock_guard<std::mutex> locker(spareMtx_);
+            if (spareDay_ == day && spareIdx_ == idx) {
+                if (opened && file->fits(BIN_WRITE_LEN)) {
+                    spare_ = std::move(file);
+                    return;
+                }
+                spareIdx_ = -1;
+            }
+        }
+        if (opened) {
+            retire_(std::move(file), false);
         }
+    });
+    if (!queued) {
+        std::lock_guard<std::mutex> locker(spareMtx_);
+        spareIdx_ = -1;
+    }
+}
 
-        /*创建文件时上锁，保证线程安全*/
-        std::unique_lock<std::mutex> locker(mtx_);
-        /*将缓冲区的数据写入到之前的文件中*/
-        flush();
-        /*关闭上一个文件*/
-        fclose(fp_);
-        /*根据上面操作得到的文件名创建新的log文件，将指针赋值给fp_变量*/
-        fp_ = fopen(newFile, "a");
-        assert(fp_ != nullptr);
+/**
+ * @description: 交给后台线程关闭日志段：截掉预分配的空间、解除映射，需要时再压缩；没有用上的空段直接删除。
+ *              队列满时就地关闭，该段保持不压缩
+ * @param {bool} compress 写过的旧段为true，没有用上的预分配段为false
+ */
+void Log::retire_(std::shared_ptr<LogFile> file, bool compress) {
+    auto task = [file, compress] {
+        std::string path   = file->path();
+        bool        unused = !compress && file->isOpen() && file->size() == 0;
+        file->close();
+        if (compress) {
+            LogFile::gzip(path);
+        } else if (unused) {
+            unlink(path.c_str());
+        }
+    };
+    if (gzQue_ && gzQue_->try_push(task)) {
+        return;
+    }
+    if (compress) {
+        file->close();
+    } else {
+        task();
     }
 }
 
 /**
- * @description: 向log文件中写入log信息，写入前践行分类策略
+ * @description: 向log文件中写入log信息，调用线程只在线程私有的缓冲区中格式化，
+ *               同步模式下才由调用线程追加到日志段
  * @param {int} level
  * @param {char} *format
  */
 void Log::write(int level, const char *format, ...) {
-    updateTime();
-    adjustFile();
-
-    /* ... 使用的可变参数列表*/
-    va_list vaList;
-
-    /*上锁，保证线程安全*/
-    std::unique_lock<std::mutex> locker(mtx_);
+    timeval tv;
+    gettimeofday(&tv, nullptr);
 
-    lineCount_++;
+    thread_local Buffer buff;
 
     /*组装信息至缓冲区buff中*/
-    int n = snprintf(buff_.beginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
-                     curTm->tm_year + 1900, curTm->tm_mon + 1, curTm->tm_mday, curTm->tm_hour,
-                     curTm->tm_min, curTm->tm_sec, curTimeval->tv_usec);
-    buff_.hasWritten(n);
+    appendTime_(buff, tv.tv_sec, tv.tv_usec);
     /*向缓冲区中写入日志级别信息*/
-    appendLogLevelTitle_(level);
+    appendLogLevelTitle_(buff, level);
 
+    /* ... 使用的可变参数列表*/
+    va_list vaList;
     /*根据用户传入的参数，向缓冲区添加数据*/
-    va_start(vaList, format);  
+    va_start(vaList, format);
     // 这里format指形参类型是const char*
     // 可变参数宏通过分析第一个字符串参数中的占位符个数来确定形参的个数；
     // 通过占位符的不同来确定参数类型（%d表示int类型、%s表示char *）
-    int m = vsnprintf(buff_.beginWrite(), buff_.writableBytes(), format, vaList);
+    int m = vsnprintf(buff.beginWrite(), buff.writableBytes(), format, vaList);
     va_end(vaList);
-    buff_.hasWritten(m);
+    if (m > 0 && static_cast<size_t>(m) >= buff.writableBytes()) {
+        /*空间不够，扩容后重新格式化*/
+        buff.ensureWritable(m + 1);
+        va_start(vaList, format);
+        vsnprintf(buff.beginWrite(), buff.writableBytes(), format, vaList);
+        va_end(vaList);
+    }
+    buff.hasWritten(m > 0 ? m : 0);
     /*行尾写入换行符*/
-    buff_.append("\n\0", 2);
+    buff.append("\n", 1);
 
-    /*根据变量选择是否异步写入*/
-    if (isAsync_ && que_ && !que_->full()) {
-        /*如果以上三个条件都满足，那么进行异步写入*/
-        que_->push(buff_.retrieveAllToStr());
+    /*异步模式下队列满时不等待，也不在调用线程中写文件或滚动日志段，丢弃这一行并计数；同步模式直接追加*/
+    if (isAsync_ && que_) {
+        if (!que_->try_push(std::string(buff.beginRead(), buff.readableBytes()))) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
     } else {
-        /*否则直接写入至文件*/
-        fputs(buff_.beginRead(), fp_);
+        append_(tv.tv_sec, buff.beginRead(), buff.readableBytes());
     }
     /*回收所有空间*/
-    buff_.clearAll();
+    buff.clearAll();
+}
+
+/**
+ * @description: 原样写入一行，不加时间与级别前缀，不受日志级别限制，用于访问日志等结构化记录；
+ *               与普通日志走同一条写入路径
+ * @param {char} *line 不含换行符
+ * @param {size_t} len
+ */
+void Log::writeRaw(const char *line, size_t len) {
+    if (!isOpen_) {
+        return;
+    }
+    if (isBinary_) {
+        /*二进制模式下作为一个字符串参数拷贝进环形缓冲*/
+        thread_local std::string str;
+        str.assign(line, len);
+        record(RAW_LEVEL, "%s", str.c_str());
+        return;
+    }
+
+    std::string str;
+    str.reserve(len + 1);
+    str.append(line, len);
+    str.push_back('\n');
+    if (isAsync_ && que_) {
+        if (!que_->try_push(std::move(str))) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+    } else {
+        append_(time(nullptr), str.data(), str.size());
+    }
 }
@@ -12,76 +12,137 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "../buffer/buffer.h"
 #include "blockqueue.h"
+#include "logfile.h"
+#include "logrecord.h"
+
+/* 编译期日志级别，低于它的日志调用在编译时被整体去掉，例如 -DLOG_COMPILE_LEVEL=1 去掉debug日志 */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
 
 class Log {
 private:
-    static const int LOG_PATH_LEN = 256;    // 最大log文件路径长度
-    static const int LOG_NAME_LEN = 256;    // 最大log文件名长度
-    static const int MAX_LINES    = 50000;  // log文件最大行数，超过就单独划分文件
+    static const int LOG_PATH_LEN  = 256;   // 最大log文件路径长度
+    static const int LOG_NAME_LEN  = 256;   // 最大log文件名长度
+    static const int MAX_FILE_IDX  = 1000;  // 同一天内最多的日志段数量
 
     const char *path_;    // log文件路径
     const char *suffix_;  // 文件后缀名
 
-    int  lineCount_;  // 当前log文件行数
+    int  fileIdx_;    // 当天的第几个日志段
     int  today_;      // 本月的哪一天
     int  level_;      // 日志级别
     bool isOpen_;     // 是否开启
     bool isAsync_;    // 是否异步模式
+    bool isBinary_;   // 是否二进制模式，调用线程只记录原始参数，由写线程格式化
 
-    FILE  *fp_;    // log文件流
-    Buffer buff_;  // 缓冲区
+    std::shared_ptr<LogFile> file_;     // 当前写入的日志段
+    time_t                   rollSec_;  // 写入端最近一次检查分文件时的秒数
+    tm                       rollTm_;   // rollSec_对应的本地时间
 
     std::unique_ptr<BlockQueue<std::string>> que_;          // log信息阻塞队列
     std::unique_ptr<std::thread>             writeThread_;  // 写入日志的线程
-    std::mutex                               mtx_;          // 互斥量
+    std::shared_mutex                        mtx_;          // 追加持共享锁，滚动日志段持独占锁
+    std::atomic<uint64_t>                    dropped_;      // 异步队列满时丢弃的行数，由写线程记入日志
+
+    std::unique_ptr<BlockQueue<std::function<void()>>> gzQue_;     // 后台任务：关闭并压缩旧段、预先打开下一个段
+    std::unique_ptr<std::thread>                       gzThread_;  // 低优先级的后台线程
 
-    timeval *curTimeval;  // 当前时间，为了获取毫秒
-    tm      *curTm;       // 当前时间结构体
+    std::mutex               spareMtx_;  // 保护以下三项
+    std::shared_ptr<LogFile> spare_;     // 后台线程预先分配并映射好的下一个日志段
+    int                      spareDay_;  // 预留给spare_的日期与段号，写入端滚动时不会重复打开它
+    int                      spareIdx_;  // -1表示没有预留
+
+    std::vector<std::shared_ptr<logrec::ThreadRing>> rings_;      // 各线程的二进制记录缓冲
+    std::mutex                                       ringMtx_;    // 保护rings_
+    std::unique_ptr<std::thread>                     binThread_;  // 二进制模式的格式化写线程
+    std::atomic<bool>                                binStop_;    // 通知写线程读空后退出
 
 private:
     Log();
     virtual ~Log();
 
-    void appendLogLevelTitle_(int level);
+    static const int RAW_LEVEL     = 4;          // 原样写入的行，不加时间与级别前缀
+    static const int BIN_POLL_MS   = 2;          // 二进制模式写线程空闲时的轮询间隔
+    static const int BIN_WRITE_LEN = 64 * 1024;  // 写线程攒够这么多字节就写一次文件
+    static const int WRITE_BATCH   = 256;        // 异步写线程一次从队列取出的最多行数
+    static const int GZ_QUEUE_SIZE = 64;         // 等待执行的后台任务数量上限
+
+    static void appendLogLevelTitle_(Buffer &buff, int level);
+    static void appendTime_(Buffer &buff, time_t sec, long usec);
 
-    void adjustFile();
+    void        append_(time_t sec, const char *data, size_t len);
+    void        rollFile_(time_t sec, size_t len);
+    void        openNewFile_(const tm &t);
+    std::string fileName_(const tm &t, int idx) const;
+    void        prepareSpare_(const tm &t);
+    void        retire_(std::shared_ptr<LogFile> file, bool compress);
 
-    void updateTime();
+    void gzipWrite_();
+    void stopGzip_();
+
+    static void appendDropped_(Buffer &buff, uint64_t dropped, const char *what);
 
     void        asyncWrite_();
     static void flushLogThread();  // 异步时写线程工作函数，必须是静态的
 
+    logrec::ThreadRing &threadRing_();
+    void                binaryWrite_();
+    void                writeOut_(Buffer &buff);
+    void                stopBinary_();
+
 public:
     void init(int level = 1, const char *path = "./log", const char *suffix = ".log",
-              int maxQueueSize = 1024);
+              int maxQueueSize = 1024, bool binary = false);
 
     static Log *instance();
 
     void write(int level, const char *format, ...);
+    void writeRaw(const char *line, size_t len);
+
+    /**
+     * @description: 二进制模式下记录一条日志，只拷贝格式串地址与参数，不做格式化
+     */
+    template <class... Args>
+    void record(int level, const char *format, Args... args) {
+        logrec::encode(threadRing_(), level, format, args...);
+    }
 
     void flush();
 
     int  getLevel();
     bool isOpen();
+    bool isBinary();
 };
 
 /**
  * @description: 定义log日志相关的宏，按照日志等级写入日志信息；为什么写成do while(0); ?
  * @return {*}
  */
-#define LOG_BASE(level, format, ...)                     \
-    do {                                                 \
-        Log *log = Log::instance();                      \
-        if (log->isOpen() && log->getLevel() <= level) { \
-            log->write(level, format, ##__VA_ARGS__);    \
-            log->flush();                                \
-        }                                                \
+#define LOG_BASE(level, format, ...)                             \
+    do {                                                         \
+        if constexpr ((level) >= LOG_COMPILE_LEVEL) {            \
+            Log *log = Log::instance();                          \
+            if (log->isOpen() && log->getLevel() <= level) {     \
+                if (log->isBinary()) {                           \
+                    log->record(level, format, ##__VA_ARGS__);   \
+                } else {                                         \
+                    log->write(level, format, ##__VA_ARGS__);    \
+                    log->flush();                                \
+                }                                                \
+            }                                                    \
+        }                                                        \
     } while (0);
 
 #define LOG_DEBUG(format, ...)             \
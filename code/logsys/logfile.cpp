@@ -0,0 +1,152 @@
+#include "logfile.h"
+
+#include <stdio.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+LogFile::LogFile() : fd_(-1), data_(nullptr), offset_(0) {}
+
+LogFile::~LogFile() { close(); }
+
+/**
+ * @description: 打开日志段，不足SEGMENT_SIZE时用fallocate预分配再整体映射；
+ *               文件已存在时从最后一个非0字节之后继续写，异常退出留下的预分配空洞也能接上
+ * @param {string} &path
+ * @return {bool} 成功返回true
+ */
+bool LogFile::open(const std::string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) > SEGMENT_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    /*预分配磁盘块，写入时不会因为分配空间或SIGBUS失败*/
+    if (posix_fallocate(fd, 0, SEGMENT_SIZE) != 0) {
+        ::close(fd);
+        return false;
+    }
+    void *addr = mmap(nullptr, SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    madvise(addr, SEGMENT_SIZE, MADV_SEQUENTIAL);
+
+    size_t end = st.st_size;
+    while (end > 0 && static_cast<char *>(addr)[end - 1] == '\0') {
+        end--;
+    }
+    fd_    = fd;
+    data_  = static_cast<char *>(addr);
+    path_  = path;
+    offset_.store(end, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @description: 截掉预分配但未写入的部分，解除映射并关闭文件；调用者保证已没有追加方在写入
+ */
+void LogFile::close() {
+    if (fd_ < 0) {
+        return;
+    }
+    /*放不下而未写入的预留在段尾留下0字节，一并截掉*/
+    size_t end = size();
+    while (end > 0 && data_[end - 1] == '\0') {
+        end--;
+    }
+    munmap(data_, SEGMENT_SIZE);
+    if (ftruncate(fd_, end) < 0) {
+        /*截断失败时文件尾部留有0字节，下次打开时会跳过*/
+    }
+    ::close(fd_);
+    fd_   = -1;
+    data_ = nullptr;
+    offset_.store(0, std::memory_order_release);
+}
+
+/**
+ * @description: 剩余空间能否放下len字节
+ */
+bool LogFile::fits(size_t len) const {
+    return fd_ >= 0 && offset_.load(std::memory_order_relaxed) + len <= SEGMENT_SIZE;
+}
+
+/**
+ * @description: 用fetch_add预留len字节再拷贝，多个线程可以同时追加；调用者持有日志的共享锁，保证拷贝期间段不会被关闭
+ * @return {bool} 剩余空间放不下时不写入，返回false，由调用者滚动到新段
+ */
+bool LogFile::append(const char *data, size_t len) {
+    if (fd_ < 0) {
+        return false;
+    }
+    size_t off = offset_.fetch_add(len, std::memory_order_relaxed);
+    if (off + len > SEGMENT_SIZE) {
+        return false;
+    }
+    memcpy(data_ + off, data, len);
+    return true;
+}
+
+bool LogFile::isOpen() const { return fd_ >= 0; }
+
+size_t LogFile::size() const { return std::min(offset_.load(std::memory_order_acquire), SEGMENT_SIZE); }
+
+const std::string &LogFile::path() const { return path_; }
+
+/**
+ * @description: 把已关闭的日志段压缩为path.gz，成功后删除原文件；先写临时文件再改名，
+ *               中途退出不会留下不完整的.gz
+ * @param {string} &path
+ * @return {bool}
+ */
+bool LogFile::gzip(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        ::close(fd);
+        return false;
+    }
+    std::string tmp = path + ".gz.tmp";
+    gzFile      gz  = gzopen(tmp.c_str(), "wb6");
+    if (!gz) {
+        ::close(fd);
+        return false;
+    }
+    bool ok = true;
+    if (st.st_size > 0) {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            ok = false;
+        } else {
+            madvise(addr, st.st_size, MADV_SEQUENTIAL);
+            /*gzwrite的长度参数是unsigned，分块写入*/
+            const char *p    = static_cast<const char *>(addr);
+            size_t      left = st.st_size;
+            while (ok && left > 0) {
+                unsigned n = std::min<size_t>(left, 1 << 20);
+                ok         = gzwrite(gz, p, n) == static_cast<int>(n);
+                p += n;
+                left -= n;
+            }
+            munmap(addr, st.st_size);
+        }
+    }
+    ::close(fd);
+    ok = gzclose(gz) == Z_OK && ok;
+    if (!ok || rename(tmp.c_str(), (path + ".gz").c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    unlink(path.c_str());
+    return true;
+}
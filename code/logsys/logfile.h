@@ -0,0 +1,48 @@
+/*
+ * @Description  : 内存映射的日志段文件，预分配固定大小后顺序追加，写满或换天时由日志类滚动到新段
+ * @Date         : 2026-10-18 16:40:51
+ * @LastEditTime : 2026-10-19 06:41:08
+ */
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+
+class LogFile {
+public:
+    static const size_t SEGMENT_SIZE = 64 * 1024 * 1024;  // 每个日志段的大小
+
+private:
+    int                 fd_;
+    char               *data_;    // 映射的起始地址
+    std::atomic<size_t> offset_;  // 已预留的字节数，追加方用fetch_add预留，放不下时会超过SEGMENT_SIZE
+    std::string         path_;
+
+public:
+    LogFile();
+    ~LogFile();
+
+    LogFile(const LogFile &)            = delete;
+    LogFile &operator=(const LogFile &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    bool fits(size_t len) const;
+    bool append(const char *data, size_t len);
+
+    bool               isOpen() const;
+    size_t             size() const;
+    const std::string &path() const;
+
+    static bool gzip(const std::string &path);
+};
+
+#endif  //LOGFILE_H
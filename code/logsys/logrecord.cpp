@@ -0,0 +1,212 @@
+#include "logrecord.h"
+
+#include <stdio.h>
+
+namespace logrec {
+
+/**
+ * @description: 预留len字节的连续空间，尾部不够时写入回绕标记从头开始，空间不足返回nullptr
+ */
+char *ThreadRing::reserve(size_t len) {
+    size_t h      = head.load(std::memory_order_relaxed);
+    size_t t      = tail.load(std::memory_order_acquire);
+    size_t off    = h & (CAPACITY - 1);
+    size_t contig = CAPACITY - off;
+    size_t need   = contig < len ? contig + len : len;
+    if (len > UINT32_MAX || CAPACITY - (h - t) < need) {
+        return nullptr;
+    }
+    if (contig < len) {
+        /*记录总是8字节对齐，尾部至少剩8字节，足够放下回绕标记*/
+        uint32_t wrap = 0;
+        memcpy(&buf[off], &wrap, sizeof(wrap));
+        skip = contig;
+        return &buf[0];
+    }
+    skip = 0;
+    return &buf[off];
+}
+
+/**
+ * @description: 记录写完后发布给消费者
+ */
+void ThreadRing::commit(size_t len) {
+    head.store(head.load(std::memory_order_relaxed) + skip + len, std::memory_order_release);
+}
+
+/**
+ * @description: 消费者查看下一条记录，没有则返回nullptr
+ */
+const RecordHeader *ThreadRing::peek() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    if (t == h) {
+        return nullptr;
+    }
+    size_t   off = t & (CAPACITY - 1);
+    uint32_t len;
+    memcpy(&len, &buf[off], sizeof(len));
+    if (len == 0) {
+        /*回绕标记，跳到缓冲区开头*/
+        t += CAPACITY - off;
+        tail.store(t, std::memory_order_release);
+        if (t == h) {
+            return nullptr;
+        }
+        off = 0;
+    }
+    return reinterpret_cast<const RecordHeader *>(&buf[off]);
+}
+
+/**
+ * @description: 消费者处理完记录后归还空间
+ */
+void ThreadRing::release(const RecordHeader *rec) {
+    tail.store(tail.load(std::memory_order_relaxed) + rec->len, std::memory_order_release);
+}
+
+/**
+ * @description: 按格式说明把一个值追加到缓冲区，空间不够时扩容后重试
+ */
+template <class T>
+static void appendFormat(Buffer &buff, const char *spec, T value) {
+    int n = snprintf(buff.beginWrite(), buff.writableBytes(), spec, value);
+    if (n < 0) {
+        return;
+    }
+    if (static_cast<size_t>(n) >= buff.writableBytes()) {
+        buff.ensureWritable(n + 1);
+        snprintf(buff.beginWrite(), buff.writableBytes(), spec, value);
+    }
+    buff.hasWritten(n);
+}
+
+/**
+ * @description: 解析格式串中的每个转换说明，去掉长度修饰后按记录中保存的参数类型重新组装，
+ *               整数统一按long long输出，因此调用点的h、l、z等修饰不会影响解码
+ * @param {RecordHeader} *rec
+ * @param {Buffer} &buff
+ */
+void format(const RecordHeader *rec, Buffer &buff) {
+    const uint8_t *types = reinterpret_cast<const uint8_t *>(rec + 1);
+    const char    *arg   = reinterpret_cast<const char *>(rec + 1) + align8(rec->argc);
+    int            idx   = 0;
+
+    const char *lit = rec->fmt;
+    const char *p   = rec->fmt;
+    while (*p) {
+        if (*p != '%') {
+            ++p;
+            continue;
+        }
+        buff.append(lit, p - lit);
+        if (p[1] == '%') {
+            buff.append("%", 1);
+            p += 2;
+            lit = p;
+            continue;
+        }
+
+        /*标志、宽度、精度原样保留，长度修饰丢弃*/
+        const char *s = p + 1;
+        while (*s && strchr("-+ #0", *s)) {
+            ++s;
+        }
+        while ((*s >= '0' && *s <= '9') || *s == '.') {
+            ++s;
+        }
+        size_t flagLen = s - (p + 1);
+        while (*s && strchr("hlLqjzt", *s)) {
+            ++s;
+        }
+        char conv = *s;
+        if (!conv || flagLen > 16 || idx >= rec->argc) {
+            /*格式串与参数不匹配，剩余部分原样输出*/
+            break;
+        }
+        ++s;
+
+        /*取出参数*/
+        int64_t     i   = 0;
+        uint64_t    u   = 0;
+        double      d   = 0;
+        const char *str = nullptr;
+        const void *ptr = nullptr;
+        switch (types[idx++]) {
+            case STR: {
+                uint32_t n;
+                memcpy(&n, arg, sizeof(n));
+                str = arg + 4;
+                arg += align8(4 + n + 1);
+                break;
+            }
+            case DOUBLE:
+                memcpy(&d, arg, 8);
+                i = static_cast<int64_t>(d);
+                u = static_cast<uint64_t>(d);
+                arg += 8;
+                break;
+            case PTR:
+                memcpy(&ptr, arg, 8);
+                u = reinterpret_cast<uintptr_t>(ptr);
+                arg += 8;
+                break;
+            default:
+                memcpy(&i, arg, 8);
+                u = static_cast<uint64_t>(i);
+                d = types[idx - 1] == INT ? static_cast<double>(i) : static_cast<double>(u);
+                arg += 8;
+                break;
+        }
+
+        char spec[24] = {'%'};
+        memcpy(spec + 1, p + 1, flagLen);
+        char *end = spec + 1 + flagLen;
+        switch (conv) {
+            case 'd':
+            case 'i':
+                memcpy(end, "lld", 4);
+                appendFormat(buff, spec, static_cast<long long>(i));
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                end[0] = 'l', end[1] = 'l', end[2] = conv, end[3] = '\0';
+                appendFormat(buff, spec, static_cast<unsigned long long>(u));
+                break;
+            case 'c':
+                end[0] = 'c', end[1] = '\0';
+                appendFormat(buff, spec, static_cast<int>(i));
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                end[0] = conv, end[1] = '\0';
+                appendFormat(buff, spec, d);
+                break;
+            case 's':
+                end[0] = 's', end[1] = '\0';
+                appendFormat(buff, spec, str ? str : "<?>");
+                break;
+            case 'p':
+                end[0] = 'p', end[1] = '\0';
+                appendFormat(buff, spec, ptr);
+                break;
+            default:
+                /*不支持的转换说明原样输出*/
+                buff.append(p, s - p);
+                break;
+        }
+        p   = s;
+        lit = p;
+    }
+    buff.append(lit, strlen(lit));
+}
+
+}  // namespace logrec
@@ -0,0 +1,167 @@
+/*
+ * @Description  : 二进制日志记录，调用线程只拷贝格式串地址与原始参数到线程私有的环形缓冲，格式化由写线程完成
+ * @Date         : 2026-10-18 15:30:08
+ * @LastEditTime : 2026-10-18 15:30:08
+ */
+#ifndef LOGRECORD_H
+#define LOGRECORD_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../buffer/buffer.h"
+
+namespace logrec {
+
+/* 参数类型标记，解码时据此还原参数 */
+enum ArgType : uint8_t { INT, UINT, DOUBLE, STR, PTR };
+
+/**
+ * 一条记录在环形缓冲中的布局，按8字节对齐：
+ *   RecordHeader | 参数类型[argc] | 对齐 | 参数值...
+ *   整数、浮点、指针各占8字节；字符串为4字节长度加以'\0'结尾的内容，再按8字节对齐
+ */
+struct RecordHeader {
+    uint32_t    len;    // 整条记录的长度，为0表示回绕到缓冲区开头
+    uint8_t     level;  // 日志级别
+    uint8_t     argc;   // 参数个数
+    uint16_t    pad;
+    timespec    ts;    // 调用时刻
+    const char *fmt;   // 格式串地址，同一调用点的字面量地址固定，即格式串id
+};
+
+inline size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+/**
+ * @description: 单生产者单消费者的字节环形缓冲，每个写日志的线程一个
+ */
+struct ThreadRing {
+    static const size_t CAPACITY    = 1 << 20;  // 必须是2的幂
+    static const int    MAX_WAIT_MS = 1000;   // 缓冲区满时最多等待写线程这么久，之后丢弃
+
+    std::vector<char>   buf;
+    std::atomic<size_t> head{0};  // 生产者写到的位置，单调递增
+    std::atomic<size_t> tail{0};  // 消费者读到的位置，单调递增
+    std::atomic<bool>   dead{false};  // 所属线程已退出，读空后可以回收
+    std::atomic<uint64_t> dropped{0};  // 缓冲区满而丢弃的记录数
+    size_t              skip{0};  // 本次预留跳过的尾部空间，仅生产者使用
+
+    ThreadRing() : buf(CAPACITY) {}
+
+    char *reserve(size_t len);
+    void  commit(size_t len);
+
+    const RecordHeader *peek();
+    void                release(const RecordHeader *rec);
+};
+
+/* 参数类型与大小的编译期推导 */
+template <class T>
+constexpr ArgType argType() {
+    using U = std::decay_t<T>;
+    if constexpr (std::is_same_v<U, char *> || std::is_same_v<U, const char *>) {
+        return STR;
+    } else if constexpr (std::is_floating_point_v<U>) {
+        return DOUBLE;
+    } else if constexpr (std::is_integral_v<U> || std::is_enum_v<U>) {
+        return std::is_signed_v<U> ? INT : UINT;
+    } else {
+        static_assert(std::is_pointer_v<U> || std::is_null_pointer_v<U>,
+                      "unsupported log argument type");
+        return PTR;
+    }
+}
+
+template <class T>
+size_t argSize(const T &arg) {
+    if constexpr (argType<T>() == STR) {
+        return align8(4 + (arg ? strlen(arg) : 6) + 1);
+    } else {
+        return 8;
+    }
+}
+
+template <class T>
+void encodeArg(char *&p, const T &arg) {
+    if constexpr (argType<T>() == STR) {
+        const char *str = arg ? arg : "(null)";
+        uint32_t    n   = strlen(str);
+        memcpy(p, &n, 4);
+        memcpy(p + 4, str, n + 1);
+        p += align8(4 + n + 1);
+    } else if constexpr (argType<T>() == DOUBLE) {
+        double v = arg;
+        memcpy(p, &v, 8);
+        p += 8;
+    } else if constexpr (argType<T>() == INT) {
+        int64_t v = static_cast<int64_t>(arg);
+        memcpy(p, &v, 8);
+        p += 8;
+    } else if constexpr (argType<T>() == UINT) {
+        uint64_t v = static_cast<uint64_t>(arg);
+        memcpy(p, &v, 8);
+        p += 8;
+    } else {
+        const void *v = arg;
+        memcpy(p, &v, 8);
+        p += 8;
+    }
+}
+
+/**
+ * @description: 把一条记录写入环形缓冲，缓冲区满时让出CPU等待写线程消费，
+ *               等待过久（例如写线程已退出）才丢弃并计数；参数按值传递，字符串字面量退化为指针
+ */
+template <class... Args>
+void encode(ThreadRing &ring, int level, const char *fmt, Args... args) {
+    constexpr size_t argc    = sizeof...(Args);
+    size_t           typeLen = align8(argc);
+    size_t           len     = sizeof(RecordHeader) + typeLen + (size_t(0) + ... + argSize(args));
+
+    char *p = ring.reserve(len);
+    if (!p) {
+        timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += ThreadRing::MAX_WAIT_MS / 1000;
+        for (int spins = 1; !(p = ring.reserve(len)); spins++) {
+            if (spins % 64 == 0) {
+                timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                if (now.tv_sec > deadline.tv_sec ||
+                    (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec)) {
+                    ring.dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+    auto *rec  = reinterpret_cast<RecordHeader *>(p);
+    rec->len   = len;
+    rec->level = level;
+    rec->argc  = argc;
+    rec->pad   = 0;
+    rec->fmt   = fmt;
+    clock_gettime(CLOCK_REALTIME, &rec->ts);
+    p += sizeof(RecordHeader);
+    if constexpr (argc > 0) {
+        const uint8_t types[] = {argType<Args>()...};
+        memcpy(p, types, argc);
+    }
+    p += typeLen;
+    (encodeArg(p, args), ...);
+    ring.commit(len);
+}
+
+/* 写线程把一条记录按格式串格式化为日志正文，追加到缓冲区 */
+void format(const RecordHeader *rec, Buffer &buff);
+
+}  // namespace logrec
+
+#endif  //LOGRECORD_H
@@ -0,0 +1,50 @@
+/*
+ * @Description  : 数据库访问期限，请求解析后按连接超时确定期限，在当前线程中向下传递给连接池、查询与合并写入
+ * @Date         : 2026-10-19 03:40:12
+ * @LastEditTime : 2026-10-19 03:40:12
+ */
+#ifndef DBDEADLINE_H
+#define DBDEADLINE_H
+
+#include <chrono>
+
+class DbDeadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /* 没有期限时的取值 */
+    static constexpr Clock::time_point NONE = Clock::time_point::max();
+
+    /* 在作用域内设置当前线程的期限，离开时恢复原来的期限 */
+    class Scope {
+    private:
+        Clock::time_point prev_;
+
+    public:
+        explicit Scope(Clock::time_point deadline) : prev_(current_) { current_ = deadline; }
+        ~Scope() { current_ = prev_; }
+
+        Scope(const Scope &)            = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    /**
+     * @description: 当前线程的期限，没有设置时为NONE
+     */
+    static Clock::time_point current() { return current_; }
+
+    /**
+     * @description: 当前线程的期限是否已过
+     */
+    static bool expired() { return current_ != NONE && Clock::now() >= current_; }
+
+    /**
+     * @description: 给定的期限是否已过，用于在其他线程中检查提交时带上的期限
+     */
+    static bool expired(Clock::time_point deadline) { return deadline != NONE && Clock::now() >= deadline; }
+
+private:
+    static inline thread_local Clock::time_point current_ = NONE;
+};
+
+#endif  //DBDEADLINE_H
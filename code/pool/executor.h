@@ -0,0 +1,70 @@
+/*
+ * @Description  : 多通道执行器，每个通道是一个独立的线程池，阻塞的数据库任务与静态资源任务互不影响
+ * @Date         : 2026-10-18 22:41:06
+ * @LastEditTime : 2026-10-18 22:41:06
+ */
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <assert.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "threadpool.h"
+
+class Executor {
+public:
+    /* 任务通道，按处理类型划分 */
+    enum Lane {
+        STATIC = 0,  // 读写socket、解析请求、静态资源，不会长时间阻塞
+        DB,          // 登录注册等需要同步访问数据库的任务
+        LANE_COUNT
+    };
+
+    /* 每个通道的配置，maxQueue为0表示队列不限长 */
+    struct LaneConf {
+        std::size_t threads;
+        std::size_t maxQueue;
+    };
+
+private:
+    std::unique_ptr<ThreadPool> lanes_[LANE_COUNT];
+
+public:
+    explicit Executor(const LaneConf (&conf)[LANE_COUNT]) {
+        for (int i = 0; i < LANE_COUNT; i++) {
+            lanes_[i] = std::make_unique<ThreadPool>(conf[i].threads, conf[i].maxQueue);
+        }
+    }
+
+    /**
+     * @description: 向指定通道添加一个任务，通道队列已满时返回false
+     */
+    template <class F>
+    bool submit(Lane lane, F&& task, std::size_t remaining = 0) {
+        assert(lane < LANE_COUNT);
+        return lanes_[lane]->addTask(std::forward<F>(task), remaining);
+    }
+
+    /**
+     * @description: 向指定通道批量添加任务，返回放入的个数，被拒绝的任务留在jobs中
+     */
+    std::size_t submitBatch(Lane lane, std::vector<ThreadPool::Job>& jobs) {
+        assert(lane < LANE_COUNT);
+        return lanes_[lane]->addTasks(jobs);
+    }
+
+    ThreadPool::Stats takeStats(Lane lane) {
+        assert(lane < LANE_COUNT);
+        return lanes_[lane]->takeStats();
+    }
+
+    static const char* laneName(Lane lane) {
+        static const char* NAMES[LANE_COUNT] = {"static", "db"};
+        return NAMES[lane];
+    }
+};
+
+#endif  //EXECUTOR_H
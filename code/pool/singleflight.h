@@ -0,0 +1,136 @@
+/*
+ * @Description  : 请求合并，同一个key并发的加载只由第一个请求者执行一次，其余请求者共享它的结果
+ * @Date         : 2026-10-19 01:14:37
+ * @LastEditTime : 2026-10-19 01:14:37
+ */
+#ifndef SINGLEFLIGHT_H
+#define SINGLEFLIGHT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+template <typename K, typename V, typename Hash = std::hash<K>>
+class SingleFlight {
+public:
+    /* 结果回调，在完成加载的线程中执行 */
+    using Callback = std::function<void(const V &)>;
+
+private:
+    /* 一次进行中的加载 */
+    struct Call {
+        std::vector<Callback>   waiters;     // 异步等待者的回调
+        std::condition_variable cond;        // 同步等待者在此等待
+        bool                    done{false};
+        V                       value{};
+    };
+
+    std::mutex                                         mtx_;
+    std::unordered_map<K, std::shared_ptr<Call>, Hash> calls_;         // 进行中的加载
+    std::atomic<uint64_t>                              coalesced_{0};  // 合并到他人加载上的请求数
+
+    /**
+     * @description: 加入进行中的加载，没有时创建一个并返回true，调用者成为执行加载的请求者
+     */
+    bool join_(const K &key, std::shared_ptr<Call> &call) {
+        auto it = calls_.find(key);
+        if (it != calls_.end()) {
+            call = it->second;
+            coalesced_++;
+            return false;
+        }
+        call = std::make_shared<Call>();
+        calls_.emplace(key, call);
+        return true;
+    }
+
+    /**
+     * @description: 加载完成，移除进行中的记录，唤醒同步等待者并调用异步等待者的回调
+     */
+    void finish_(const K &key, const std::shared_ptr<Call> &call, const V &value) {
+        std::vector<Callback> waiters;
+        {
+            std::lock_guard<std::mutex> locker(mtx_);
+            calls_.erase(key);
+            call->value = value;
+            call->done  = true;
+            waiters.swap(call->waiters);
+        }
+        call->cond.notify_all();
+        for (auto &cb : waiters) {
+            cb(value);
+        }
+    }
+
+public:
+    /**
+     * @description: 异步方式，不阻塞调用线程；第一个请求者调用load发起加载，并发的请求者只登记回调
+     * @param {K} &key
+     * @param {Callback} cb 拿到结果后调用，每个请求者调用一次
+     * @param {F} &&load 形如void(Callback done)，加载完成时必须调用且只调用一次done，可以在其他线程调用
+     */
+    template <class F>
+    void doAsync(const K &key, Callback cb, F &&load) {
+        std::shared_ptr<Call> call;
+        {
+            std::lock_guard<std::mutex> locker(mtx_);
+            bool                        leader = join_(key, call);
+            call->waiters.push_back(std::move(cb));
+            if (!leader) {
+                return;
+            }
+        }
+        load([this, key, call](const V &value) { finish_(key, call, value); });
+    }
+
+    /**
+     * @description: 同步方式，第一个请求者在本线程执行load，并发的请求者等待它的结果而不是各自重复加载
+     * @param {K} &key
+     * @param {F} &&load 形如V()
+     */
+    template <class F>
+    V doSync(const K &key, F &&load) {
+        return doSync(key, std::forward<F>(load), std::chrono::steady_clock::time_point::max(), V{},
+                      [](const V &) { return true; });
+    }
+
+    /**
+     * @description: 带期限的同步方式：等待者最多等到自己的deadline，到期返回expired，不被他人更晚的期限拖住；
+     *              执行者的结果shareable为false时(例如执行者自己超时)不共享给等待者，等待者重新加入或自己执行加载
+     * @param {time_point} deadline 等待者的期限，time_point::max()表示不限
+     * @param {V} &expired 等待者到期时返回的值
+     * @param {P} &&shareable 形如bool(const V &)
+     */
+    template <class F, class Clock, class Duration, class P>
+    V doSync(const K &key, F &&load, std::chrono::time_point<Clock, Duration> deadline, const V &expired,
+             P &&shareable) {
+        std::shared_ptr<Call> call;
+        {
+            std::unique_lock<std::mutex> locker(mtx_);
+            while (!join_(key, call)) {
+                auto ready = [&call] { return call->done; };
+                if (deadline == std::chrono::time_point<Clock, Duration>::max()) {
+                    call->cond.wait(locker, ready);
+                } else if (!call->cond.wait_until(locker, deadline, ready)) {
+                    return expired;
+                }
+                if (shareable(call->value)) {
+                    return call->value;
+                }
+            }
+        }
+        V value = load();
+        finish_(key, call, value);
+        return value;
+    }
+
+    uint64_t coalesced() const { return coalesced_; }
+};
+
+#endif  //SINGLEFLIGHT_H
@@ -0,0 +1,399 @@
+#include "sqlasync.h"
+
+#include <mysql/mysqld_error.h>
+
+#include "sqlwatchdog.h"
+
+SqlAsync::~SqlAsync() { close(); }
+
+/**
+ * @description: 懒汉单例模式，局部静态变量
+ */
+SqlAsync *SqlAsync::instance() {
+    static SqlAsync async;
+    return &async;
+}
+
+/**
+ * @description: 建立连接并启动数据库线程，连接在启动时同步建立，之后的查询都是非阻塞的
+ * @param {size_t} maxPending 已提交尚未完成的查询上限，超过时query直接返回false
+ * @param {vector<SqlNode>} &replicas 只读副本，每个副本同样建立connSize个连接，节点下标从1开始
+ * @return {bool} 主库一个连接都没有建立时返回false；副本连接失败只是不向它路由
+ */
+bool SqlAsync::init(const std::string &host, int port, const std::string &user, const std::string &pwd,
+                    const std::string &dbName, int connSize, size_t maxPending,
+                    const std::vector<SqlNode> &replicas) {
+    assert(connSize > 0);
+    maxPending_ = maxPending;
+    wakeFd_     = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0) {
+        LOG_ERROR("SqlAsync eventfd error: %s", strerror(errno));
+        return false;
+    }
+    epoller_ = std::make_unique<Epoller>(connSize * (replicas.size() + 1) + 1);
+    epoller_->addFd(wakeFd_, EPOLLIN);
+
+    nodes_.resize(replicas.size() + 1);
+    if (connect_(SqlNode::PRIMARY, {host, port}, user, pwd, dbName, connSize) == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < replicas.size(); i++) {
+        connect_(static_cast<int>(i) + 1, replicas[i], user, pwd, dbName, connSize);
+    }
+    isOpen_ = true;
+    thread_ = std::thread(&SqlAsync::loop_, this);
+    return true;
+}
+
+/**
+ * @description: 为一个节点建立connSize个连接，遇到失败就停止
+ * @return {size_t} 建立成功的连接数
+ */
+size_t SqlAsync::connect_(int node, const SqlNode &addr, const std::string &user, const std::string &pwd,
+                          const std::string &dbName, int connSize) {
+    for (int i = 0; i < connSize; i++) {
+        MYSQL *sql = mysql_init(nullptr);
+        if (!sql) {
+            LOG_ERROR("SqlAsync mysql init error!");
+            break;
+        }
+        if (!mysql_real_connect(sql, addr.host.c_str(), user.c_str(), pwd.c_str(), dbName.c_str(), addr.port,
+                                nullptr, 0)) {
+            LOG_ERROR("SqlAsync connect %s:%d error: %s", addr.host.c_str(), addr.port, mysql_error(sql));
+            mysql_close(sql);
+            break;
+        }
+        /*连接空闲时不监听socket，执行查询时才加入epoll*/
+        fdIndex_[sql->net.fd] = conns_.size();
+        nodes_[node].idle.push_back(conns_.size());
+        nodes_[node].conns++;
+        conns_.push_back({sql, sql->net.fd, node, IDLE, {}, 0});
+    }
+    return nodes_[node].conns;
+}
+
+bool SqlAsync::isOpen() const { return isOpen_; }
+
+size_t SqlAsync::pending() const { return pending_; }
+
+uint64_t SqlAsync::timeouts() const { return timeouts_; }
+
+uint64_t SqlAsync::replicaQueries() const { return replicaQueries_; }
+
+uint64_t SqlAsync::failovers() const { return failovers_; }
+
+/**
+ * @description: 提交一个查询，可以在任意线程调用，包括在回调中；查询带上当前线程的数据库期限
+ * @param {Route} route 写入以及需要读到最新数据的查询发往主库，其余读取可以发往副本
+ * @return {bool} 未初始化或排队的查询已达上限时返回false，此时回调不会被调用
+ */
+bool SqlAsync::query(std::string sql, Callback cb, Route route) {
+    if (!isOpen_ || stop_) {
+        return false;
+    }
+    if (pending_.fetch_add(1) >= maxPending_ && maxPending_ > 0) {
+        pending_--;
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        incoming_.push_back({std::move(sql), std::move(cb), DbDeadline::current(), route});
+    }
+    wake_();
+    return true;
+}
+
+/**
+ * @description: 唤醒数据库线程
+ */
+void SqlAsync::wake_() {
+    uint64_t one = 1;
+    ::write(wakeFd_, &one, sizeof(one));
+}
+
+/**
+ * @description: 转义字符串中的特殊字符，用于拼接SQL语句
+ */
+std::string SqlAsync::escape(const std::string &str) {
+    assert(!conns_.empty());
+    std::string ret(str.size() * 2 + 1, '\0');
+    ret.resize(mysql_real_escape_string(conns_[0].sql, &ret[0], str.c_str(), str.size()));
+    return ret;
+}
+
+/**
+ * @description: 数据库线程：等待socket可读后继续推进对应连接上的查询，再把排队的查询分配给空闲连接
+ *              非阻塞接口不区分等待读还是等待写，这里只监听可读，并在有查询执行时最多等待POLL_MS再推进一次
+ *              看门狗发完KILL后通过wakeFd_唤醒，停放的连接在这里回到空闲
+ */
+void SqlAsync::loop_() {
+    while (!stop_) {
+        int timeoutMS  = running_ > 0 || parked_ > 0 ? POLL_MS : -1;
+        int eventCount = epoller_->wait(timeoutMS);
+        for (int i = 0; i < eventCount; i++) {
+            int fd = epoller_->getEventFd(i);
+            if (fd == wakeFd_) {
+                uint64_t cnt;
+                ::read(wakeFd_, &cnt, sizeof(cnt));
+                continue;
+            }
+            auto it = fdIndex_.find(fd);
+            if (it != fdIndex_.end() && (conns_[it->second].step == SEND || conns_[it->second].step == STORE)) {
+                drive_(conns_[it->second]);
+            }
+        }
+        if (eventCount == 0) {
+            /*超时，推进所有执行中的查询*/
+            for (auto &conn : conns_) {
+                if (conn.step == SEND || conn.step == STORE) {
+                    drive_(conn);
+                }
+            }
+        }
+        if (parked_ > 0) {
+            reclaim_();
+        }
+        dispatch_();
+        expire_();
+    }
+}
+
+/**
+ * @description: 取走其他线程提交的查询，分到各节点排队，再分配给各节点的空闲连接
+ */
+void SqlAsync::dispatch_() {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        for (auto &query : incoming_) {
+            enqueue_(std::move(query));
+        }
+        incoming_.clear();
+    }
+    for (auto &node : nodes_) {
+        while (!node.idle.empty() && !node.waiting.empty()) {
+            size_t idx = node.idle.back();
+            node.idle.pop_back();
+            Query query = std::move(node.waiting.front());
+            node.waiting.pop_front();
+            start_(conns_[idx], std::move(query));
+        }
+    }
+}
+
+/**
+ * @description: 按查询的路由选定节点并在该节点排队
+ */
+void SqlAsync::enqueue_(Query &&query) {
+    Node &node = nodes_[route_(query.route)];
+    node.load++;
+    node.waiting.push_back(std::move(query));
+}
+
+/**
+ * @description: 读取选择有连接、未暂停且分配到的查询最少的副本，负载相同时从轮流的起点开始选
+ * @return {int} 节点下标，写入或没有可用副本时为主库
+ */
+int SqlAsync::route_(Route route) {
+    if (route == PRIMARY || nodes_.size() == 1) {
+        return SqlNode::PRIMARY;
+    }
+    auto   now   = DbDeadline::Clock::now();
+    size_t count = nodes_.size() - 1;
+    size_t start = next_++;
+    int    best  = SqlNode::PRIMARY;
+    for (size_t i = 0; i < count; i++) {
+        size_t idx  = 1 + (start + i) % count;
+        Node  &node = nodes_[idx];
+        if (node.conns == 0 || node.downUntil > now) {
+            continue;
+        }
+        if (best == SqlNode::PRIMARY || node.load < nodes_[best].load) {
+            best = static_cast<int>(idx);
+        }
+    }
+    if (best != SqlNode::PRIMARY) {
+        replicaQueries_++;
+    }
+    return best;
+}
+
+/**
+ * @description: 在空闲连接上开始一个查询
+ */
+void SqlAsync::start_(Conn &conn, Query &&query) {
+    conn.query = std::move(query);
+    conn.step  = SEND;
+    running_++;
+    epoller_->addFd(conn.fd, EPOLLIN);
+    drive_(conn);
+}
+
+/**
+ * @description: 推进连接上的查询，接口返回NET_ASYNC_NOT_READY时留在当前步骤等待下次推进
+ */
+void SqlAsync::drive_(Conn &conn) {
+    net_async_status status;
+    if (conn.step == SEND) {
+        status = mysql_real_query_nonblocking(conn.sql, conn.query.sql.c_str(), conn.query.sql.size());
+        if (status == NET_ASYNC_NOT_READY) {
+            return;
+        }
+        if (status == NET_ASYNC_ERROR) {
+            LOG_ERROR("SqlAsync query error: %s", mysql_error(conn.sql));
+            fail_(conn);
+            return;
+        }
+        conn.step = STORE;
+    }
+    if (conn.step == STORE) {
+        MYSQL_RES *res = nullptr;
+        status         = mysql_store_result_nonblocking(conn.sql, &res);
+        if (status == NET_ASYNC_NOT_READY) {
+            return;
+        }
+        if (status == NET_ASYNC_ERROR) {
+            LOG_ERROR("SqlAsync store result error: %s", mysql_error(conn.sql));
+            fail_(conn);
+            return;
+        }
+        /*INSERT等语句没有结果集，res为空*/
+        finish_(conn, OK, res);
+    }
+}
+
+/**
+ * @description: 查询结束，连接回到空闲状态后再执行回调，回调中提交的查询可以复用这条连接
+ *              已超时回调过的查询只释放结果；先撤销它的取消登记，KILL正在发送时不等待，
+ *              连接停放到看门狗发完后由reclaim_放回空闲，保证迟到的KILL QUERY不会取消这条连接上之后的查询
+ */
+void SqlAsync::finish_(Conn &conn, Status status, MYSQL_RES *res) {
+    epoller_->delFd(conn.fd);
+    Callback cb = std::move(conn.query.cb);
+    conn.query  = {};
+    running_--;
+    nodes_[conn.node].load--;
+    if (SqlWatchdog::instance()->tryUnwatch(conn.cancel)) {
+        conn.cancel = 0;
+        conn.step   = IDLE;
+        nodes_[conn.node].idle.push_back(&conn - conns_.data());
+    } else {
+        conn.step = PARKED;
+        parked_++;
+    }
+    if (cb) {
+        pending_--;
+        cb(status, res);
+    }
+    if (res) {
+        mysql_free_result(res);
+    }
+}
+
+/**
+ * @description: 看门狗发完KILL后，停放的连接撤销取消登记并回到空闲
+ */
+void SqlAsync::reclaim_() {
+    for (auto &conn : conns_) {
+        if (conn.step == PARKED && SqlWatchdog::instance()->tryUnwatch(conn.cancel)) {
+            conn.cancel = 0;
+            conn.step   = IDLE;
+            parked_--;
+            nodes_[conn.node].idle.push_back(&conn - conns_.data());
+        }
+    }
+}
+
+/**
+ * @description: 查询出错：副本上还未回调的读取暂停向该副本路由，改到主库重新排队一次，其余以ERROR回调，唯一键冲突以DUPLICATE回调
+ */
+void SqlAsync::fail_(Conn &conn) {
+    if (conn.node == SqlNode::PRIMARY || !conn.query.cb) {
+        finish_(conn, mysql_errno(conn.sql) == ER_DUP_ENTRY ? DUPLICATE : ERROR, nullptr);
+        return;
+    }
+    Query query   = std::move(conn.query);
+    query.route   = PRIMARY;
+    conn.query.cb = nullptr;
+    nodes_[conn.node].downUntil = DbDeadline::Clock::now() + std::chrono::milliseconds(RETRY_MS);
+    failovers_++;
+    LOG_WARN("SqlAsync replica %d query error, retry on primary", conn.node);
+    finish_(conn, ERROR, nullptr);
+    enqueue_(std::move(query));
+}
+
+/**
+ * @description: 超过期限的查询以TIMEOUT回调：排队的直接丢弃，执行中的由看门狗发送KILL QUERY，
+ *              连接等服务端返回被取消的结果后才回到空闲状态
+ */
+void SqlAsync::expire_() {
+    std::vector<Callback> cbs;
+    for (auto &conn : conns_) {
+        if (conn.step != IDLE && conn.query.cb && DbDeadline::expired(conn.query.deadline)) {
+            conn.cancel = SqlWatchdog::instance()->cancel(conn.sql, conn.node, [this] { wake_(); });
+            cbs.push_back(std::move(conn.query.cb));
+            conn.query.cb = nullptr;
+        }
+    }
+    for (auto &node : nodes_) {
+        for (auto it = node.waiting.begin(); it != node.waiting.end();) {
+            if (DbDeadline::expired(it->deadline)) {
+                cbs.push_back(std::move(it->cb));
+                it = node.waiting.erase(it);
+                node.load--;
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto &cb : cbs) {
+        pending_--;
+        timeouts_++;
+        cb(TIMEOUT, nullptr);
+    }
+}
+
+/**
+ * @description: 停止数据库线程，未完成的查询以失败回调，关闭所有连接
+ *              此时已不在数据库线程中，可以阻塞地撤销取消登记，看门狗之后不会再唤醒已关闭的wakeFd_
+ */
+void SqlAsync::close() {
+    if (thread_.joinable()) {
+        stop_ = true;
+        wake_();
+        thread_.join();
+    }
+    std::vector<Callback> cbs;
+    for (auto &conn : conns_) {
+        if (conn.step != IDLE && conn.query.cb) {
+            cbs.push_back(std::move(conn.query.cb));
+        }
+        SqlWatchdog::instance()->unwatch(conn.cancel);
+        mysql_close(conn.sql);
+    }
+    conns_.clear();
+    fdIndex_.clear();
+    running_ = 0;
+    parked_  = 0;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        for (auto &query : incoming_) {
+            cbs.push_back(std::move(query.cb));
+        }
+        incoming_.clear();
+    }
+    for (auto &node : nodes_) {
+        for (auto &query : node.waiting) {
+            cbs.push_back(std::move(query.cb));
+        }
+    }
+    nodes_.clear();
+    for (auto &cb : cbs) {
+        cb(ERROR, nullptr);
+    }
+    pending_ = 0;
+    if (wakeFd_ >= 0) {
+        ::close(wakeFd_);
+        wakeFd_ = -1;
+    }
+    isOpen_ = false;
+}
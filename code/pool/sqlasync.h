@@ -0,0 +1,133 @@
+/*
+ * @Description  : 异步MySQL查询，数据库线程用自己的epoll驱动MySQL 8的非阻塞客户端接口，少量连接即可同时执行多个查询；
+ *                 连接分属主库与只读副本，读取发往排队最少的副本，单例模式
+ * @Date         : 2026-10-18 23:05:12
+ * @LastEditTime : 2026-10-19 04:52:30
+ */
+#ifndef SQLASYNC_H
+#define SQLASYNC_H
+
+#include <mysql/mysql.h>
+#include <sys/eventfd.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../logsys/log.h"
+#include "../server/epoller.h"
+#include "dbdeadline.h"
+#include "sqlnode.h"
+
+class SqlAsync {
+public:
+    /* 查询结果：成功、出错、超过提交时的期限（查询已被取消或未执行）、违反唯一键（INSERT的行已存在） */
+    enum Status { OK, ERROR, TIMEOUT, DUPLICATE };
+
+    /* 查询发往的节点：主库，或执行中与排队的查询最少的只读副本（没有可用副本时为主库） */
+    enum Route { PRIMARY, REPLICA };
+
+    /* 查询完成的回调，在数据库线程中执行，res在回调返回后释放；回调中可以继续调用query */
+    using Callback = std::function<void(Status status, MYSQL_RES *res)>;
+
+    static const int POLL_MS  = 10;    // 有查询在执行时的最长等待，兜底发送阶段未完成的查询
+    static const int RETRY_MS = 1000;  // 副本上的查询出错后暂停向它路由的毫秒数
+
+private:
+    /* 一个查询 */
+    struct Query {
+        std::string                   sql;
+        Callback                      cb;  // 超时后已回调的查询置空，连接上的执行结果直接丢弃
+        DbDeadline::Clock::time_point deadline;
+        Route                         route;
+    };
+
+    /* 一条连接上的查询状态机：空闲 -> 发送并等待执行 -> 读取结果 -> 空闲；
+       被取消的查询结束时看门狗的KILL还在发送，先停在PARKED，等KILL发完再回到空闲 */
+    enum STEP { IDLE, SEND, STORE, PARKED };
+
+    struct Conn {
+        MYSQL   *sql;
+        int      fd;
+        int      node;  // 所在节点，SqlNode::PRIMARY为主库
+        STEP     step;
+        Query    query;
+        uint64_t cancel;  // 超时后向看门狗登记的取消，查询结束时撤销，0表示没有
+    };
+
+    /* 一个节点上的空闲连接与排队的查询，load为分配到该节点、尚未完成的查询数 */
+    struct Node {
+        std::vector<size_t>           idle;     // 空闲连接下标
+        std::deque<Query>             waiting;  // 没有空闲连接时排队的查询
+        size_t                        conns{0};
+        size_t                        load{0};
+        DbDeadline::Clock::time_point downUntil;  // 之前不向该副本路由
+    };
+
+    std::vector<Conn>               conns_;       // 只由数据库线程访问
+    std::vector<Node>               nodes_;       // 下标为节点下标
+    std::unordered_map<int, size_t> fdIndex_;     // socket到连接下标
+    size_t                          running_{0};  // 执行中的连接数
+    size_t                          parked_{0};   // 等待看门狗发完KILL的连接数
+    size_t                          next_{0};     // 负载相同时轮流选择副本的起点
+
+    std::mutex            mtx_;
+    std::vector<Query>    incoming_;           // 其他线程提交的查询，由数据库线程取走
+    size_t                maxPending_{0};      // 已提交尚未完成的查询上限，0表示不限
+    std::atomic<size_t>   pending_{0};         // 已提交尚未完成的查询数
+    std::atomic<uint64_t> timeouts_{0};        // 超过期限的查询数
+    std::atomic<uint64_t> replicaQueries_{0};  // 发往副本的查询数
+    std::atomic<uint64_t> failovers_{0};       // 副本上出错改由主库重新执行的查询数
+
+    int                      wakeFd_{-1};  // eventfd，通知数据库线程有新查询或需要退出
+    std::unique_ptr<Epoller> epoller_;
+    std::thread              thread_;
+    std::atomic<bool>        stop_{false};
+    std::atomic<bool>        isOpen_{false};
+
+private:
+    SqlAsync() = default;
+    ~SqlAsync();
+
+    size_t connect_(int node, const SqlNode &addr, const std::string &user, const std::string &pwd,
+                    const std::string &dbName, int connSize);
+
+    void loop_();
+    void dispatch_();
+    void enqueue_(Query &&query);
+    int  route_(Route route);
+    void start_(Conn &conn, Query &&query);
+    void drive_(Conn &conn);
+    void finish_(Conn &conn, Status status, MYSQL_RES *res);
+    void reclaim_();
+    void wake_();
+    void fail_(Conn &conn);
+    void expire_();
+
+public:
+    static SqlAsync *instance();
+
+    bool init(const std::string &host, int port, const std::string &user, const std::string &pwd,
+              const std::string &dbName, int connSize, size_t maxPending,
+              const std::vector<SqlNode> &replicas = {});
+
+    bool query(std::string sql, Callback cb, Route route = PRIMARY);
+
+    std::string escape(const std::string &str);
+
+    bool     isOpen() const;
+    size_t   pending() const;
+    uint64_t timeouts() const;
+    uint64_t replicaQueries() const;
+    uint64_t failovers() const;
+
+    void close();
+};
+
+#endif  //SQLASYNC_H
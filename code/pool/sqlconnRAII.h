@@ -1,7 +1,7 @@
 /*
  * @Description  : RAII机制封装MySQL连接类，用于从连接池取出连接
  * @Date         : 2022-07-16 01:14:06
- * @LastEditTime : 2022-07-18 00:01:45
+ * @LastEditTime : 2026-10-19 04:31:08
  */
 #ifndef SQLCONNRAII_H
 #define SQLCONNRAII_H
@@ -25,6 +25,14 @@ public:
         connpool_ = connpool;
     }
 
+    /**
+     * @description: 接管已经从connpool取出的连接，sql为空时什么也不做
+     */
+    SqlConnRAII(MYSQL *sql, SqlConnPool *connpool) : sql_(sql), connpool_(connpool) { assert(connpool); }
+
+    SqlConnRAII(const SqlConnRAII &)            = delete;
+    SqlConnRAII &operator=(const SqlConnRAII &) = delete;
+
     /**
      * @description:  析构函数中自动释放
      */    
@@ -1,22 +1,40 @@
 #include "sqlconnpool.h"
 
+#include <algorithm>
+#include <vector>
+
 SqlConnPool::~SqlConnPool() { closePool(); }
 
 /**
  * @description: 关闭数据库连接池，被析构函数调用
  */
 void SqlConnPool::closePool() {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        isClose_ = true;
+    }
+    cond_.notify_all();
+    keepCond_.notify_all();
+    if (keeper_.joinable()) {
+        keeper_.join();
+    }
+
     std::lock_guard<std::mutex> locker(mtx_);
-    while (!connQue_.empty()) {
-        auto sql = connQue_.front();
-        connQue_.pop();
-        mysql_close(sql);
+    /*先关闭预处理语句，再关闭连接*/
+    stmts_.clear();
+    while (!idle_.empty()) {
+        mysql_close(idle_.front().sql);
+        idle_.pop_front();
+        total_--;
+    }
+    /*客户端库由所有连接池共用，只在最后关闭的主库连接池中释放*/
+    if (node_ == SqlNode::PRIMARY) {
+        mysql_library_end();
     }
-    mysql_library_end();
 }
 
 /**
- * @description: 懒汉单例模式，局部静态变量
+ * @description: 懒汉单例模式，局部静态变量，单例为主库的连接池
  */
 SqlConnPool *SqlConnPool::instance() {
     static SqlConnPool connPool;
@@ -24,73 +42,278 @@ SqlConnPool *SqlConnPool::instance() {
 }
 
 /**
- * @description: 初始化数据库连接池
+ * @description: 初始化数据库连接池，只记录参数并启动维护线程，不等待连接建立
+ * @param {int} connSize 最大连接数量
+ * @param {int} minConn 最少保持的连接数量，由维护线程在后台并行建立
+ * @param {int} waitMs 没有空闲连接且已达上限时，取连接最长等待的毫秒数
+ * @param {int} idleSec 多于minConn的连接空闲超过此秒数被关闭，0表示不关闭
+ * @param {int} ioTimeout 连接的读写超时秒数，0表示不设置
  */
 void SqlConnPool::init(std::string &host, int port, std::string &user, std::string &pwd,
-                       std::string &dbName, int connSize) {
+                       std::string &dbName, int connSize, int minConn, int waitMs, int idleSec,
+                       int ioTimeout) {
     assert(connSize > 0);
-    for (int i = 0; i < connSize; i++) {
-        /*初始化以及配置一个sql连接*/
-        MYSQL *sql = nullptr;
-        sql        = mysql_init(sql);
-        if (!sql) {
-            LOG_ERROR("Mysql init error!");
-            assert(sql);
-        }
-        sql = mysql_real_connect(sql, host.c_str(), user.c_str(), pwd.c_str(), dbName.c_str(), port,
-                                 nullptr, 0);
-        if (!sql) {
-            LOG_ERROR("MySql Connect error!");
-            assert(sql);
-        }
-        /*将sql连接入队*/
-        connQue_.push(sql);
-    }
-    MAX_CONN_ = connSize;
-    /*初始化信号量值为数据池连接个数*/
-    sem_init(&semId_, 0, MAX_CONN_);
+    host_      = host;
+    port_      = port;
+    user_      = user;
+    pwd_       = pwd;
+    dbName_    = dbName;
+    MAX_CONN_  = connSize;
+    minConn_   = std::max(0, std::min(minConn, connSize));
+    waitMs_    = std::max(0, waitMs);
+    idleSec_   = std::max(0, idleSec);
+    ioTimeout_ = std::max(0, ioTimeout);
+
+    /*多个线程同时调用mysql_init前必须先初始化客户端库*/
+    mysql_library_init(0, nullptr, nullptr);
+    isClose_ = false;
+    keeper_  = std::thread(&SqlConnPool::keepLoop_, this);
 }
 
 /**
- * @description: 取出数据库连接池中的一个连接
+ * @description: 建立一个连接，调用者已在total_中为它占了位置，失败时释放该位置
  */
-MYSQL *SqlConnPool::getConn() {
-    MYSQL *sql = nullptr;
-    if (connQue_.empty()) {
-        LOG_WARN("SqlConnPool busy!");
+MYSQL *SqlConnPool::connect_() {
+    /*初始化以及配置一个sql连接*/
+    MYSQL *sql = mysql_init(nullptr);
+    if (!sql) {
+        LOG_ERROR("Mysql init error!");
+    } else {
+        /*连接断开时由mysql_ping自动重连，重连后预处理语句缓存会重新准备*/
+        bool reconnect = true;
+        mysql_options(sql, MYSQL_OPT_RECONNECT, &reconnect);
+        if (ioTimeout_ > 0) {
+            /*客户端库对读超时会重试，实际等待可能是这里的数倍，只作为看门狗之外的兜底*/
+            unsigned int timeout = ioTimeout_;
+            mysql_options(sql, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+            mysql_options(sql, MYSQL_OPT_READ_TIMEOUT, &timeout);
+            mysql_options(sql, MYSQL_OPT_WRITE_TIMEOUT, &timeout);
+        }
+        if (!mysql_real_connect(sql, host_.c_str(), user_.c_str(), pwd_.c_str(), dbName_.c_str(), port_,
+                                nullptr, 0)) {
+            LOG_ERROR("MySql Connect %s:%d error: %s", host_.c_str(), port_, mysql_error(sql));
+            mysql_close(sql);
+            sql = nullptr;
+        }
+    }
+
+    std::unique_lock<std::mutex> locker(mtx_);
+    if (!sql) {
+        connectErrors_++;
+        total_--;
+        locker.unlock();
+        cond_.notify_all();
         return nullptr;
     }
-    /*将信号量减1*/
-    sem_wait(&semId_);
+    stmts_[sql] = std::make_unique<StmtCache>(sql);
+    created_++;
+    return sql;
+}
 
+/**
+ * @description: 关闭一个不再放回池中的连接，空出的位置可以新建连接
+ */
+void SqlConnPool::discard_(MYSQL *sql) {
+    std::unique_ptr<StmtCache> stmts;
     {
-        /*RAII的应用，加锁局部块作用域*/
         std::lock_guard<std::mutex> locker(mtx_);
-        sql = connQue_.front();
-        connQue_.pop();
+        auto                        it = stmts_.find(sql);
+        if (it != stmts_.end()) {
+            stmts = std::move(it->second);
+            stmts_.erase(it);
+        }
+        total_--;
     }
-    assert(sql);
+    cond_.notify_all();
+    /*先关闭预处理语句，再关闭连接*/
+    stmts.reset();
+    mysql_close(sql);
+}
+
+/**
+ * @description: 连接上一次操作报告连接丢失，且ping自动重连也失败
+ */
+bool SqlConnPool::broken_(MYSQL *sql) {
+    unsigned int err = mysql_errno(sql);
+    /*CR_SERVER_GONE_ERROR、CR_SERVER_LOST*/
+    return (err == 2006 || err == 2013) && mysql_ping(sql) != 0;
+}
+
+/**
+ * @description: 每个连接一个线程同时建立，count个位置已由调用者在total_中占好
+ */
+void SqlConnPool::warmUp_(int count) {
+    auto                     begin = Clock::now();
+    std::atomic<int>         ok{0};
+    std::vector<std::thread> workers;
+    for (int i = 0; i < count; i++) {
+        workers.emplace_back([this, &ok] {
+            MYSQL *sql = connect_();
+            if (sql) {
+                ok++;
+                putBack_(sql);
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    if (ok > 0) {
+        LOG_INFO("SqlConnPool warm up %d/%d connections in %lldms", ok.load(), count,
+                 (long long)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count());
+    }
+}
 
+/**
+ * @description: 维护线程：连接数不足minConn_时并行补足（启动时即为预热），关闭空闲太久的多余连接
+ */
+void SqlConnPool::keepLoop_() {
+    std::unique_lock<std::mutex> locker(mtx_);
+    while (!isClose_) {
+        int need = minConn_ - total_;
+        if (need > 0) {
+            total_ += need;
+            locker.unlock();
+            warmUp_(need);
+            locker.lock();
+        }
+        if (idleSec_ > 0) {
+            /*队头是最久未使用的连接*/
+            auto                 expire = Clock::now() - std::chrono::seconds(idleSec_);
+            std::vector<MYSQL *> expired;
+            while (!idle_.empty() && total_ - (int)expired.size() > minConn_ && idle_.front().since < expire) {
+                expired.push_back(idle_.front().sql);
+                idle_.pop_front();
+            }
+            if (!expired.empty()) {
+                locker.unlock();
+                for (MYSQL *sql : expired) {
+                    evictedIdle_++;
+                    discard_(sql);
+                }
+                locker.lock();
+            }
+        }
+        keepCond_.wait_for(locker, std::chrono::milliseconds(TICK_MS), [this] { return isClose_; });
+    }
+}
+
+/**
+ * @description: 取出数据库连接池中的一个连接：优先复用空闲连接，没有时未达上限就新建，
+ *              已达上限则等待归还，超过waitMs_或当前线程的数据库期限时返回nullptr
+ *              从开始取连接到归还连接之间计入outstanding_
+ */
+MYSQL *SqlConnPool::getConn() {
+    outstanding_++;
+    MYSQL *sql = getConn_();
+    if (!sql) {
+        outstanding_--;
+    }
     return sql;
 }
 
+MYSQL *SqlConnPool::getConn_() {
+    auto                         deadline = std::min(Clock::now() + std::chrono::milliseconds(waitMs_), DbDeadline::current());
+    bool                         waited   = false;
+    std::unique_lock<std::mutex> locker(mtx_);
+    while (!isClose_) {
+        if (!idle_.empty()) {
+            /*后进先出，刚归还的连接最不可能已断开*/
+            Idle conn = idle_.back();
+            idle_.pop_back();
+            locker.unlock();
+            if (Clock::now() - conn.since < std::chrono::seconds(PING_IDLE_SEC) || mysql_ping(conn.sql) == 0) {
+                return conn.sql;
+            }
+            LOG_WARN("SqlConnPool drop broken connection: %s", mysql_error(conn.sql));
+            evictedBroken_++;
+            discard_(conn.sql);
+            locker.lock();
+            continue;
+        }
+        if (total_ < MAX_CONN_) {
+            /*按需增长；建立失败说明数据库不可用，不再等待*/
+            total_++;
+            locker.unlock();
+            return connect_();
+        }
+        if (!waited) {
+            waits_++;
+            waited = true;
+        }
+        if (!cond_.wait_until(locker, deadline,
+                              [this] { return isClose_ || !idle_.empty() || total_ < MAX_CONN_; })) {
+            timeouts_++;
+            LOG_WARN("SqlConnPool busy, no connection in %dms", waitMs_);
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
 /**
- * @description: 释放一个数据库连接，重新将连接入池
+ * @description: 释放一个数据库连接，重新将连接入池；连接已断开且无法重连时关闭它
  * @param {MYSQL} *sql
  */
 void SqlConnPool::freeConn(MYSQL *sql) {
     assert(sql);
+    outstanding_--;
+    putBack_(sql);
+}
+
+/**
+ * @description: 连接放回空闲队列，预热建立的连接也从这里入池
+ */
+void SqlConnPool::putBack_(MYSQL *sql) {
+    if (broken_(sql)) {
+        LOG_WARN("SqlConnPool drop broken connection: %s", mysql_error(sql));
+        evictedBroken_++;
+        discard_(sql);
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> locker(mtx_);
+        if (isClose_) {
+            locker.unlock();
+            discard_(sql);
+            return;
+        }
+        idle_.push_back({sql, Clock::now()});
+    }
+    cond_.notify_one();
+}
+
+bool SqlConnPool::isOpen() {
     std::lock_guard<std::mutex> locker(mtx_);
-    connQue_.push(sql);
-    /*将信号量加1*/
-    sem_post(&semId_);
+    return !isClose_;
 }
 
+int SqlConnPool::node() const { return node_; }
+
+int SqlConnPool::outstanding() const { return outstanding_; }
+
 /**
  * @description: 获取可用连接的数量
  */
 int SqlConnPool::getFreeConnCount() {
     std::lock_guard<std::mutex> locker(mtx_);
 
-    return connQue_.size();
+    return idle_.size();
+}
+
+SqlConnPool::Stats SqlConnPool::stats() {
+    std::lock_guard<std::mutex> locker(mtx_);
+    return {total_,       (int)idle_.size(), created_,     connectErrors_,
+            waits_,       timeouts_,         evictedIdle_, evictedBroken_};
+}
+
+/**
+ * @description: 取出连接对应的预处理语句缓存，只能由持有该连接的线程使用
+ * @param {MYSQL} *sql
+ */
+StmtCache *SqlConnPool::stmts(MYSQL *sql) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    auto                        it = stmts_.find(sql);
+    assert(it != stmts_.end());
+    return it->second.get();
 }
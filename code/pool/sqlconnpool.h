@@ -1,44 +1,113 @@
 /*
- * @Description  : MySQL连接池类，单例模式，线程同步
+ * @Description  : MySQL连接池类，主库连接池为单例，只读副本的连接池由SqlRouter创建；线程同步，后台并行建立最少连接，按需增长到上限，空闲或断开的连接被回收
  * @Date         : 2022-07-16 01:14:06
- * @LastEditTime : 2022-07-18 16:54:41
+ * @LastEditTime : 2026-10-19 04:20:41
  */
 #ifndef MY_WEBSERVER_SQLCONNPOLL_H
 #define MY_WEBSERVER_SQLCONNPOLL_H
 
 #include <mysql/mysql.h>
-#include <semaphore.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
 #include <thread>
+#include <unordered_map>
 
 #include "../logsys/log.h"
+#include "dbdeadline.h"
+#include "sqlnode.h"
+#include "sqlstmt.h"
 
 class SqlConnPool {
+public:
+    /* 连接池统计，计数从启动开始累计 */
+    struct Stats {
+        int      total;           // 当前连接数，包括正在建立的
+        int      idle;            // 空闲连接数
+        uint64_t created;         // 建立成功的连接数
+        uint64_t connectErrors;   // 建立失败的次数
+        uint64_t waits;           // 取连接时没有空闲连接而等待的次数
+        uint64_t timeouts;        // 等待超过期限仍没有取到连接的次数
+        uint64_t evictedIdle;     // 空闲超时被关闭的连接数
+        uint64_t evictedBroken;   // 检查时发现已断开被关闭的连接数
+    };
+
 private:
-    int MAX_CONN_;  // 最大连接数量
+    using Clock = std::chrono::steady_clock;
+
+    /* 空闲连接以及它被归还的时间 */
+    struct Idle {
+        MYSQL            *sql;
+        Clock::time_point since;
+    };
+
+    static const int PING_IDLE_SEC = 5;  // 空闲超过此秒数的连接取出时先ping，确认没有断开
+    static const int TICK_MS       = 1000;  // 维护线程检查空闲连接与补足最少连接的间隔
+
+    std::string host_, user_, pwd_, dbName_;
+    int         port_{0};
+    int         node_;  // 所在节点，主库为SqlNode::PRIMARY
+
+    int MAX_CONN_{0};  // 最大连接数量
+    int minConn_{0};   // 最少保持的连接数量，启动时并行建立
+    int waitMs_{0};    // 取连接时最长等待毫秒数
+    int idleSec_{0};   // 超过最少连接数的部分空闲超过此秒数被关闭，0表示不关闭
+    int ioTimeout_{0};  // 连接的读写超时秒数，看门狗没能取消查询时兜底，0表示不设置
+
+    std::mutex              mtx_;    // 互斥量
+    std::condition_variable cond_;   // 有连接归还或有空位可以新建连接时通知
+    std::deque<Idle>        idle_;   // 空闲连接，后进先出，久未使用的留在队头等待回收
+    int                     total_{0};  // 当前连接数，包括正在建立的
+    bool                    isClose_{true};
+    std::condition_variable keepCond_;  // 唤醒维护线程退出
+    std::thread             keeper_;  // 维护线程，启动时并行预热，之后回收空闲连接并补足最少连接
 
-    std::mutex mtx_;    // 互斥量
-    sem_t      semId_;  // 信号量
+    /* 每个连接的预处理语句缓存，连接建立与关闭时增删，由mtx_保护 */
+    std::unordered_map<MYSQL*, std::unique_ptr<StmtCache>> stmts_;
 
-    std::queue<MYSQL*> connQue_;  // 连接队列
+    std::atomic<uint64_t> created_{0};
+    std::atomic<uint64_t> connectErrors_{0};
+    std::atomic<uint64_t> waits_{0};
+    std::atomic<uint64_t> timeouts_{0};
+    std::atomic<uint64_t> evictedIdle_{0};
+    std::atomic<uint64_t> evictedBroken_{0};
+    std::atomic<int>      outstanding_{0};  // 正在取连接或持有连接的请求数，读写分离按它选择副本
 
 private:
-    SqlConnPool() = default;
-    ~SqlConnPool();
+
+    MYSQL* getConn_();
+    MYSQL* connect_();
+    void   putBack_(MYSQL* sql);
+    void   discard_(MYSQL* sql);
+    void   warmUp_(int count);
+    void   keepLoop_();
+
+    static bool broken_(MYSQL* sql);
 
 public:
+    explicit SqlConnPool(int node = SqlNode::PRIMARY) : node_(node) {}
+    ~SqlConnPool();
+
     static SqlConnPool* instance();
 
     void init(std::string& host, int port, std::string& user, std::string& pwd, std::string& dbName,
-              int connSize);
+              int connSize, int minConn = 1, int waitMs = 1000, int idleSec = 60, int ioTimeout = 0);
 
     MYSQL* getConn();
     void   freeConn(MYSQL* sql);
 
-    int getFreeConnCount();
+    bool  isOpen();
+    int   node() const;
+    int   outstanding() const;
+    int   getFreeConnCount();
+    Stats stats();
+
+    StmtCache* stmts(MYSQL* sql);
 
     void closePool();
 };
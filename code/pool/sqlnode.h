@@ -0,0 +1,19 @@
+/*
+ * @Description  : 数据库节点地址，下标0为主库，其余为只读副本，连接池、异步查询与看门狗按下标区分节点
+ * @Date         : 2026-10-19 04:12:36
+ * @LastEditTime : 2026-10-19 04:12:36
+ */
+#ifndef SQLNODE_H
+#define SQLNODE_H
+
+#include <string>
+
+struct SqlNode {
+    /* 主库所在的节点下标 */
+    static const int PRIMARY = 0;
+
+    std::string host;
+    int         port;
+};
+
+#endif  //SQLNODE_H
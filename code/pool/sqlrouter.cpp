@@ -0,0 +1,171 @@
+#include "sqlrouter.h"
+
+#include <algorithm>
+
+/**
+ * @description: 懒汉单例模式，局部静态变量
+ */
+SqlRouter *SqlRouter::instance() {
+    static SqlRouter router;
+    return &router;
+}
+
+/**
+ * @description: 为每个只读副本建立一个连接池，参数与主库连接池相同，节点下标从1开始
+ * @param {vector<SqlNode>} &replicas 只读副本地址，为空时所有读取都走主库
+ * @param {int} stickySec 写入后这个用户名读主库的秒数，覆盖副本的复制延迟
+ */
+void SqlRouter::init(const std::vector<SqlNode> &replicas, std::string &user, std::string &pwd,
+                     std::string &dbName, int connSize, int minConn, int waitMs, int idleSec, int ioTimeout,
+                     int stickySec) {
+    sticky_ = std::chrono::seconds(std::max(0, stickySec));
+    for (size_t i = 0; i < replicas.size(); i++) {
+        auto        replica = std::make_unique<Replica>();
+        std::string host    = replicas[i].host;
+        replica->pool       = std::make_unique<SqlConnPool>(static_cast<int>(i) + 1);
+        replica->pool->init(host, replicas[i].port, user, pwd, dbName, connSize, minConn, waitMs, idleSec,
+                            ioTimeout);
+        replicas_.push_back(std::move(replica));
+    }
+}
+
+/**
+ * @description: 关闭所有副本的连接池，主库连接池由它自己关闭
+ */
+void SqlRouter::close() {
+    for (auto &replica : replicas_) {
+        replica->pool->closePool();
+    }
+}
+
+bool SqlRouter::hasReplicas() const { return !replicas_.empty(); }
+
+/**
+ * @description: 写入以及需要读到最新数据的查询使用的连接池，即主库连接池
+ */
+SqlConnPool *SqlRouter::writer() { return SqlConnPool::instance(); }
+
+SqlRouter::Shard &SqlRouter::shard_(const std::string &name) {
+    return shards_[std::hash<std::string>()(name) & (SHARD_COUNT - 1)];
+}
+
+/**
+ * @description: 在可用的副本中选出正在处理的请求数最少的一个，请求数相同时从轮流的起点开始选
+ * @return {int} 副本下标，没有可用副本时返回-1
+ */
+int SqlRouter::pick_() {
+    Clock::rep now   = Clock::now().time_since_epoch().count();
+    size_t     count = replicas_.size();
+    size_t     start = next_.fetch_add(1, std::memory_order_relaxed);
+    int        best  = -1;
+    int        load  = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t idx = (start + i) % count;
+        if (replicas_[idx]->downUntil.load(std::memory_order_relaxed) > now) {
+            continue;
+        }
+        int outstanding = replicas_[idx]->pool->outstanding();
+        if (best < 0 || outstanding < load) {
+            best = static_cast<int>(idx);
+            load = outstanding;
+        }
+    }
+    return best;
+}
+
+/**
+ * @description: 为读取name的查询取连接：刚写入过的用户名或没有可用副本时读主库，否则读最空闲的副本；
+ *              副本取不到连接且期限未到时，暂停向它路由RETRY_MS毫秒并改读主库
+ * @param {MYSQL} **sql 取到的连接，取不到时为nullptr
+ * @return {SqlConnPool*} 连接所属的连接池，归还连接时使用
+ */
+SqlConnPool *SqlRouter::reader(const std::string &name, MYSQL **sql) {
+    if (!replicas_.empty()) {
+        int idx = -1;
+        if (!stickyRead(name) && (idx = pick_()) < 0) {
+            primaryReads_++;
+        }
+        if (idx >= 0) {
+            SqlConnPool *pool = replicas_[idx]->pool.get();
+            *sql              = pool->getConn();
+            if (*sql) {
+                replicaReads_++;
+                return pool;
+            }
+            if (DbDeadline::expired()) {
+                return pool;
+            }
+            auto until = Clock::now() + std::chrono::milliseconds(RETRY_MS);
+            replicas_[idx]->downUntil.store(until.time_since_epoch().count(), std::memory_order_relaxed);
+            fallbacks_++;
+            LOG_WARN("SqlRouter replica %d unavailable, read from primary", idx + 1);
+        }
+    }
+    SqlConnPool *pool = writer();
+    *sql              = pool->getConn();
+    return pool;
+}
+
+/**
+ * @description: 在主库写入name后调用，之后sticky_时间内这个用户名的读取都走主库，读到自己刚写入的数据
+ */
+void SqlRouter::written(const std::string &name) {
+    if (replicas_.empty() || sticky_ == Clock::duration::zero()) {
+        return;
+    }
+    Shard                      &shard = shard_(name);
+    auto                        now   = Clock::now();
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    shard.until[name] = now + sticky_;
+    if (shard.until.size() >= shard.pruneAt) {
+        for (auto it = shard.until.begin(); it != shard.until.end();) {
+            it = it->second <= now ? shard.until.erase(it) : std::next(it);
+        }
+        /*剩下的都未过期时，等表长翻倍再清理，插入的均摊代价不变*/
+        shard.pruneAt = std::max(PRUNE_SIZE, shard.until.size() * 2);
+    }
+}
+
+/**
+ * @description: name是否在写入后的粘滞时间内，过期的条目顺便删除
+ */
+bool SqlRouter::sticky(const std::string &name) {
+    if (replicas_.empty() || sticky_ == Clock::duration::zero()) {
+        return false;
+    }
+    Shard                      &shard = shard_(name);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto                        it = shard.until.find(name);
+    if (it == shard.until.end()) {
+        return false;
+    }
+    if (it->second <= Clock::now()) {
+        shard.until.erase(it);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @description: 读取name前调用，在粘滞时间内时计数并返回true，这次读取应走主库
+ */
+bool SqlRouter::stickyRead(const std::string &name) {
+    if (!sticky(name)) {
+        return false;
+    }
+    stickyReads_++;
+    return true;
+}
+
+uint64_t SqlRouter::replicaReads() const { return replicaReads_; }
+
+uint64_t SqlRouter::primaryReads() const { return primaryReads_; }
+
+uint64_t SqlRouter::stickyReads() const { return stickyReads_; }
+
+uint64_t SqlRouter::fallbacks() const { return fallbacks_; }
+
+/**
+ * @description: 副本连接池上正在处理的请求数，replica从0开始
+ */
+int SqlRouter::outstanding(size_t replica) const { return replicas_.at(replica)->pool->outstanding(); }
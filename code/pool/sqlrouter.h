@@ -0,0 +1,82 @@
+/*
+ * @Description  : 读写分离路由，写入走主库连接池，读取按正在处理的请求数选择最空闲的只读副本，刚写入的用户名在一段时间内读主库，单例模式
+ * @Date         : 2026-10-19 04:36:52
+ * @LastEditTime : 2026-10-19 04:36:52
+ */
+#ifndef SQLROUTER_H
+#define SQLROUTER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sqlconnpool.h"
+#include "sqlnode.h"
+
+class SqlRouter {
+public:
+    static const int    SHARD_COUNT = 16;    // 粘滞表分片数，必须是2的幂
+    static const int    RETRY_MS    = 1000;  // 副本取不到连接后暂停向它路由的毫秒数
+    static const size_t PRUNE_SIZE  = 1024;  // 分片中的用户名达到此数量时清理一次过期的
+
+    using Clock = std::chrono::steady_clock;
+
+private:
+    /* 一个只读副本，downUntil之前不参与路由 */
+    struct Replica {
+        std::unique_ptr<SqlConnPool> pool;
+        std::atomic<Clock::rep>      downUntil{0};
+    };
+
+    /* 刚写入的用户名到粘滞截止时间，每个分片一把锁 */
+    struct alignas(64) Shard {
+        std::mutex                                         mtx;
+        std::unordered_map<std::string, Clock::time_point> until;
+        size_t                                             pruneAt{PRUNE_SIZE};  // 表长到此时清理过期的用户名
+    };
+
+    std::vector<std::unique_ptr<Replica>> replicas_;
+    Shard                                 shards_[SHARD_COUNT];
+    Clock::duration                       sticky_{};
+    std::atomic<size_t>                   next_{0};  // 请求数相同时轮流选择副本的起点
+
+    std::atomic<uint64_t> replicaReads_{0};  // 路由到副本的读取
+    std::atomic<uint64_t> primaryReads_{0};  // 没有可用副本而读主库的次数
+    std::atomic<uint64_t> stickyReads_{0};   // 因刚写入而读主库的次数
+    std::atomic<uint64_t> fallbacks_{0};     // 副本取不到连接改读主库的次数
+
+private:
+    SqlRouter()  = default;
+    ~SqlRouter() = default;
+
+    Shard &shard_(const std::string &name);
+    int    pick_();
+
+public:
+    static SqlRouter *instance();
+
+    void init(const std::vector<SqlNode> &replicas, std::string &user, std::string &pwd, std::string &dbName,
+              int connSize, int minConn, int waitMs, int idleSec, int ioTimeout, int stickySec);
+    void close();
+
+    bool hasReplicas() const;
+
+    SqlConnPool *writer();
+    SqlConnPool *reader(const std::string &name, MYSQL **sql);
+
+    void written(const std::string &name);
+    bool sticky(const std::string &name);
+    bool stickyRead(const std::string &name);
+
+    uint64_t replicaReads() const;
+    uint64_t primaryReads() const;
+    uint64_t stickyReads() const;
+    uint64_t fallbacks() const;
+    int      outstanding(size_t replica) const;
+};
+
+#endif  //SQLROUTER_H
@@ -0,0 +1,178 @@
+#include "sqlstmt.h"
+
+#include <string.h>
+
+#include <vector>
+
+const char *const StmtCache::SQL[STMT_COUNT] = {
+    "SELECT password FROM user WHERE username=? LIMIT 1",
+    "INSERT INTO user(username, password) VALUES(?, ?)",
+};
+
+StmtCache::StmtCache(MYSQL *sql) : sql_(sql), stmts_{}, threadId_(0), lastErrno_(0) { assert(sql_); }
+
+StmtCache::~StmtCache() { invalidate(); }
+
+/**
+ * @description: 关闭所有已准备的语句，下次使用时重新准备
+ */
+void StmtCache::invalidate() {
+    for (auto &stmt : stmts_) {
+        if (stmt) {
+            mysql_stmt_close(stmt);
+            stmt = nullptr;
+        }
+    }
+}
+
+/**
+ * @description: 连接断开或语句在服务端已失效的错误码：CR_SERVER_GONE_ERROR、CR_SERVER_LOST、ER_UNKNOWN_STMT_HANDLER
+ */
+bool StmtCache::connectionLost_(unsigned int err) { return err == 2006 || err == 2013 || err == 1243; }
+
+/**
+ * @description: 执行出错后能否在重连后重新执行：只读语句总可以；写入语句只在语句句柄失效（未执行）时可以，
+ *              连接在执行中断开时写入可能已经提交，重新执行会把成功的注册变成唯一键冲突
+ */
+bool StmtCache::retryable_(StmtId id, unsigned int err) { return id == STMT_SELECT_PASSWORD || err == 1243; }
+
+/**
+ * @description: 取出已准备的语句，第一次使用或连接重连过时重新准备
+ */
+MYSQL_STMT *StmtCache::get_(StmtId id) {
+    assert(id < STMT_COUNT);
+    unsigned long threadId = mysql_thread_id(sql_);
+    if (threadId != threadId_) {
+        /*连接在别处被重连过，之前准备的语句都已失效*/
+        invalidate();
+        threadId_ = threadId;
+    }
+    if (stmts_[id]) {
+        return stmts_[id];
+    }
+    MYSQL_STMT *stmt = mysql_stmt_init(sql_);
+    if (!stmt) {
+        LOG_ERROR("mysql_stmt_init error: %s", mysql_error(sql_));
+        return nullptr;
+    }
+    if (mysql_stmt_prepare(stmt, SQL[id], strlen(SQL[id]))) {
+        LOG_ERROR("Prepare [%s] error: %s", SQL[id], mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+    stmts_[id] = stmt;
+    return stmt;
+}
+
+/**
+ * @description: 连接池中的连接开启了自动重连，ping会在连接断开时重连，之后重新准备语句
+ */
+bool StmtCache::reconnect_() {
+    invalidate();
+    if (mysql_ping(sql_)) {
+        LOG_ERROR("Mysql reconnect error: %s", mysql_error(sql_));
+        return false;
+    }
+    threadId_ = mysql_thread_id(sql_);
+    LOG_WARN("Mysql reconnected, prepared statements will be re-prepared");
+    return true;
+}
+
+/**
+ * @description: 执行预处理语句，连接断开时重连并重新准备，再重试一次；当前线程的数据库期限已过时不再重连，
+ *              执行中断开的写入语句也不重试
+ * @param {StmtId} id
+ * @param {initializer_list<string_view>} params 按顺序绑定的字符串参数
+ * @param {string} *column 不为空时保存结果第一行的第一列
+ */
+StmtCache::Result StmtCache::execute(StmtId id, std::initializer_list<std::string_view> params,
+                                     std::string *column) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        MYSQL_STMT *stmt = get_(id);
+        if (!stmt) {
+            lastErrno_ = mysql_errno(sql_);
+            if (attempt == 0 && connectionLost_(lastErrno_) && !DbDeadline::expired() && reconnect_()) {
+                continue;
+            }
+            return ERROR;
+        }
+        Result result = run_(stmt, params, column);
+        if (result != ERROR) {
+            return result;
+        }
+        lastErrno_ = mysql_stmt_errno(stmt);
+        LOG_ERROR("Execute [%s] error %u: %s", SQL[id], lastErrno_, mysql_stmt_error(stmt));
+        if (attempt > 0 || !connectionLost_(lastErrno_) || !retryable_(id, lastErrno_) || DbDeadline::expired() ||
+            !reconnect_()) {
+            return ERROR;
+        }
+    }
+    return ERROR;
+}
+
+/**
+ * @description: 最近一次execute返回ERROR时的错误码，调用者据此区分唯一键冲突等可预期的错误
+ */
+unsigned int StmtCache::lastErrno() const { return lastErrno_; }
+
+/**
+ * @description: 绑定参数并执行，参数与结果都走二进制协议，不需要转义和文本解析
+ */
+StmtCache::Result StmtCache::run_(MYSQL_STMT *stmt, std::initializer_list<std::string_view> params,
+                                  std::string *column) {
+    /*值初始化的MYSQL_BIND各字段都是0*/
+    std::vector<MYSQL_BIND>    binds(params.size());
+    std::vector<unsigned long> lens(params.size());
+    size_t                     i = 0;
+    for (auto param : params) {
+        MYSQL_BIND &bind   = binds[i];
+        lens[i]            = param.size();
+        bind.buffer_type   = MYSQL_TYPE_STRING;
+        bind.buffer        = const_cast<char *>(param.data());
+        bind.buffer_length = param.size();
+        bind.length        = &lens[i];
+        i++;
+    }
+    if ((!binds.empty() && mysql_stmt_bind_param(stmt, binds.data())) || mysql_stmt_execute(stmt)) {
+        return ERROR;
+    }
+    if (mysql_stmt_field_count(stmt) == 0) {
+        /*INSERT等语句没有结果集*/
+        return NO_ROW;
+    }
+
+    char          buf[COLUMN_BUF];
+    unsigned long len    = 0;
+    bool          isNull = false;
+    MYSQL_BIND    result;
+    memset(&result, 0, sizeof(result));
+    result.buffer_type   = MYSQL_TYPE_STRING;
+    result.buffer        = buf;
+    result.buffer_length = sizeof(buf);
+    result.length        = &len;
+    result.is_null       = &isNull;
+    if (mysql_stmt_bind_result(stmt, &result) || mysql_stmt_store_result(stmt)) {
+        return ERROR;
+    }
+
+    Result ret = NO_ROW;
+    int    rc  = mysql_stmt_fetch(stmt);
+    if (rc == 0 || rc == MYSQL_DATA_TRUNCATED) {
+        ret = ROW;
+        if (column && isNull) {
+            column->clear();
+        } else if (column && len <= sizeof(buf)) {
+            column->assign(buf, len);
+        } else if (column) {
+            /*列比缓冲长，按实际长度重新读取这一列*/
+            column->resize(len);
+            result.buffer        = &(*column)[0];
+            result.buffer_length = len;
+            mysql_stmt_fetch_column(stmt, &result, 0, 0);
+        }
+    } else if (rc != MYSQL_NO_DATA) {
+        ret = ERROR;
+    }
+    mysql_stmt_free_result(stmt);
+    return ret;
+}
@@ -0,0 +1,62 @@
+/*
+ * @Description  : 每个数据库连接上的预处理语句缓存，按语句id懒加载，使用二进制协议绑定参数与读取结果
+ * @Date         : 2026-10-18 23:48:30
+ * @LastEditTime : 2026-10-19 06:12:44
+ */
+#ifndef SQLSTMT_H
+#define SQLSTMT_H
+
+#include <mysql/mysql.h>
+
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+#include "../logsys/log.h"
+#include "dbdeadline.h"
+
+/* 预处理语句id，对应StmtCache::SQL中的语句 */
+enum StmtId {
+    STMT_SELECT_PASSWORD = 0,  // 按用户名查询密码
+    STMT_INSERT_USER,          // 注册用户
+    STMT_COUNT
+};
+
+class StmtCache {
+public:
+    /* 执行结果：出错、没有结果行（或非查询语句执行成功）、取到一行 */
+    enum Result { ERROR = -1, NO_ROW = 0, ROW = 1 };
+
+private:
+    static const char *const SQL[STMT_COUNT];
+
+    static const size_t COLUMN_BUF = 256;  // 读取结果列的缓冲，超长时再按实际长度读取
+
+    MYSQL        *sql_;
+    MYSQL_STMT   *stmts_[STMT_COUNT];
+    unsigned long threadId_;   // 语句准备时连接的线程id，重连后会变化，据此判断语句已失效
+    unsigned int  lastErrno_;  // 最近一次执行出错的MySQL错误码
+
+public:
+    explicit StmtCache(MYSQL *sql);
+    ~StmtCache();
+
+    StmtCache(const StmtCache &)            = delete;
+    StmtCache &operator=(const StmtCache &) = delete;
+
+    Result execute(StmtId id, std::initializer_list<std::string_view> params, std::string *column = nullptr);
+
+    void invalidate();
+
+    unsigned int lastErrno() const;
+
+private:
+    MYSQL_STMT *get_(StmtId id);
+    Result      run_(MYSQL_STMT *stmt, std::initializer_list<std::string_view> params, std::string *column);
+    bool        reconnect_();
+
+    static bool connectionLost_(unsigned int err);
+    static bool retryable_(StmtId id, unsigned int err);
+};
+
+#endif  //SQLSTMT_H
@@ -0,0 +1,216 @@
+#include "sqlwatchdog.h"
+
+SqlWatchdog::~SqlWatchdog() { close(); }
+
+/**
+ * @description: 懒汉单例模式，局部静态变量
+ */
+SqlWatchdog *SqlWatchdog::instance() {
+    static SqlWatchdog watchdog;
+    return &watchdog;
+}
+
+/**
+ * @description: 记录各节点控制连接的参数并启动看门狗线程，控制连接在第一次需要取消该节点上的查询时才建立
+ * @param {vector<SqlNode>} &nodes 下标与连接池、异步查询中的节点下标一致
+ */
+void SqlWatchdog::init(const std::vector<SqlNode> &nodes, const std::string &user, const std::string &pwd,
+                       const std::string &dbName) {
+    if (thread_.joinable()) {
+        return;
+    }
+    nodes_   = nodes;
+    user_    = user;
+    pwd_     = pwd;
+    dbName_  = dbName;
+    isClose_ = false;
+    ctls_.assign(nodes.size(), nullptr);
+    thread_ = std::thread(&SqlWatchdog::loop_, this);
+}
+
+void SqlWatchdog::close() {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        isClose_ = true;
+    }
+    cond_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    for (MYSQL *&ctl : ctls_) {
+        if (ctl) {
+            mysql_close(ctl);
+            ctl = nullptr;
+        }
+    }
+}
+
+/**
+ * @description: 登记连接上即将执行的查询
+ * @param {int} node 连接所在的节点
+ * @return {uint64_t} 登记号，没有期限或看门狗未启动时为0
+ */
+uint64_t SqlWatchdog::watch(MYSQL *sql, int node, DbDeadline::Clock::time_point deadline) {
+    if (deadline == DbDeadline::NONE) {
+        return 0;
+    }
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if (isClose_) {
+            return 0;
+        }
+        id           = nextId_++;
+        watches_[id] = {deadline, node, mysql_thread_id(sql), WAITING, nullptr};
+    }
+    cond_.notify_one();
+    return id;
+}
+
+bool SqlWatchdog::killed(uint64_t id) {
+    if (id == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> locker(mtx_);
+    auto                        it = watches_.find(id);
+    return it != watches_.end() && it->second.state != WAITING;
+}
+
+/**
+ * @description: 查询结束后取消登记；这次登记的KILL正在发送时等它发完，返回后不会再有针对这次登记的KILL
+ *              只等待自己的登记，其他登记的KILL不影响
+ */
+void SqlWatchdog::unwatch(uint64_t id) {
+    if (id == 0) {
+        return;
+    }
+    std::unique_lock<std::mutex> locker(mtx_);
+    killDone_.wait(locker, [this, id] {
+        auto it = watches_.find(id);
+        return it == watches_.end() || it->second.state != KILLING;
+    });
+    watches_.erase(id);
+}
+
+/**
+ * @description: 不阻塞的unwatch：这次登记的KILL正在发送时什么也不做并返回false，调用者等onKilled通知后再试
+ * @return {bool} 已取消登记(或本来就没有)时返回true
+ */
+bool SqlWatchdog::tryUnwatch(uint64_t id) {
+    if (id == 0) {
+        return true;
+    }
+    std::lock_guard<std::mutex> locker(mtx_);
+    auto                        it = watches_.find(id);
+    if (it != watches_.end() && it->second.state == KILLING) {
+        return false;
+    }
+    watches_.erase(id);
+    return true;
+}
+
+/**
+ * @description: 立即取消连接上正在执行的查询，不等待结果，用于已放弃的异步查询
+ *              与watch一样返回登记号，连接上的查询结束、连接被复用之前必须unwatch或tryUnwatch成功，
+ *              否则查询先结束时排队的KILL会落到这条连接之后的查询上
+ * @param {function<void()>} onKilled KILL发送结束后在看门狗线程中调用，事件循环据此重试tryUnwatch而不必阻塞
+ * @return {uint64_t} 登记号，看门狗未启动时为0
+ */
+uint64_t SqlWatchdog::cancel(MYSQL *sql, int node, std::function<void()> onKilled) {
+    uint64_t id = watch(sql, node, DbDeadline::Clock::now());
+    if (id != 0 && onKilled) {
+        std::lock_guard<std::mutex> locker(mtx_);
+        auto                        it = watches_.find(id);
+        if (it != watches_.end()) {
+            it->second.onKilled = std::move(onKilled);
+        }
+    }
+    return id;
+}
+
+/**
+ * @description: 看门狗线程：等到最早的期限，向对应的连接发送KILL QUERY
+ *              建立控制连接与发送KILL可能阻塞到连接超时，期间不持有锁，只把这条登记标记为KILLING，
+ *              其他线程的watch、unwatch、killed、cancel照常进行，只有这条登记的unwatch要等KILL发完
+ */
+void SqlWatchdog::loop_() {
+    std::unique_lock<std::mutex> locker(mtx_);
+    while (!isClose_) {
+        auto due = watches_.end();
+        for (auto it = watches_.begin(); it != watches_.end(); ++it) {
+            if (it->second.state == WAITING && (due == watches_.end() || it->second.deadline < due->second.deadline)) {
+                due = it;
+            }
+        }
+        if (due == watches_.end()) {
+            cond_.wait(locker);
+            continue;
+        }
+        if (DbDeadline::Clock::now() < due->second.deadline) {
+            cond_.wait_until(locker, due->second.deadline);
+            continue;
+        }
+        /*KILLING状态的登记只有本线程会删除，解锁期间迭代器保持有效*/
+        due->second.state      = KILLING;
+        int           node     = due->second.node;
+        unsigned long threadId = due->second.threadId;
+        locker.unlock();
+        kill_(node, threadId);
+        locker.lock();
+        due->second.state = KILLED;
+        killDone_.notify_all();
+        /*持锁通知：通知只是写eventfd，持锁保证unwatch返回后不会再有通知*/
+        if (due->second.onKilled) {
+            due->second.onKilled();
+        }
+    }
+}
+
+/**
+ * @description: 通过节点的控制连接取消该节点上正在执行的语句，连接本身保留可以继续使用
+ */
+bool SqlWatchdog::kill_(int node, unsigned long threadId) {
+    if (node < 0 || node >= (int)nodes_.size()) {
+        killErrors_++;
+        LOG_ERROR("SqlWatchdog unknown node %d", node);
+        return false;
+    }
+    MYSQL *&ctl = ctls_[node];
+    if (!ctl) {
+        ctl = mysql_init(nullptr);
+        if (!ctl) {
+            killErrors_++;
+            LOG_ERROR("SqlWatchdog mysql init error!");
+            return false;
+        }
+        unsigned int timeout = 1;
+        mysql_options(ctl, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+        mysql_options(ctl, MYSQL_OPT_READ_TIMEOUT, &timeout);
+        mysql_options(ctl, MYSQL_OPT_WRITE_TIMEOUT, &timeout);
+        const SqlNode &addr = nodes_[node];
+        if (!mysql_real_connect(ctl, addr.host.c_str(), user_.c_str(), pwd_.c_str(), dbName_.c_str(), addr.port,
+                                nullptr, 0)) {
+            killErrors_++;
+            LOG_ERROR("SqlWatchdog connect %s:%d error: %s", addr.host.c_str(), addr.port, mysql_error(ctl));
+            mysql_close(ctl);
+            ctl = nullptr;
+            return false;
+        }
+    }
+    std::string order = "KILL QUERY " + std::to_string(threadId);
+    kills_++;
+    if (mysql_query(ctl, order.c_str())) {
+        killErrors_++;
+        LOG_ERROR("SqlWatchdog %s on node %d error: %s", order.c_str(), node, mysql_error(ctl));
+        /*控制连接可能已断开，下次重新建立*/
+        mysql_close(ctl);
+        ctl = nullptr;
+        return false;
+    }
+    LOG_WARN("SqlWatchdog %s on node %d: deadline exceeded", order.c_str(), node);
+    return true;
+}
+
+uint64_t SqlWatchdog::kills() const { return kills_; }
+
+uint64_t SqlWatchdog::killErrors() const { return killErrors_; }
@@ -0,0 +1,98 @@
+/*
+ * @Description  : 查询看门狗，登记执行中查询的期限，到期时用查询所在节点的控制连接发送KILL QUERY取消，单例模式
+ * @Date         : 2026-10-19 03:46:05
+ * @LastEditTime : 2026-10-19 04:15:20
+ */
+#ifndef SQLWATCHDOG_H
+#define SQLWATCHDOG_H
+
+#include <mysql/mysql.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../logsys/log.h"
+#include "dbdeadline.h"
+#include "sqlnode.h"
+
+class SqlWatchdog {
+public:
+    /* 在作用域内按当前线程的期限看守连接上的查询，node为连接所在的节点；当前线程没有期限或看门狗未启动时什么也不做 */
+    class Guard {
+    private:
+        uint64_t id_;
+
+    public:
+        explicit Guard(MYSQL *sql, int node = SqlNode::PRIMARY)
+            : id_(SqlWatchdog::instance()->watch(sql, node, DbDeadline::current())) {}
+        ~Guard() { SqlWatchdog::instance()->unwatch(id_); }
+
+        Guard(const Guard &)            = delete;
+        Guard &operator=(const Guard &) = delete;
+
+        /**
+         * @description: 查询是否因到期被取消，查询出错后用它区分超时与其他错误
+         */
+        bool killed() { return SqlWatchdog::instance()->killed(id_); }
+    };
+
+private:
+    /* 登记的状态：等待期限到达 -> 正在不持锁地发送KILL QUERY -> 已发送 */
+    enum State { WAITING, KILLING, KILLED };
+
+    /* 一个被看守的查询，由登记者在查询结束时删除 */
+    struct Watch {
+        DbDeadline::Clock::time_point deadline;
+        int                           node;      // 连接所在的节点，连接id只在该节点上有意义
+        unsigned long                 threadId;  // 服务端连接id，KILL QUERY的参数
+        State                         state;
+        std::function<void()>         onKilled;  // KILL发送结束后在看门狗线程中持锁调用，不能阻塞，可以为空
+    };
+
+    std::vector<SqlNode> nodes_;
+    std::string          user_, pwd_, dbName_;
+
+    std::mutex                mtx_;
+    std::condition_variable   cond_;
+    std::condition_variable   killDone_;  // 有登记结束KILLING状态时通知，unwatch在这里等待
+    std::map<uint64_t, Watch> watches_;
+    uint64_t                  nextId_{1};
+    bool                      isClose_{true};
+    std::thread               thread_;
+
+    std::vector<MYSQL *> ctls_;  // 每个节点一条控制连接，只由看门狗线程使用，第一次取消该节点上的查询时建立
+
+    std::atomic<uint64_t> kills_{0};       // 发出的KILL QUERY次数
+    std::atomic<uint64_t> killErrors_{0};  // 控制连接不可用或KILL失败的次数
+
+private:
+    SqlWatchdog() = default;
+    ~SqlWatchdog();
+
+    void loop_();
+    bool kill_(int node, unsigned long threadId);
+
+public:
+    static SqlWatchdog *instance();
+
+    void init(const std::vector<SqlNode> &nodes, const std::string &user, const std::string &pwd,
+              const std::string &dbName);
+    void close();
+
+    uint64_t watch(MYSQL *sql, int node, DbDeadline::Clock::time_point deadline);
+    bool     killed(uint64_t id);
+    void     unwatch(uint64_t id);
+    bool     tryUnwatch(uint64_t id);
+    uint64_t cancel(MYSQL *sql, int node, std::function<void()> onKilled = nullptr);
+
+    uint64_t kills() const;
+    uint64_t killErrors() const;
+};
+
+#endif  //SQLWATCHDOG_H
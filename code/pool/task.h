@@ -0,0 +1,120 @@
+/*
+ * @Description  : 只可移动的任务类型，小对象直接存放在内部缓冲中，替代std::function，避免类型擦除带来的堆分配
+ * @Date         : 2026-10-18 22:14:40
+ * @LastEditTime : 2026-10-18 22:14:40
+ */
+#ifndef TASK_H
+#define TASK_H
+
+#include <assert.h>
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+class Task {
+public:
+    /* 内部缓冲大小，捕获不超过这么多字节的可调用对象不会分配堆内存；整个Task恰好占一个缓存行 */
+    static const std::size_t INLINE_SIZE = 48;
+
+    Task() noexcept : ops_(nullptr) {}
+
+    template <class F, class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task(F&& fn);
+
+    Task(Task&& other) noexcept;
+    Task& operator=(Task&& other) noexcept;
+
+    Task(const Task&)            = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void reset() noexcept;
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    void operator()() {
+        assert(ops_);
+        ops_->invoke(storage_);
+    }
+
+private:
+    /* 手写的虚函数表，每种可调用类型一份，存放在静态存储区 */
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* dst, void* src) noexcept;  // 移动构造到dst并析构src
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <class F>
+    static constexpr bool fitsInline_ = sizeof(F) <= INLINE_SIZE && alignof(F) <= alignof(std::max_align_t) &&
+                                        std::is_nothrow_move_constructible_v<F>;
+
+    /* 可调用对象直接构造在内部缓冲中 */
+    template <class F>
+    struct InlineOps {
+        static void invoke(void* s) { (*static_cast<F*>(s))(); }
+        static void move(void* dst, void* src) noexcept {
+            ::new (dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        }
+        static void destroy(void* s) noexcept { static_cast<F*>(s)->~F(); }
+
+        static constexpr Ops ops{invoke, move, destroy};
+    };
+
+    /* 放不下的可调用对象分配在堆上，内部缓冲只存指针 */
+    template <class F>
+    struct HeapOps {
+        static void invoke(void* s) { (**static_cast<F**>(s))(); }
+        static void move(void* dst, void* src) noexcept { *static_cast<F**>(dst) = *static_cast<F**>(src); }
+        static void destroy(void* s) noexcept { delete *static_cast<F**>(s); }
+
+        static constexpr Ops ops{invoke, move, destroy};
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[INLINE_SIZE];
+    const Ops* ops_;
+};
+
+template <class F, class>
+Task::Task(F&& fn) {
+    using Fn = std::decay_t<F>;
+    if constexpr (fitsInline_<Fn>) {
+        ::new (static_cast<void*>(storage_)) Fn(std::forward<F>(fn));
+        ops_ = &InlineOps<Fn>::ops;
+    } else {
+        *reinterpret_cast<Fn**>(storage_) = new Fn(std::forward<F>(fn));
+        ops_ = &HeapOps<Fn>::ops;
+    }
+}
+
+inline Task::Task(Task&& other) noexcept : ops_(other.ops_) {
+    if (ops_) {
+        ops_->move(storage_, other.storage_);
+        other.ops_ = nullptr;
+    }
+}
+
+inline Task& Task::operator=(Task&& other) noexcept {
+    if (this != &other) {
+        reset();
+        if (other.ops_) {
+            other.ops_->move(storage_, other.storage_);
+            ops_       = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+    return *this;
+}
+
+inline void Task::reset() noexcept {
+    if (ops_) {
+        ops_->destroy(storage_);
+        ops_ = nullptr;
+    }
+}
+
+#endif  //TASK_H
@@ -3,42 +3,100 @@
 
 #include <assert.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <functional>
+#include <cstdint>
 #include <mutex>
-#include <queue>
 #include <thread>
+#include <vector>
+
+#include "task.h"
 
 class ThreadPool {
+public:
+    /**
+     * @description: 待提交的任务，remaining为该任务还需处理的字节数，供批量提交使用
+     */
+    struct Job {
+        Task        fn;
+        std::size_t remaining = 0;
+    };
+
+    /**
+     * @description: 一个统计周期内的队列情况，由takeStats取出并清零
+     */
+    struct Stats {
+        std::size_t   depth;      // 当前排队的任务数
+        std::size_t   maxDepth;   // 周期内最大排队数
+        std::uint64_t executed;   // 周期内开始执行的任务数
+        std::uint64_t rejected;   // 周期内因队列已满被拒绝的任务数
+        std::uint64_t waitUs;     // 周期内任务排队总时长，微秒
+        std::uint64_t maxWaitUs;  // 周期内最长排队时长，微秒
+    };
+
 private:
-    std::mutex                        mtx;          // 互斥量
-    std::condition_variable           cond;         // 条件变量
-    std::atomic<bool>                 isClosed;     // 是否关闭线程池
-    std::queue<std::function<void()>> tasks;        // 任务队列
-    std::size_t                       threadCount;  // 线程数目
+    /* 老化系数：每有一个新任务入队，已排队任务的优先级相当于提前这么多字节，防止大任务饿死 */
+    static const std::size_t AGING_BYTES = 4096;
+
+    /**
+     * @description: 带优先级的任务，key越小越先执行，key = 入队序号 * AGING_BYTES + 剩余字节数
+     */
+    struct PriorityTask {
+        std::size_t                           key;
+        Task                                  fn;
+        std::chrono::steady_clock::time_point enqueued;  // 入队时刻，统计排队时长
+
+        bool operator<(const PriorityTask& rhs) const { return key > rhs.key; }  // 小根堆
+    };
+
+    std::mutex                mtx;          // 互斥量
+    std::condition_variable   cond;         // 条件变量
+    std::atomic<bool>         isClosed;     // 是否关闭线程池
+    std::vector<PriorityTask> tasks;        // 任务队列，按剩余最短优先组织成堆
+    std::size_t               seq;          // 入队序号
+    std::size_t               threadCount;  // 线程数目
+    std::size_t               maxTasks;     // 任务队列上限，0表示不限
+    Stats                     stats;        // 本统计周期的计数，受mtx保护
 
 public:
-    explicit ThreadPool(std::size_t count = std::thread::hardware_concurrency());
+    explicit ThreadPool(std::size_t count = std::thread::hardware_concurrency(), std::size_t maxTasks = 0);
 
     ~ThreadPool();
 
     template <class F>
-    void addTask(F&& task);
+    bool addTask(F&& task, std::size_t remaining = 0);
+
+    std::size_t addTasks(std::vector<Job>& jobs);
+
+    Stats takeStats();
+
+private:
+    bool push_(Task&& fn, std::size_t remaining, std::chrono::steady_clock::time_point now);
 };
 
 /**
  * @description: 构造函数中构建线程池，使用lambda表达式作为线程的工作函数，并设置线程分离
  */
-inline ThreadPool::ThreadPool(std::size_t count) : isClosed(false), threadCount(count) {
+inline ThreadPool::ThreadPool(std::size_t count, std::size_t maxTasks)
+    : isClosed(false), seq(0), threadCount(count), maxTasks(maxTasks), stats{} {
     assert(threadCount > 0);
     for (std::size_t i = 0; i < threadCount; i++) {
         std::thread([this] {
             std::unique_lock<std::mutex> locker(mtx);
             while (true) {
                 if (!tasks.empty()) {
-                    /*任务队列不为空，进入本段代码，采用右值的方式取出任务，任务取出成功，解锁，执行完任务重新获取锁*/
-                    auto task = std::move(tasks.front());
-                    tasks.pop();
+                    /*任务队列不为空，取出剩余量最小的任务，任务取出成功，解锁，执行完任务重新获取锁*/
+                    std::pop_heap(tasks.begin(), tasks.end());
+                    auto task = std::move(tasks.back().fn);
+                    auto wait = std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - tasks.back().enqueued)
+                                    .count();
+                    tasks.pop_back();
+                    stats.executed++;
+                    stats.waitUs += wait;
+                    stats.maxWaitUs = std::max<std::uint64_t>(stats.maxWaitUs, wait);
                     locker.unlock();
                     /*执行任务*/
                     task();
@@ -64,19 +122,83 @@ inline ThreadPool::~ThreadPool() {
     cond.notify_all();
 }
 
+/**
+ * @description: 在持有锁时把任务放入堆中，队列已满则拒绝
+ */
+inline bool ThreadPool::push_(Task&& fn, std::size_t remaining, std::chrono::steady_clock::time_point now) {
+    if (maxTasks > 0 && tasks.size() >= maxTasks) {
+        stats.rejected++;
+        return false;
+    }
+    tasks.push_back({seq++ * AGING_BYTES + remaining, std::move(fn), now});
+    std::push_heap(tasks.begin(), tasks.end());
+    stats.maxDepth = std::max(stats.maxDepth, tasks.size());
+    return true;
+}
+
 /**
  * @description: 参数自动推断，向任务队列中添加任务
- * TODO:         这里可以设置一个最大任务数量，若超过此数量，禁止向队列加入任务
+ *  remaining为该任务还需处理的字节数，剩余最短的任务优先执行，小响应不会排在大文件后面
+ * @return {bool} 任务队列已达上限时返回false，任务没有加入
  */
 template <class F>
-void ThreadPool::addTask(F&& task) {
+bool ThreadPool::addTask(F&& task, std::size_t remaining) {
+    auto now = std::chrono::steady_clock::now();
     {
         std::unique_lock<std::mutex> locker(mtx);
-        /*完美转发*/
-        tasks.emplace(std::forward<F>(task));
+        if (!push_(Task(std::forward<F>(task)), remaining, now)) {
+            return false;
+        }
     }
     /*加入一个任务，唤醒一个线程*/
     cond.notify_one();
+    return true;
+}
+
+/**
+ * @description: 批量添加任务，一次加锁放入整批任务，再按任务数唤醒线程
+ *  按顺序放入直到队列已满，放入的任务从jobs中移除，被拒绝的任务留在jobs中由调用者处理
+ * @param {vector<Job>&} jobs
+ * @return {size_t} 放入的任务数，即原jobs中前若干个
+ */
+inline std::size_t ThreadPool::addTasks(std::vector<Job>& jobs) {
+    if (jobs.empty()) {
+        return 0;
+    }
+    auto        now      = std::chrono::steady_clock::now();
+    std::size_t accepted = 0;
+    {
+        std::unique_lock<std::mutex> locker(mtx);
+        while (accepted < jobs.size() && push_(std::move(jobs[accepted].fn), jobs[accepted].remaining, now)) {
+            accepted++;
+        }
+        /*剩下的都会被拒绝，一并计数*/
+        if (accepted < jobs.size()) {
+            stats.rejected += jobs.size() - accepted - 1;
+        }
+    }
+    /*任务数不少于线程数时全部唤醒，否则有几个任务唤醒几个线程*/
+    if (accepted >= threadCount) {
+        cond.notify_all();
+    } else {
+        for (std::size_t i = 0; i < accepted; i++) {
+            cond.notify_one();
+        }
+    }
+    jobs.erase(jobs.begin(), jobs.begin() + accepted);
+    return accepted;
+}
+
+/**
+ * @description: 取出本统计周期的队列情况并开始新的周期
+ */
+inline ThreadPool::Stats ThreadPool::takeStats() {
+    std::unique_lock<std::mutex> locker(mtx);
+    Stats ret      = stats;
+    ret.depth      = tasks.size();
+    stats          = {};
+    stats.maxDepth = tasks.size();
+    return ret;
 }
 
 #endif  //THREADPOOL_H
@@ -0,0 +1,63 @@
+#include "latencystat.h"
+
+LatencyStat::LatencyStat() { reset(); }
+
+/**
+ * @description: 计算微秒数所在的桶：高位决定区间，其后SUB_BITS位决定区间内的子桶
+ * @param {uint64_t} us
+ */
+int LatencyStat::bucketOf_(uint64_t us) {
+    if (us < (1u << SUB_BITS)) {
+        return static_cast<int>(us);
+    }
+    int high = 63 - __builtin_clzll(us);
+    int sub  = static_cast<int>((us >> (high - SUB_BITS)) & ((1 << SUB_BITS) - 1));
+    int b    = ((high - SUB_BITS + 1) << SUB_BITS) + sub;
+    return b < BUCKET_NUM ? b : BUCKET_NUM - 1;
+}
+
+/**
+ * @description: 返回桶的上界（微秒），用作分位数的估计值
+ */
+uint64_t LatencyStat::upperOf_(int bucket) {
+    if (bucket < (1 << SUB_BITS)) {
+        return bucket;
+    }
+    int      high = (bucket >> SUB_BITS) + SUB_BITS - 1;
+    uint64_t sub  = bucket & ((1 << SUB_BITS) - 1);
+    return ((1ull << SUB_BITS) + sub + 1) << (high - SUB_BITS);
+}
+
+void LatencyStat::record(uint64_t us) {
+    buckets_[bucketOf_(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyStat::reset() {
+    for (auto &b : buckets_) {
+        b.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyStat::count() const { return count_.load(std::memory_order_relaxed); }
+
+/**
+ * @description: 估算分位数，如 percentile(0.99) 即p99，单位微秒
+ * @param {double} p 0~1之间
+ */
+uint64_t LatencyStat::percentile(double p) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(p * total);
+    uint64_t seen   = 0;
+    for (int i = 0; i < BUCKET_NUM; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen > target) {
+            return upperOf_(i);
+        }
+    }
+    return upperOf_(BUCKET_NUM - 1);
+}
@@ -0,0 +1,35 @@
+/*
+ * @Description  : 延迟直方图，对数分桶，无锁统计，用于观察小文件与大文件响应的尾延迟
+ * @Date         : 2026-10-18 13:20:05
+ * @LastEditTime : 2026-10-18 13:20:05
+ */
+#ifndef LATENCYSTAT_H
+#define LATENCYSTAT_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+class LatencyStat {
+private:
+    /* 每个2的幂区间再细分为4个桶，精度约19%，覆盖 1us ~ 2^40us */
+    static const int SUB_BITS   = 2;
+    static const int BUCKET_NUM = 41 << SUB_BITS;
+
+    std::atomic<uint64_t> buckets_[BUCKET_NUM];
+    std::atomic<uint64_t> count_;
+
+    static int      bucketOf_(uint64_t us);
+    static uint64_t upperOf_(int bucket);
+
+public:
+    LatencyStat();
+
+    void record(uint64_t us);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t percentile(double p) const;
+};
+
+#endif  //LATENCYSTAT_H
@@ -13,15 +13,54 @@ WebServer::WebServer(const Json &json) {
     openLinger_ = json["webConf"]["openLinger"].toBool();
     threadNum_  = json["webConf"]["threadNum"].toNumber();
 
-    sqlPort_    = json["sqlConf"]["sqlPort"].toNumber();
-    sqlUser_    = json["sqlConf"]["sqlUser"].toString();
-    sqlPwd_     = json["sqlConf"]["sqlPwd"].toString();
-    dbName_     = json["sqlConf"]["dbName"].toString();
-    sqlConnNum_ = json["sqlConf"]["sqlConnNum"].toNumber();
+    dbThreadNum_    = json["webConf"]["dbThreadNum"].toNumber();
+    staticQueueMax_ = json["webConf"]["staticQueueMax"].toNumber();
+    dbQueueMax_     = json["webConf"]["dbQueueMax"].toNumber();
+
+    resPack_    = json["webConf"]["resPack"].toString();
+    hotSetMB_   = json["webConf"]["hotSetMB"].toNumber();
+
+    sessionMax_    = json["webConf"]["sessionMax"].toNumber();
+    sessionTTLSec_ = json["webConf"]["sessionTTL"].toNumber();
+
+    sqlPort_      = json["sqlConf"]["sqlPort"].toNumber();
+    sqlUser_      = json["sqlConf"]["sqlUser"].toString();
+    sqlPwd_       = json["sqlConf"]["sqlPwd"].toString();
+    dbName_       = json["sqlConf"]["dbName"].toString();
+    sqlConnNum_   = json["sqlConf"]["sqlConnNum"].toNumber();
+    sqlConnMin_   = json["sqlConf"]["sqlConnMin"].toNumber();
+    sqlWaitMs_    = json["sqlConf"]["sqlWaitMs"].toNumber();
+    sqlIdleSec_   = json["sqlConf"]["sqlIdleSec"].toNumber();
+    sqlTimeoutMs_ = json["sqlConf"]["sqlTimeoutMs"].toNumber();
+
+    asyncDb_      = json["sqlConf"]["dbMode"].toString() == "async";
+    asyncConnNum_ = json["sqlConf"]["asyncConnNum"].toNumber();
+
+    const Json &replicas = json["sqlConf"]["sqlReplicas"];
+    for (size_t i = 0; i < replicas.size(); i++) {
+        sqlReplicas_.push_back({replicas[i]["host"].toString(), static_cast<int>(replicas[i]["port"].toNumber())});
+    }
+    replicaStickySec_ = json["sqlConf"]["replicaStickySec"].toNumber();
+
+    credCacheSize_   = json["sqlConf"]["credCacheSize"].toNumber();
+    credCacheTTL_    = json["sqlConf"]["credCacheTTL"].toNumber();
+    credCacheNegTTL_ = json["sqlConf"]["credCacheNegTTL"].toNumber();
+    regBatchMax_     = json["sqlConf"]["regBatchMax"].toNumber();
+    regBatchWaitMs_  = json["sqlConf"]["regBatchWaitMs"].toNumber();
+    bloomExpected_   = json["sqlConf"]["bloomExpected"].toNumber();
+    bloomFpRate_     = json["sqlConf"]["bloomFpRate"].toNumber();
+    bloomRebuildSec_ = json["sqlConf"]["bloomRebuildSec"].toNumber();
+    bloomSharedDb_   = json["sqlConf"]["bloomSharedDb"].toBool();
+
+    userBackend_    = json["sqlConf"]["userBackend"].toString();
+    userFile_       = json["sqlConf"]["userFile"].toString();
+    userCompactSec_ = json["sqlConf"]["userCompactSec"].toNumber();
 
     openLog_    = json["logConf"]["openLog"].toBool();
     logLevel_   = json["logConf"]["logLevel"].toNumber();
     logQueSize_ = json["logConf"]["logQueSize"].toNumber();
+    logBinary_  = json["logConf"]["logMode"].toString() == "binary";
+    accessLog_  = json["logConf"]["accessLog"].toBool();
 }
 
 /**
@@ -33,6 +72,33 @@ WebServer::WebServer(std::tuple<int, int, int, bool, int>
     std::tie(port_, trigMode_, timeoutMS_, openLinger_, threadNum_) = webConf;
     std::tie(sqlPort_, sqlUser_, sqlPwd_, dbName_, sqlConnNum_)     = sqlConf;
     std::tie(openLog_, logLevel_, logQueSize_)                      = logConf;
+    hotSetMB_                                                       = 0;
+    sessionMax_                                                     = 0;
+    sessionTTLSec_                                                  = 1800;
+    sqlConnMin_                                                     = sqlConnNum_;
+    sqlWaitMs_                                                      = 1000;
+    sqlIdleSec_                                                     = 0;
+    sqlTimeoutMs_                                                   = 0;
+    dbThreadNum_                                                    = 2;
+    staticQueueMax_                                                 = 0;
+    dbQueueMax_                                                     = 256;
+    asyncDb_                                                        = false;
+    asyncConnNum_                                                   = 0;
+    replicaStickySec_                                               = 5;
+    credCacheSize_                                                  = 0;
+    credCacheTTL_                                                   = 60;
+    credCacheNegTTL_                                                = 10;
+    regBatchMax_                                                    = 0;
+    regBatchWaitMs_                                                 = 2;
+    bloomExpected_                                                  = 0;
+    bloomFpRate_                                                    = 0.01;
+    bloomRebuildSec_                                                = 3600;
+    bloomSharedDb_                                                  = false;
+    userBackend_                                                    = "mysql";
+    userFile_                                                       = "./users.db";
+    userCompactSec_                                                 = 300;
+    logBinary_                                                      = false;
+    accessLog_                                                      = false;
 }
 
 /**
@@ -42,7 +108,11 @@ void WebServer::initServer() {
     // make_unique只是完美转发了它的参数到它要创建的对象的构造函数中去
     epoller_    = std::make_unique<Epoller>();
     timer_      = std::make_unique<HeapTimer>();
-    threadPool_ = std::make_unique<ThreadPool>(threadNum_);
+    /*静态资源与数据库任务分两个通道，登录注册阻塞在数据库上时不会拖住静态资源请求*/
+    Executor::LaneConf lanes[Executor::LANE_COUNT];
+    lanes[Executor::STATIC] = {static_cast<size_t>(threadNum_), static_cast<size_t>(staticQueueMax_)};
+    lanes[Executor::DB]     = {static_cast<size_t>(dbThreadNum_), static_cast<size_t>(dbQueueMax_)};
+    executor_               = std::make_unique<Executor>(lanes);
 
     // 当前工作目录是指命令行窗口中运行程序的目录
     /*获取资源目录，返回的是堆内存中的*/
@@ -53,8 +123,30 @@ void WebServer::initServer() {
     /*初始化http连接类的静态变量值以及数据库连接池*/
     HttpConn::userCount = 0;
     HttpConn::srcDir    = srcDir_;
-    std::string host_   = "localhost";
-    SqlConnPool::instance()->init(host_, sqlPort_, sqlUser_, sqlPwd_, dbName_, sqlConnNum_);
+    /*登录注册访问数据库的期限不超过连接本身的超时*/
+    HttpConn::dbTimeoutMS = sqlTimeoutMs_ > 0 && timeoutMS_ > 0 ? std::min(sqlTimeoutMs_, timeoutMS_) : sqlTimeoutMs_;
+    std::string userErr;
+    if (userBackend_ == "memory") {
+        /*进程内用户存储，不连接MySQL，登录注册不阻塞，直接在static通道中验证*/
+        auto store = std::make_unique<MemUserStore>();
+        if (store->open(userFile_, userCompactSec_, userErr)) {
+            UserAuth::instance()->setBackend(std::move(store));
+        } else {
+            isClose_ = true;
+        }
+        asyncDb_ = false;
+    } else {
+        initMysql_();
+    }
+
+    /*静态资源缓存，后台线程通过inotify监视资源目录*/
+    FileCache::instance()->init(srcDir_, static_cast<size_t>(hotSetMB_) * 1024 * 1024);
+    /*登录会话表，登录注册成功时下发Cookie，过期会话由事件循环定时清理*/
+    SessionStore::instance()->init(static_cast<size_t>(sessionMax_), sessionTTLSec_);
+    initResPack_();
+
+    /*先格式化一次Date头部，之后由事件循环每秒刷新*/
+    HttpHeader::updateDate();
 
     /*根据参数设置连接事件与监听事件的出发模式LT或ET*/
     initEventMode_();
@@ -67,19 +159,108 @@ void WebServer::initServer() {
     /*日志开关*/
     if (openLog_) {
         /*初始化LOG类设置*/
-        Log::instance()->init(logLevel_, "./log", ".log", logQueSize_);
+        Log::instance()->init(logLevel_, "./log", ".log", logQueSize_, logBinary_);
         if (isClose_) {
+            if (!userErr.empty()) {
+                LOG_ERROR("Open user store error: %s", userErr.c_str());
+            }
             LOG_ERROR("====================Server init error!===================");
         } else {
             LOG_INFO("================Server init===================");
             LOG_INFO("Port: %d, OpenLinger: %s", port_, openLinger_ ? "true" : "false");
             LOG_INFO("Listen Mode: %s, Conn Mode: %s", (listenEvent_ & EPOLLET ? "ET" : "LT"),
                      (connEvent_ & EPOLLET ? "ET" : "LT"));
-            LOG_INFO("Log level: %d", logLevel_);
+            LOG_INFO("Log level: %d, Log mode: %s, Access log: %s", logLevel_,
+                     logBinary_ ? "binary" : "text", accessLog_ ? "on" : "off");
             LOG_INFO("srcDir: %s", srcDir_);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", sqlConnNum_, threadNum_);
+            LOG_INFO("Session max: %d, TTL: %ds", sessionMax_, sessionTTLSec_);
+            if (RespPack::instance()->isOpen()) {
+                LOG_INFO("Resource pack: %s, %u files", resPack_.c_str(),
+                         RespPack::instance()->count());
+            }
+            if (!resPackMsg_.empty()) {
+                LOG_WARN("Resource pack %s %s", resPack_.c_str(), resPackMsg_.c_str());
+            }
+            LOG_INFO("User backend: %s", UserAuth::instance()->name());
+            if (userBackend_ == "memory") {
+                LOG_INFO("User file: %s, compact check: %ds", userFile_.c_str(), userCompactSec_);
+            }
+            LOG_INFO("SqlConnPool num: %d, Static lane threads: %d, DB lane threads: %d", sqlConnNum_,
+                     threadNum_, dbThreadNum_);
+            LOG_INFO("SqlConnPool min: %d, wait: %dms, idle: %ds", sqlConnMin_, sqlWaitMs_, sqlIdleSec_);
+            LOG_INFO("DB deadline: %dms", HttpConn::dbTimeoutMS);
+            for (size_t i = 0; i < sqlReplicas_.size(); i++) {
+                LOG_INFO("SQL replica %d: %s:%d", (int)i + 1, sqlReplicas_[i].host.c_str(), sqlReplicas_[i].port);
+            }
+            if (!sqlReplicas_.empty()) {
+                LOG_INFO("Replica sticky after write: %ds", replicaStickySec_);
+            }
+            LOG_INFO("DB mode: %s, async conn num: %d", asyncDb_ ? "async" : "blocking",
+                     asyncDb_ ? asyncConnNum_ : 0);
+            LOG_INFO("Credential cache size: %d, TTL: %ds, negative TTL: %ds", credCacheSize_, credCacheTTL_,
+                     credCacheNegTTL_);
+            LOG_INFO("Register batch max rows: %d, wait: %dms", regBatchMax_, regBatchWaitMs_);
+            LOG_INFO("User bloom expected: %d, fp rate: %g, rebuild: %ds, shared db: %s", bloomExpected_,
+                     bloomFpRate_, bloomRebuildSec_, bloomSharedDb_ ? "true" : "false");
+        }
+    }
+}
+
+/**
+ * @description: 初始化MySQL用户后端用到的连接池、读写分离路由、异步连接、凭据缓存、注册合并写入与布隆过滤器
+ */
+void WebServer::initMysql_() {
+    std::string host_     = "localhost";
+    int         ioTimeout = (HttpConn::dbTimeoutMS + 999) / 1000;
+    /*连接池在后台并行建立最少连接，不阻塞启动，静态资源请求不受数据库影响*/
+    SqlConnPool::instance()->init(host_, sqlPort_, sqlUser_, sqlPwd_, dbName_, sqlConnNum_, sqlConnMin_, sqlWaitMs_,
+                                  sqlIdleSec_, ioTimeout);
+    /*每个只读副本一个同样配置的连接池，登录查询按正在处理的请求数分摊到副本，写入只走主库*/
+    SqlRouter::instance()->init(sqlReplicas_, sqlUser_, sqlPwd_, dbName_, sqlConnNum_, sqlConnMin_, sqlWaitMs_,
+                                sqlIdleSec_, ioTimeout, replicaStickySec_);
+    /*到期的查询由看门狗通过所在节点的控制连接发送KILL QUERY取消，读写超时只作兜底*/
+    if (HttpConn::dbTimeoutMS > 0) {
+        std::vector<SqlNode> nodes{{host_, sqlPort_}};
+        nodes.insert(nodes.end(), sqlReplicas_.begin(), sqlReplicas_.end());
+        SqlWatchdog::instance()->init(nodes, sqlUser_, sqlPwd_, dbName_);
+    }
+    /*异步数据库连接由单独的数据库线程驱动，不可用时退回到db通道同步查询*/
+    if (asyncDb_ && !SqlAsync::instance()->init(host_, sqlPort_, sqlUser_, sqlPwd_, dbName_, asyncConnNum_,
+                                                static_cast<size_t>(dbQueueMax_), sqlReplicas_)) {
+        asyncDb_ = false;
+    }
+    /*用户凭据缓存，常见的登录请求命中时不访问数据库*/
+    CredCache::instance()->init(static_cast<size_t>(credCacheSize_), credCacheTTL_, credCacheNegTTL_);
+    /*并发的注册合并成一个事务写入，每批只提交一次*/
+    RegBatcher::instance()->init(static_cast<size_t>(regBatchMax_), regBatchWaitMs_, static_cast<size_t>(dbQueueMax_));
+    /*已注册用户名的布隆过滤器，后台线程流式扫描user表加载，加载完成前不参与判断*/
+    UserBloom::instance()->init(static_cast<uint64_t>(bloomExpected_), bloomFpRate_, bloomRebuildSec_, bloomSharedDb_);
+}
+
+/**
+ * @description: 映射资源包，若配置的资源包不存在则在启动时扫描资源目录生成一次
+ */
+void WebServer::initResPack_() {
+    if (resPack_.empty()) {
+        return;
+    }
+    std::string errMsg;
+    /*已有的资源包可能是上次部署前生成的，与资源目录逐个文件比较，不一致时重新生成，避免发送旧内容与旧ETag*/
+    bool fresh = access(resPack_.c_str(), F_OK) == 0 && RespPack::verify(srcDir_, resPack_, errMsg);
+    if (!fresh) {
+        if (!errMsg.empty()) {
+            resPackMsg_ = "rebuilt, old pack " + errMsg;
+            errMsg.clear();
+        }
+        if (!RespPack::build(srcDir_, resPack_, errMsg)) {
+            resPackMsg_ = "build error: " + errMsg;
+            return;
         }
     }
+    if (!RespPack::instance()->open(resPack_, errMsg)) {
+        /*资源包不可用时回退到文件系统*/
+        resPackMsg_ = "open error: " + errMsg;
+    }
 }
 
 /**
@@ -89,6 +270,13 @@ WebServer::~WebServer() {
     isClose_ = true;
     close(listenFd_);
     free(srcDir_);
+    FileCache::instance()->close();
+    UserAuth::instance()->close();
+    SqlAsync::instance()->close();
+    RegBatcher::instance()->close();
+    UserBloom::instance()->close();
+    SqlWatchdog::instance()->close();
+    SqlRouter::instance()->close();
     SqlConnPool::instance()->closePool();
 }
 
@@ -267,6 +455,20 @@ void WebServer::closeConn_(HttpConn *client) {
     client->closeConn();
 }
 
+/**
+ * @description: 连接超时。数据库通道或数据库线程还持有连接时不关闭，否则它们会在已关闭、甚至被新连接复用的fd上
+ *              生成响应并注册事件；推迟一个超时周期，处理结束注册写事件后由dealWrite_重新计时
+ * @param {HttpConn} *client
+ */
+void WebServer::onTimeout_(HttpConn *client) {
+    if (client->inDb()) {
+        LOG_DEBUG("Client[%d] timeout while in DB, deferred", client->getFd());
+        timer_->add(client->getFd(), timeoutMS_, std::bind(&WebServer::onTimeout_, this, client));
+        return;
+    }
+    closeConn_(client);
+}
+
 /**
  * @description: 初始化httpconn类对象，添加epoll监听事件和对应连接的计时器
  * @param {int} fd
@@ -284,7 +486,7 @@ void WebServer::addClient_(int fd, sockaddr_in addr) {
     if (timeoutMS_ > 0) {
         /*若设置了超时事件，则需要向定时器里添加这一项*/
         // 使用bind绑定到成员函数时，即使成员函数不需参数，也要将this绑定在第一个参数
-        timer_->add(fd, timeoutMS_, std::bind(&WebServer::closeConn_, this, &users_[fd]));
+        timer_->add(fd, timeoutMS_, std::bind(&WebServer::onTimeout_, this, &users_[fd]));
     }
 
     LOG_INFO("Client[%d] in!", users_[fd].getFd());
@@ -321,9 +523,11 @@ void WebServer::dealListen_() {
  */
 void WebServer::onRead_(HttpConn *client) {
     assert(client);
-    int ret       = -1;
-    int readErrno = 0;
+    int  ret       = -1;
+    int  readErrno = 0;
+    long minor, major;
 
+    client->markDequeued();
     /*调用httpconn类的read方法，读取数据*/
     ret = client->read(&readErrno);
     if (ret < 0 && readErrno != EAGAIN) {
@@ -331,54 +535,272 @@ void WebServer::onRead_(HttpConn *client) {
         closeConn_(client);
         return;
     }
-    /*调用onProcess函数解析数据*/
-    onProcess_(client);
+    /*调用onProcess函数解析数据，统计生成响应期间的缺页*/
+    threadFaults_(minor, major);
+    onProcess_(client, minor, major);
+}
+
+/**
+ * @description: 当前工作线程累计的缺页次数
+ */
+void WebServer::threadFaults_(long &minor, long &major) {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    minor = usage.ru_minflt;
+    major = usage.ru_majflt;
+}
+
+/**
+ * @description: 把当前工作线程从(minor, major)起产生的缺页记到连接上。
+ *              必须在连接交给其它线程之前调用，交出后连接随时可能在别的线程中发送、统计并开始下一个请求
+ */
+void WebServer::chargeFaults_(HttpConn *client, long minor, long major) {
+    long minorEnd, majorEnd;
+    threadFaults_(minorEnd, majorEnd);
+    client->addFaults(minorEnd - minor, majorEnd - major);
 }
 
 /**
  * @description: 处理http报文请求
  * @param {HttpConn} *client
+ * @param {long} minor 开始处理前当前线程的次缺页数
+ * @param {long} major 开始处理前当前线程的主缺页数
  */
-void WebServer::onProcess_(HttpConn *client) {
+void WebServer::onProcess_(HttpConn *client, long minor, long major) {
     if (client->process()) {
+        if (client->needsDb() && asyncDb_) {
+            /*异步验证，不占用当前线程，验证结束后回到static通道生成响应*/
+            chargeFaults_(client, minor, major);
+            uint64_t token = client->enterDb();
+            client->processDbAsync([this, client, token] { resumeDb_(client, token); });
+            return;
+        }
+        if (client->needsDb() && !UserAuth::instance()->blocking()) {
+            /*后端验证不阻塞，直接在当前线程中完成*/
+            client->processDb();
+        } else if (client->needsDb()) {
+            /*需要访问数据库，转到数据库通道，响应在那里生成；通道已满则直接返回503*/
+            chargeFaults_(client, minor, major);
+            client->markQueued();
+            uint64_t token = client->enterDb();
+            if (executor_->submit(Executor::DB, [this, client, token] { onDb_(client, token); })) {
+                return;
+            }
+            client->leaveDb(token);
+            LOG_WARN("DB lane full, reject client[%d]", client->getFd());
+            client->rejectDb();
+            threadFaults_(minor, major);
+        }
+        chargeFaults_(client, minor, major);
         /*成功处理则将epoll在该文件描述符上的监听事件改为EPOLLOUT写事件*/
         epoller_->modFd(client->getFd(), connEvent_ | EPOLLOUT);
     } else {
+        chargeFaults_(client, minor, major);
         /*未成功处理，说明数据还没有读完，需要继续使用epoll监听该连接上的EPOLLIN读事件*/
         epoller_->modFd(client->getFd(), connEvent_ | EPOLLIN);
     }
 }
 
+/**
+ * @description: 数据库通道中执行的任务，完成用户验证并生成响应，之后监听写事件；
+ *              注册写事件后才交还连接，在此之前超时不会关闭它
+ * @param {HttpConn} *client
+ * @param {uint64_t} token enterDb返回的交接序号
+ */
+void WebServer::onDb_(HttpConn *client, uint64_t token) {
+    assert(client);
+    client->markDequeued();
+    client->processDb();
+    epoller_->modFd(client->getFd(), connEvent_ | EPOLLOUT);
+    client->leaveDb(token);
+}
+
+/**
+ * @description: 异步验证结束时调用，通常在数据库线程中；生成响应的任务交回static通道，通道已满时就地生成
+ * @param {HttpConn} *client
+ * @param {uint64_t} token enterDb返回的交接序号
+ */
+void WebServer::resumeDb_(HttpConn *client, uint64_t token) {
+    client->markQueued();
+    if (!executor_->submit(Executor::STATIC, [this, client, token] { onDbDone_(client, token); })) {
+        onDbDone_(client, token);
+    }
+}
+
+/**
+ * @description: 异步验证结束后生成响应，之后监听写事件，再交还连接
+ * @param {HttpConn} *client
+ * @param {uint64_t} token enterDb返回的交接序号
+ */
+void WebServer::onDbDone_(HttpConn *client, uint64_t token) {
+    assert(client);
+    client->markDequeued();
+    client->finishDb();
+    epoller_->modFd(client->getFd(), connEvent_ | EPOLLOUT);
+    client->leaveDb(token);
+}
+
 /**
  * @description: 向对应的socket发送响应报文数据
  * @param {HttpConn} *client
  */
 void WebServer::onWrite_(HttpConn *client) {
     assert(client);
-    int ret        = -1;
-    int writeErrno = 0;
+    int  ret        = -1;
+    int  writeErrno = 0;
+    long minor, major, minorEnd, majorEnd;
 
-    /*调用httpconn类的write方法向socket发送数据*/
+    client->markDequeued();
+    /*调用httpconn类的write方法向socket发送数据，发送映射的文件时可能缺页，记录下来*/
+    threadFaults_(minor, major);
     ret = client->write(&writeErrno);
+    threadFaults_(minorEnd, majorEnd);
+    client->addFaults(minorEnd - minor, majorEnd - major);
     if (client->bytesNeedWrite() == 0) {
+        recordLatency_(client);
+        if (accessLog_ && openLog_) {
+            logAccess_(client);
+        }
+        client->nextRequest();
         /*完成传输，检查客户端是否设置了长连接字段*/
         if (client->isKeepAlive()) {
             /*如果客户端设置了长连接，那么重新注册epoll的EPOLLIN事件*/
             epoller_->modFd(client->getFd(), connEvent_ | EPOLLIN);
             return;
         }
-    } else if (ret < 0) {
-        /*若是缓冲区满了，errno会返回EAGAIN*/
-        if (writeErrno == EAGAIN) {
-            /*若返回值小于0，且信号为EAGAIN说明数据还没有发送完，重新在EPOLL上注册该连接的EPOLLOUT事件*/
-            epoller_->modFd(client->getFd(), connEvent_ | EPOLLOUT);
-            return;
-        }
+    } else if (ret > 0 || writeErrno == EAGAIN) {
+        /*本次事件的写额度用完，或者发送缓冲区满了(EAGAIN)，重新注册EPOLLOUT事件，
+         *socket仍可写时epoll会立即再次通知，连接回到任务队列按剩余字节数重新排队，让出线程给其它连接*/
+        epoller_->modFd(client->getFd(), connEvent_ | EPOLLOUT);
+        return;
     }
     /*其余情况，关闭连接*/
     closeConn_(client);
 }
 
+/**
+ * @description: 记录一次响应从生成到发送完成的延迟，按响应大小分别统计
+ * @param {HttpConn} *client
+ */
+void WebServer::recordLatency_(HttpConn *client) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - client->responseStart())
+                  .count();
+    if (client->responseBytes() <= SMALL_RESP_BYTES) {
+        smallLatency_.record(us);
+    } else {
+        largeLatency_.record(us);
+    }
+    minorFaults_ += client->minorFaults();
+    majorFaults_ += client->majorFaults();
+    LOG_DEBUG("Client[%d] sent %d bytes in %dus, page faults minor %ld major %ld", client->getFd(),
+              (int)client->responseBytes(), (int)us, client->minorFaults(), client->majorFaults());
+}
+
+/**
+ * @description: 写一行JSON访问日志，包含请求各阶段的耗时
+ * @param {HttpConn} *client
+ */
+void WebServer::logAccess_(HttpConn *client) {
+    thread_local Buffer buff;
+    client->appendAccessLog(buff);
+    Log::instance()->writeRaw(buff.beginRead(), buff.readableBytes());
+    buff.clearAll();
+}
+
+/**
+ * @description: 由事件循环定期调用，输出这段时间内大小响应的延迟分位数与缺页数后清零
+ */
+void WebServer::reportStats_() {
+    time_t now = time(nullptr);
+    if (now - lastStat_ < STAT_SECONDS) {
+        return;
+    }
+    lastStat_ = now;
+    if (smallLatency_.count() == 0 && largeLatency_.count() == 0) {
+        return;
+    }
+    LOG_INFO("Latency small(<=%dKB) n=%llu p50=%lluus p99=%lluus, large n=%llu p50=%lluus p99=%lluus",
+             (int)(SMALL_RESP_BYTES / 1024), (unsigned long long)smallLatency_.count(),
+             (unsigned long long)smallLatency_.percentile(0.5),
+             (unsigned long long)smallLatency_.percentile(0.99),
+             (unsigned long long)largeLatency_.count(),
+             (unsigned long long)largeLatency_.percentile(0.5),
+             (unsigned long long)largeLatency_.percentile(0.99));
+    LOG_INFO("Page faults in workers: minor %llu, major %llu; FileCache hits %llu, misses %llu, coalesced %llu",
+             (unsigned long long)minorFaults_.exchange(0),
+             (unsigned long long)majorFaults_.exchange(0),
+             (unsigned long long)FileCache::instance()->hits(),
+             (unsigned long long)FileCache::instance()->misses(),
+             (unsigned long long)FileCache::instance()->coalesced());
+    UserAuth::instance()->logStats();
+    if (SqlConnPool::instance()->isOpen()) {
+        SqlConnPool::Stats pool = SqlConnPool::instance()->stats();
+        LOG_INFO("SqlConnPool conns %d (idle %d), created %llu, connect errors %llu, waits %llu, timeouts %llu, "
+                 "evicted idle %llu, broken %llu",
+                 pool.total, pool.idle, (unsigned long long)pool.created, (unsigned long long)pool.connectErrors,
+                 (unsigned long long)pool.waits, (unsigned long long)pool.timeouts,
+                 (unsigned long long)pool.evictedIdle, (unsigned long long)pool.evictedBroken);
+    }
+    if (SqlRouter::instance()->hasReplicas()) {
+        SqlRouter *router = SqlRouter::instance();
+        LOG_INFO("SqlRouter replica reads %llu, primary reads %llu (sticky %llu), fallbacks %llu; "
+                 "async replica queries %llu, failovers %llu",
+                 (unsigned long long)router->replicaReads(), (unsigned long long)router->primaryReads(),
+                 (unsigned long long)router->stickyReads(), (unsigned long long)router->fallbacks(),
+                 (unsigned long long)SqlAsync::instance()->replicaQueries(),
+                 (unsigned long long)SqlAsync::instance()->failovers());
+    }
+    if (HttpConn::dbTimeoutMS > 0 && SqlConnPool::instance()->isOpen()) {
+        LOG_INFO("DB deadline kills %llu (errors %llu), async timeouts %llu",
+                 (unsigned long long)SqlWatchdog::instance()->kills(),
+                 (unsigned long long)SqlWatchdog::instance()->killErrors(),
+                 (unsigned long long)SqlAsync::instance()->timeouts());
+    }
+    if (SessionStore::instance()->isOpen()) {
+        SessionStore *sessions = SessionStore::instance();
+        LOG_INFO("SessionStore size %llu, created %llu, hits %llu, misses %llu, expired %llu, evicted %llu",
+                 (unsigned long long)sessions->size(), (unsigned long long)sessions->created(),
+                 (unsigned long long)sessions->hits(), (unsigned long long)sessions->misses(),
+                 (unsigned long long)sessions->expired(), (unsigned long long)sessions->evicted());
+    }
+    if (CredCache::instance()->isOpen()) {
+        CredCache *cred = CredCache::instance();
+        LOG_INFO("CredCache size %llu, hits %llu, negative hits %llu, misses %llu, evictions %llu",
+                 (unsigned long long)cred->size(), (unsigned long long)cred->hits(),
+                 (unsigned long long)cred->negHits(), (unsigned long long)cred->misses(),
+                 (unsigned long long)cred->evictions());
+    }
+    if (RegBatcher::instance()->isOpen()) {
+        uint64_t batches = RegBatcher::instance()->batches();
+        uint64_t rows    = RegBatcher::instance()->rows();
+        LOG_INFO("RegBatcher batches %llu, rows %llu, avg rows per batch %.1f", (unsigned long long)batches,
+                 (unsigned long long)rows, batches ? (double)rows / batches : 0.0);
+    }
+    if (UserBloom::instance()->isReady()) {
+        UserBloom *bloom     = UserBloom::instance();
+        uint64_t   negatives = bloom->negatives();
+        uint64_t   falsePos  = bloom->falsePositives();
+        LOG_INFO("UserBloom names %llu, queries %llu, definitely absent %llu, false positives %llu, "
+                 "fp rate observed %.6f estimated %.6f",
+                 (unsigned long long)bloom->count(), (unsigned long long)bloom->queries(),
+                 (unsigned long long)negatives, (unsigned long long)falsePos,
+                 negatives + falsePos ? (double)falsePos / (negatives + falsePos) : 0.0, bloom->estimatedFpRate());
+    }
+    for (int i = 0; i < Executor::LANE_COUNT; i++) {
+        auto lane  = static_cast<Executor::Lane>(i);
+        auto stats = executor_->takeStats(lane);
+        LOG_INFO("Lane %s: depth %llu (max %llu), executed %llu, rejected %llu, wait avg %lluus max %lluus",
+                 Executor::laneName(lane), (unsigned long long)stats.depth,
+                 (unsigned long long)stats.maxDepth, (unsigned long long)stats.executed,
+                 (unsigned long long)stats.rejected,
+                 (unsigned long long)(stats.executed ? stats.waitUs / stats.executed : 0),
+                 (unsigned long long)stats.maxWaitUs);
+    }
+    smallLatency_.reset();
+    largeLatency_.reset();
+}
+
 /**
  * @description: 读取一个客户端连接发送来的数据，调整当前连接的过期时间，向线程池中添加读数据的任务
  * @param {HttpConn} *client
@@ -386,7 +808,10 @@ void WebServer::onWrite_(HttpConn *client) {
 void WebServer::dealRead_(HttpConn *client) {
     assert(client);
     extentTime_(client);
-    threadPool_->addTask(std::bind(&WebServer::onRead_, this, client));
+    client->markQueued();
+    /*先攒到本轮的批次中，本轮事件处理完后一次提交给线程池*/
+    pendingJobs_.push_back({[this, client] { onRead_(client); }});
+    pendingConns_.push_back(client);
 }
 
 /**
@@ -396,7 +821,25 @@ void WebServer::dealRead_(HttpConn *client) {
 void WebServer::dealWrite_(HttpConn *client) {
     assert(client);
     extentTime_(client);
-    threadPool_->addTask(std::bind(&WebServer::onWrite_, this, client));
+    client->markQueued();
+    /*按剩余字节数排队，剩余最短的响应优先发送*/
+    pendingJobs_.push_back({[this, client] { onWrite_(client); }, static_cast<std::size_t>(client->bytesNeedWrite())});
+    pendingConns_.push_back(client);
+}
+
+/**
+ * @description: 本轮就绪的读写任务一次性提交到静态资源通道，只加一次锁；通道已满时关闭被拒绝的连接
+ */
+void WebServer::submitPending_() {
+    size_t accepted = executor_->submitBatch(Executor::STATIC, pendingJobs_);
+    if (!pendingJobs_.empty()) {
+        LOG_WARN("Static lane full, reject %d clients", (int)pendingJobs_.size());
+        for (size_t i = accepted; i < pendingConns_.size(); i++) {
+            closeConn_(pendingConns_[i]);
+        }
+        pendingJobs_.clear();
+    }
+    pendingConns_.clear();
 }
 
 /**
@@ -415,8 +858,15 @@ void WebServer::runServer() {
             /*先删除超时节点，再获取最近的超时时间*/
             timeMS = timer_->getNextTick();
         }
+        /*最多等待一秒，保证缓存的Date头部每秒都能刷新*/
+        if (timeMS < 0 || timeMS > DATE_TICK_MS) {
+            timeMS = DATE_TICK_MS;
+        }
         /*epoll等待事件的唤醒，等待时间为最近一个连接会超时的时间*/
         int eventCount = epoller_->wait(timeMS);
+        HttpHeader::updateDate();
+        SessionStore::instance()->sweep();
+        reportStats_();
         for (int i = 0; i < eventCount; i++) {
             /*获取对应文件描述符与epoll事件*/
             int      fd     = epoller_->getEventFd(i);
@@ -443,5 +893,6 @@ void WebServer::runServer() {
                 LOG_ERROR("Unexpected event");
             }
         }
+        submitPending_();
     }
 }
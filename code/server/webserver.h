@@ -11,21 +11,34 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #include <filesystem>
 #include <fstream>
 #include <unordered_map>
-
+#include <vector>
+
+#include "../auth/credcache.h"
+#include "../auth/memuserstore.h"
+#include "../auth/regbatcher.h"
+#include "../auth/sessionstore.h"
+#include "../auth/userbloom.h"
+#include "../cache/filecache.h"
+#include "../cache/respack.h"
 #include "../http/httpconn.h"
 #include "../json/Json.h"
 #include "../logsys/log.h"
 #include "../pool/sqlconnRAII.h"
 #include "../pool/sqlconnpool.h"
-#include "../pool/threadpool.h"
+#include "../pool/executor.h"
+#include "../pool/sqlasync.h"
+#include "../pool/sqlrouter.h"
+#include "../pool/sqlwatchdog.h"
 #include "../timer/heaptimer.h"
 #include "epoller.h"
+#include "latencystat.h"
 
 using namespace lightJson;
 
@@ -37,20 +50,61 @@ private:
     int  trigMode_;    // 触发模式
     int  timeoutMS_;   // 超时时间
     bool openLinger_;  // 优雅关闭
-    int  threadNum_;   // 线程数量
-
-    int         sqlPort_;     // 数据库端口
-    int         sqlConnNum_;  // MySQL连接数量
-    std::string sqlUser_;     // 用户
-    std::string sqlPwd_;      // 密码
-    std::string dbName_;      // 数据库名称
+    int  threadNum_;   // 静态资源通道线程数量
+
+    int dbThreadNum_;     // 数据库通道线程数量
+    int staticQueueMax_;  // 静态资源通道任务队列上限，0表示不限
+    int dbQueueMax_;      // 数据库通道任务队列上限，0表示不限
+
+    std::string resPack_;     // 资源包路径，为空表示不使用资源包
+    std::string resPackMsg_;  // 启动时重新生成资源包的原因或出错信息，日志初始化后输出
+    int         hotSetMB_;    // 热点文件锁定在内存中的总大小上限
+
+    int sessionMax_;     // 最多保存的登录会话数，0表示不使用会话
+    int sessionTTLSec_;  // 登录会话从创建起的有效秒数
+
+    int         sqlPort_;       // 数据库端口
+    int         sqlConnNum_;    // MySQL连接数量上限
+    int         sqlConnMin_;    // 后台预热并保持的最少连接数量
+    int         sqlWaitMs_;     // 没有空闲连接时取连接最长等待的毫秒数
+    int         sqlIdleSec_;    // 多于最少连接的部分空闲超过此秒数被关闭，0表示不关闭
+    int         sqlTimeoutMs_;  // 登录注册访问数据库的期限，超过时取消查询并返回504，0表示不限
+    std::string sqlUser_;       // 用户
+    std::string sqlPwd_;        // 密码
+    std::string dbName_;        // 数据库名称
+    bool        asyncDb_;       // 登录注册使用异步查询，否则在db通道同步查询
+    int         asyncConnNum_;  // 异步查询的连接数量
+
+    std::vector<SqlNode> sqlReplicas_;       // 只读副本，登录查询分摊到副本，为空时都走主库
+    int                  replicaStickySec_;  // 注册后这个用户名读主库的秒数
+
+    int credCacheSize_;    // 凭据缓存最多缓存的用户数，0表示关闭
+    int credCacheTTL_;     // 存在的用户的缓存秒数
+    int credCacheNegTTL_;  // 不存在的用户的缓存秒数
+    int regBatchMax_;      // 注册合并写入每批最多的行数，0表示逐条写入
+    int regBatchWaitMs_;   // 注册合并写入的凑批等待毫秒数
+
+    int    bloomExpected_;    // 布隆过滤器预计的用户数，0表示关闭
+    double bloomFpRate_;      // 布隆过滤器的目标误判率
+    int    bloomRebuildSec_;  // 布隆过滤器的重建间隔秒数
+    bool   bloomSharedDb_;    // 其他服务器进程也向同一个库注册用户，过滤器判定不存在的登录仍查询数据库
+
+    std::string userBackend_;     // 用户存储后端：mysql或memory
+    std::string userFile_;        // memory后端的用户文件
+    int         userCompactSec_;  // memory后端检查是否需要压缩的间隔秒数，0表示不压缩
 
     bool openLog_;     // 开启日志
     int  logLevel_;    // 日志级别
     int  logQueSize_;  // 日志队列大小
+    bool logBinary_;   // 二进制日志模式，格式化推迟到写线程
+    bool accessLog_;   // 每个请求写一行JSON访问日志
 
 private:
-    static const int MAX_FD = 65536;  // 最大文件描述符数量
+    static const int MAX_FD       = 65536;  // 最大文件描述符数量
+    static const int DATE_TICK_MS = 1000;   // 事件循环最长等待时间，用于刷新Date头部
+    static const int STAT_SECONDS = 10;     // 延迟统计输出间隔
+
+    static const size_t SMALL_RESP_BYTES = 64 * 1024;  // 小于等于此大小的响应计为小响应
 
     static bool isET;             // 指示本地监听的工作模式
     int         listenFd_;        // 监听的文件描述符
@@ -62,9 +116,19 @@ private:
 
     std::unique_ptr<Epoller>          epoller_;     // epoller变量
     std::unique_ptr<HeapTimer>        timer_;       // 基于小根堆的定时器
-    std::unique_ptr<ThreadPool>       threadPool_;  // 线程池
+    std::unique_ptr<Executor>         executor_;    // 按任务类型分通道的线程池
     std::unordered_map<int, HttpConn> users_;       // 连接用到时再实例化
 
+    std::vector<ThreadPool::Job> pendingJobs_;   // 本轮epoll_wait就绪的读写任务，处理完事件后批量提交
+    std::vector<HttpConn *>      pendingConns_;  // 与pendingJobs_一一对应的连接，任务被拒绝时关闭
+
+    LatencyStat smallLatency_;  // 小响应从生成到发送完成的延迟
+    LatencyStat largeLatency_;  // 大响应从生成到发送完成的延迟
+    time_t      lastStat_{0};   // 上次输出统计的时间
+
+    std::atomic<uint64_t> minorFaults_{0};  // 工作线程处理请求时的次缺页总数
+    std::atomic<uint64_t> majorFaults_{0};  // 工作线程处理请求时的主缺页总数
+
 public:
     WebServer(const Json &json);
 
@@ -82,6 +146,8 @@ private:
     static int setFdNonblock(int fd);
 
     bool initListenFd_();
+    void initMysql_();
+    void initResPack_();
     void initEventMode_();
     void addClient_(int fd, sockaddr_in addr);
 
@@ -93,10 +159,23 @@ private:
     void extentTime_(HttpConn *client);
 
     void closeConn_(HttpConn *client);
+    void onTimeout_(HttpConn *client);
 
     void onRead_(HttpConn *client);
     void onWrite_(HttpConn *client);
-    void onProcess_(HttpConn *client);
+    void onProcess_(HttpConn *client, long minor, long major);
+    void onDb_(HttpConn *client, uint64_t token);
+    void resumeDb_(HttpConn *client, uint64_t token);
+    void onDbDone_(HttpConn *client, uint64_t token);
+
+    void submitPending_();
+
+    void recordLatency_(HttpConn *client);
+    void logAccess_(HttpConn *client);
+    void reportStats_();
+
+    static void threadFaults_(long &minor, long &major);
+    static void chargeFaults_(HttpConn *client, long minor, long major);
 };
 
 #endif  //WEBSERVER_H
@@ -132,8 +132,9 @@ void HeapTimer::tick() {
         if (std::chrono::duration_cast<MS>(node.expires - Clock::now()).count() > 0) {
             break;
         }
-        node.cb();
+        /*先出堆再回调，回调中可以为同一个fd重新添加节点*/
         pop();
+        node.cb();
     }
 }
 
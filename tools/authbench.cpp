@@ -0,0 +1,81 @@
+/*
+ * @Description  : 登录验证延迟测试，比较MySQL后端使用文本查询与预处理语句、以及进程内存储后端每次登录的耗时
+ * @Date         : 2026-10-19 00:06:41
+ * @LastEditTime : 2026-10-19 00:06:41
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../code/auth/memuserstore.h"
+#include "../code/auth/mysqlbackend.h"
+#include "../code/auth/userauth.h"
+#include "../code/pool/sqlconnpool.h"
+
+static uint64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    bool memory = argc >= 2 && strcmp(argv[1], "mem") == 0;
+    if (argc < 2 || (!memory && strcmp(argv[1], "text") != 0 && strcmp(argv[1], "stmt") != 0)) {
+        fprintf(stderr,
+                "usage: %s text|stmt [count] [host] [port] [user] [password] [db]\n"
+                "       %s mem [count] [file]\n",
+                argv[0], argv[0]);
+        return 2;
+    }
+    int count = argc > 2 ? atoi(argv[2]) : 10000;
+
+    if (memory) {
+        std::string file  = argc > 3 ? argv[3] : "./authbench-users.db";
+        auto        store = std::make_unique<MemUserStore>();
+        std::string errMsg;
+        if (!store->open(file, 0, errMsg)) {
+            fprintf(stderr, "open %s: %s\n", file.c_str(), errMsg.c_str());
+            return 1;
+        }
+        UserAuth::instance()->setBackend(std::move(store));
+    } else {
+        std::string host = argc > 3 ? argv[3] : "localhost";
+        int         port = argc > 4 ? atoi(argv[4]) : 3306;
+        std::string user = argc > 5 ? argv[5] : "root";
+        std::string pwd  = argc > 6 ? argv[6] : "12345678";
+        std::string db   = argc > 7 ? argv[7] : "webdb";
+        SqlConnPool::instance()->init(host, port, user, pwd, db, 1);
+        auto backend = std::make_unique<MysqlBackend>();
+        backend->setPrepared(strcmp(argv[1], "stmt") == 0);
+        UserAuth::instance()->setBackend(std::move(backend));
+    }
+
+    /*先注册一个测试用户，已存在时注册失败，不影响后面的登录*/
+    const std::string name = "authbench";
+    UserAuth::instance()->verify(name, "authbench-pwd", false);
+
+    std::vector<uint64_t> cost(count);
+    int                   ok    = 0;
+    uint64_t              begin = nowNs();
+    for (int i = 0; i < count; i++) {
+        uint64_t t = nowNs();
+        ok += UserAuth::instance()->verify(name, "authbench-pwd", true) == UserAuth::OK;
+        cost[i] = nowNs() - t;
+    }
+    uint64_t elapsed = nowNs() - begin;
+
+    std::sort(cost.begin(), cost.end());
+    printf("%s: %d logins (%d ok), %.0f logins/s\n", argv[1], count, ok, count * 1e9 / elapsed);
+    printf("per login us: p50 %.1f p99 %.1f max %.1f\n", cost[count / 2] / 1000.0,
+           cost[count * 99 / 100] / 1000.0, cost[count - 1] / 1000.0);
+    UserAuth::instance()->close();
+    if (!memory) {
+        SqlConnPool::instance()->closePool();
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * @Description  : 查询取消测试，对慢查询设置期限，检查同步与异步两种方式都在期限附近由看门狗取消，连接之后仍可复用
+ * @Date         : 2026-10-19 06:20:15
+ * @LastEditTime : 2026-10-19 06:20:15
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../code/pool/dbdeadline.h"
+#include "../code/pool/sqlasync.h"
+#include "../code/pool/sqlconnRAII.h"
+#include "../code/pool/sqlconnpool.h"
+#include "../code/pool/sqlwatchdog.h"
+
+static const int SLACK_MS = 200;  // 取消允许超出期限的毫秒数，包括发送KILL与服务端中断查询的时间
+
+static uint64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @description: 同步方式：从连接池取连接执行，看门狗按当前线程的期限看守
+ * @return {int} 被取消的查询数
+ */
+static int runBlocking(const std::string &sql, int count, int timeoutMs, std::vector<uint64_t> &cost) {
+    int cancelled = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t          t = nowNs();
+        DbDeadline::Scope scope(DbDeadline::Clock::now() + std::chrono::milliseconds(timeoutMs));
+        MYSQL            *conn;
+        SqlConnRAII       raii(&conn, SqlConnPool::instance());
+        if (!conn) {
+            fprintf(stderr, "no connection\n");
+            break;
+        }
+        SqlWatchdog::Guard guard(conn);
+        if (mysql_query(conn, sql.c_str()) == 0) {
+            mysql_free_result(mysql_store_result(conn));
+        }
+        cancelled += guard.killed();
+        cost.push_back(nowNs() - t);
+    }
+    return cancelled;
+}
+
+/**
+ * @description: 异步方式：一次提交所有查询，每个查询占一条连接，到期的查询立即以TIMEOUT回调
+ * @return {int} 以TIMEOUT回调的查询数
+ */
+static int runAsync(const std::string &sql, int count, int timeoutMs, std::vector<uint64_t> &cost) {
+    std::atomic<int> cancelled{0};
+    std::atomic<int> done{0};
+    std::mutex       mtx;
+    for (int i = 0; i < count; i++) {
+        uint64_t          t = nowNs();
+        DbDeadline::Scope scope(DbDeadline::Clock::now() + std::chrono::milliseconds(timeoutMs));
+        bool              ok = SqlAsync::instance()->query(sql, [&, t](SqlAsync::Status status, MYSQL_RES *) {
+            uint64_t elapsed = nowNs() - t;
+            cancelled += status == SqlAsync::TIMEOUT;
+            {
+                std::lock_guard<std::mutex> locker(mtx);
+                cost.push_back(elapsed);
+            }
+            done++;
+        });
+        if (!ok) {
+            fprintf(stderr, "query rejected\n");
+            done++;
+        }
+    }
+    while (done < count || SqlAsync::instance()->pending() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return cancelled;
+}
+
+int main(int argc, char *argv[]) {
+    bool async = argc >= 2 && strcmp(argv[1], "async") == 0;
+    if (argc < 2 || (!async && strcmp(argv[1], "blocking") != 0)) {
+        fprintf(stderr,
+                "usage: %s blocking|async [timeoutMs] [count] [sleepSec] [host] [port] [user] [password] [db]\n"
+                "       the server must be slower than timeoutMs, e.g. a real MySQL running SELECT SLEEP(sleepSec)\n",
+                argv[0]);
+        return 2;
+    }
+    int         timeoutMs = argc > 2 ? atoi(argv[2]) : 300;
+    int         count     = argc > 3 ? atoi(argv[3]) : 8;
+    int         sleepSec  = argc > 4 ? atoi(argv[4]) : 2;
+    std::string host      = argc > 5 ? argv[5] : "localhost";
+    int         port      = argc > 6 ? atoi(argv[6]) : 3306;
+    std::string user      = argc > 7 ? argv[7] : "root";
+    std::string pwd       = argc > 8 ? argv[8] : "12345678";
+    std::string db        = argc > 9 ? argv[9] : "webdb";
+    std::string sql       = "SELECT SLEEP(" + std::to_string(sleepSec) + ")";
+
+    SqlWatchdog::instance()->init({{host, port}}, user, pwd, db);
+    if (async) {
+        /*连接数等于每轮的查询数，被取消的连接没有放回时第二轮的查询只能在队列中到期，不会发出KILL*/
+        if (!SqlAsync::instance()->init(host, port, user, pwd, db, count, 0)) {
+            fprintf(stderr, "async init failed\n");
+            return 1;
+        }
+    } else {
+        SqlConnPool::instance()->init(host, port, user, pwd, db, 1);
+    }
+
+    std::vector<uint64_t> cost;
+    int                   cancelled = 0;
+    uint64_t              begin     = nowNs();
+    for (int round = 0; round < 2; round++) {
+        cancelled += async ? runAsync(sql, count, timeoutMs, cost) : runBlocking(sql, count, timeoutMs, cost);
+        /*等服务端中断被KILL的查询，连接回到空闲*/
+        std::this_thread::sleep_for(std::chrono::milliseconds(SLACK_MS));
+    }
+    uint64_t elapsed = nowNs() - begin;
+
+    std::sort(cost.begin(), cost.end());
+    uint64_t maxNs = cost.empty() ? 0 : cost.back();
+    uint64_t kills = SqlWatchdog::instance()->kills();
+    printf("%s: %zu queries, %d cancelled, %llu kills (%llu errors), %.1f s\n", argv[1], cost.size(), cancelled,
+           static_cast<unsigned long long>(kills),
+           static_cast<unsigned long long>(SqlWatchdog::instance()->killErrors()), elapsed / 1e9);
+    if (!cost.empty()) {
+        printf("per query ms: p50 %.1f max %.1f (deadline %d)\n", cost[cost.size() / 2] / 1e6, maxNs / 1e6,
+               timeoutMs);
+    }
+
+    if (async) {
+        SqlAsync::instance()->close();
+    } else {
+        SqlConnPool::instance()->closePool();
+    }
+    SqlWatchdog::instance()->close();
+
+    /*每个查询都应在连接上执行并被KILL取消，且返回不晚于期限太多*/
+    bool pass = static_cast<int>(cost.size()) == count * 2 && cancelled == count * 2 &&
+                kills == static_cast<uint64_t>(count) * 2 &&
+                maxNs <= static_cast<uint64_t>(timeoutMs + SLACK_MS) * 1000000;
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
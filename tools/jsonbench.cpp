@@ -0,0 +1,165 @@
+/*
+ * @Description  : Json解析测试，比较JSON_API生成的Json树与JsonDocument在内存区中解析的耗时与每次解析的内存申请次数，
+ *                 以及JsonScanner各实现第一阶段扫描的吞吐
+ * @Date         : 2026-10-19 06:14:09
+ * @LastEditTime : 2026-10-19 06:14:09
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../code/json/Json.h"
+#include "../code/json/JsonDocument.h"
+#include "../code/json/JsonScanner.h"
+
+using namespace lightJson;
+
+/*替换全局的operator new统计申请次数，测试是单线程的*/
+static uint64_t allocs = 0;
+
+void *operator new(size_t size) {
+    allocs++;
+    if (void *p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static uint64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @description: 生成类似接口返回的用户列表，count个用户，字段有数值、布尔、null、嵌套对象、数组以及带转义的字符串
+ */
+static std::string apiPayload(int count) {
+    std::ostringstream os;
+    os << "{\"code\": 0, \"message\": \"ok\", \"total\": " << count << ", \"data\": [";
+    for (int i = 0; i < count; i++) {
+        os << (i ? "," : "") << "\n  {\"id\": " << 100000 + i << ", \"username\": \"user_" << i
+           << "\", \"email\": \"user" << i << "@example.com\", \"score\": " << i * 1.25
+           << ", \"active\": " << (i % 3 ? "true" : "false") << ", \"manager\": null"
+           << ", \"bio\": \"line one\\nline \\\"two\\\" \\u4f60\\u597d\""
+           << ", \"tags\": [\"web\", \"cpp\", \"tag" << i % 7 << "\"]"
+           << ", \"address\": {\"city\": \"Shanghai\", \"zip\": \"2000" << i % 10
+           << "\", \"geo\": [121.47, 31.23]}}";
+    }
+    os << "\n]}";
+    return os.str();
+}
+
+/**
+ * @description: 生成类似动态列表的接口返回，count条，以较长的正文字符串为主
+ */
+static std::string feedPayload(int count) {
+    std::ostringstream os;
+    os << "{\"items\": [";
+    for (int i = 0; i < count; i++) {
+        os << (i ? "," : "") << "{\"id\": \"" << 9000000000LL + i << "\", \"created_at\": \"2026-10-19T06:"
+           << 10 + i % 50 << ":00Z\", \"author\": {\"name\": \"writer " << i % 13
+           << "\", \"verified\": " << (i % 2 ? "true" : "false") << "}, \"text\": \"";
+        for (int j = 0; j < 6; j++) {
+            os << "The quick brown fox jumps over the lazy dog, sentence " << j << " of post " << i << ". ";
+        }
+        os << "\", \"likes\": " << i * 37 % 1000 << ", \"lang\": \"en\"}";
+    }
+    os << "]}";
+    return os.str();
+}
+
+template <typename F>
+static std::pair<double, double> measure(int iters, F &&parse) {
+    uint64_t a     = allocs;
+    uint64_t begin = nowNs();
+    for (int i = 0; i < iters; i++) {
+        parse();
+    }
+    uint64_t elapsed = nowNs() - begin;
+    return {static_cast<double>(elapsed) / iters, static_cast<double>(allocs - a) / iters};
+}
+
+static void bench(const std::string &name, const std::string &content, int iters) {
+    std::string errMsg;
+    Json        tree = JSON_API(content, errMsg);
+    if (!errMsg.empty()) {
+        fprintf(stderr, "%s: %s\n", name.c_str(), errMsg.c_str());
+        return;
+    }
+    /*两种解析结果必须相同*/
+    JsonDocument check;
+    if (!check.parse(content, errMsg) || check.root().toJson() != tree) {
+        fprintf(stderr, "%s: JsonDocument result differs from JSON_API\n", name.c_str());
+        exit(1);
+    }
+
+    printf("%s: %zu bytes, %d iterations\n", name.c_str(), content.size(), iters);
+    auto print = [&](const std::string &mode, std::pair<double, double> cost) {
+        printf("  %-20s %10.0f ns/parse %7.3f GB/s %10.1f allocs/parse\n", mode.c_str(), cost.first,
+               content.size() / cost.first, cost.second);
+    };
+
+    JsonScanner::Kernel best = JsonScanner::kernel();
+    for (int k = JsonScanner::SCALAR; k <= JsonScanner::AVX2; k++) {
+        auto kernel = static_cast<JsonScanner::Kernel>(k);
+        if (!JsonScanner::setKernel(kernel)) {
+            continue;
+        }
+        JsonScanner scanner;
+        print(std::string("stage1 ") + JsonScanner::name(kernel),
+              measure(iters, [&] { scanner.scan(content.c_str(), content.size()); }));
+        print(std::string("Json tree ") + JsonScanner::name(kernel),
+              measure(iters, [&] { Json json = JSON_API(content, errMsg); }));
+    }
+    JsonScanner::setKernel(best);
+
+    print("doc (fresh)", measure(iters, [&] {
+              JsonDocument doc;
+              doc.parse(content, errMsg);
+          }));
+    JsonDocument reused;
+    print("doc (reused)", measure(iters, [&] { reused.parse(content, errMsg); }));
+    printf("  arena %zu chunk(s), %zu KB\n", reused.arena().chunks(), reused.arena().capacity() / 1024);
+}
+
+int main(int argc, char *argv[]) {
+    int iters = argc > 1 ? atoi(argv[1]) : 0;
+    if (iters <= 0) {
+        fprintf(stderr, "usage: %s iterations [file ...]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<std::pair<std::string, std::string>> corpus;
+    if (argc > 2) {
+        for (int i = 2; i < argc; i++) {
+            std::ifstream     in(argv[i]);
+            std::stringstream ss;
+            ss << in.rdbuf();
+            corpus.emplace_back(argv[i], ss.str());
+        }
+    } else {
+        corpus.emplace_back("login", "{\"username\": \"alice\", \"password\": \"p@ss\\\"word\", \"remember\": true}");
+        corpus.emplace_back("api-20", apiPayload(20));
+        corpus.emplace_back("api-2000", apiPayload(2000));
+        corpus.emplace_back("feed-500", feedPayload(500));
+    }
+    for (auto &[name, content] : corpus) {
+        /*大文档按字节数缩减迭代次数，每个文档的总解析量相近*/
+        int n = static_cast<int>(std::max<size_t>(1, iters * 1024 / std::max<size_t>(content.size(), 1024)));
+        bench(name, content, n);
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * @Description  : 日志调用延迟测试，比较文本模式与二进制模式下调用线程的开销
+ * @Date         : 2026-10-18 15:52:27
+ * @LastEditTime : 2026-10-18 15:52:27
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "../code/logsys/log.h"
+
+static uint64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @description: 每个线程连续写count条日志，记录每次调用的耗时
+ */
+static void bench(int count, std::vector<uint64_t> &cost) {
+    cost.resize(count);
+    for (int i = 0; i < count; i++) {
+        uint64_t begin = nowNs();
+        LOG_INFO("Client[%d] sent %d bytes in %dus, path %s", i & 1023, i * 7, i % 5000,
+                 "/index.html");
+        cost[i] = nowNs() - begin;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || (strcmp(argv[1], "text") != 0 && strcmp(argv[1], "binary") != 0)) {
+        fprintf(stderr, "usage: %s text|binary [threads] [count per thread]\n", argv[0]);
+        return 2;
+    }
+    bool binary  = strcmp(argv[1], "binary") == 0;
+    int  threads = argc > 2 ? atoi(argv[2]) : 4;
+    int  count   = argc > 3 ? atoi(argv[3]) : 200000;
+
+    Log::instance()->init(1, "./log_bench", ".log", 1024, binary);
+
+    std::vector<std::vector<uint64_t>> costs(threads);
+    std::vector<std::thread>           workers;
+    uint64_t                           begin = nowNs();
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(bench, count, std::ref(costs[i]));
+    }
+    for (auto &t : workers) {
+        t.join();
+    }
+    uint64_t elapsed = nowNs() - begin;
+
+    std::vector<uint64_t> all;
+    for (auto &c : costs) {
+        all.insert(all.end(), c.begin(), c.end());
+    }
+    std::sort(all.begin(), all.end());
+    uint64_t sum = 0;
+    for (uint64_t c : all) {
+        sum += c;
+    }
+    size_t n = all.size();
+    printf("%s: %d threads x %d calls, %.2f Mcalls/s\n", argv[1], threads, count,
+           n * 1000.0 / elapsed);
+    printf("per call ns: mean %.1f p50 %llu p99 %llu p999 %llu max %llu\n",
+           static_cast<double>(sum) / n, static_cast<unsigned long long>(all[n / 2]),
+           static_cast<unsigned long long>(all[n * 99 / 100]),
+           static_cast<unsigned long long>(all[n * 999 / 1000]),
+           static_cast<unsigned long long>(all[n - 1]));
+    return 0;
+}
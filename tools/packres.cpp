@@ -0,0 +1,30 @@
+/*
+ * @Description  : 资源包工具，生成或校验resources/目录对应的资源包
+ * @Date         : 2026-10-18 14:40:12
+ * @LastEditTime : 2026-10-18 14:40:12
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "../code/cache/respack.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 4 || (strcmp(argv[1], "build") != 0 && strcmp(argv[1], "verify") != 0)) {
+        fprintf(stderr, "usage: %s build|verify <resources dir> <pack file>\n", argv[0]);
+        return 2;
+    }
+    std::string errMsg;
+    if (strcmp(argv[1], "build") == 0) {
+        if (!RespPack::build(argv[2], argv[3], errMsg)) {
+            fprintf(stderr, "build failed: %s\n", errMsg.c_str());
+            return 1;
+        }
+    }
+    /*生成后总是再校验一遍*/
+    if (!RespPack::verify(argv[2], argv[3], errMsg)) {
+        fprintf(stderr, "verify failed: %s\n", errMsg.c_str());
+        return 1;
+    }
+    printf("%s ok\n", argv[3]);
+    return 0;
+}